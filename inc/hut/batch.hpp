@@ -0,0 +1,125 @@
+/*  _ _ _   _       _
+ * | |_| |_| |_ _ _| |_
+ * | | | . |   | | |  _|
+ * |_|_|___|_|_|___|_|
+ * Hobby graphics and GUI library under the MIT License (MIT)
+ *
+ * Copyright (c) 2014 Jean-Baptiste Lepesme github.com/jiboo/libhut
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include <glm/vec2.hpp>
+
+#include "hut/descriptors.hpp"
+#include "hut/recorder.hpp"
+#include "hut/shared_pipeline.hpp"
+
+namespace hut {
+
+/** One indexed draw collected by a batch, filled by the drawables' draw(batch &, ...) overloads. */
+struct batch_item {
+  VkPipeline pipeline_ = VK_NULL_HANDLE;
+  VkPipelineLayout layout_ = VK_NULL_HANDLE;
+  bool blend_ = false;
+  blend_mode mode_ = BLEND_NONE;  // set while recording if display::dynamic_blend(), part of pipeline_ otherwise
+  VkDescriptorSet descriptor_ = VK_NULL_HANDLE;  // set 2, if the drawable has one
+  const descriptor_layout *set_layout_ = nullptr;  // or resolved by flush() from these, see drawable::bind()
+  const void *set_data_ = nullptr;
+  const std::vector<std::shared_ptr<const void>> *owners_ = nullptr;  // of set_data_'s resources
+  size_t set_offset_ = 0;  // of set_data_'s copy in batch::keys_
+  VkBuffer vertices_ = VK_NULL_HANDLE;
+  VkDeviceSize vertices_offset_ = 0;
+  VkBuffer indices_ = VK_NULL_HANDLE;  // bound from its start, the range is given by first_index_
+  VkIndexType index_type_ = VK_INDEX_TYPE_UINT16;
+  uint32_t first_index_ = 0, index_count_ = 0;
+  uint32_t first_instance_ = 0, instance_count_ = 1;
+  draw_constants constants_;
+
+  uint32_t layer_ = 0, order_ = 0;  // set by batch::add
+};
+
+/** Counters of the last batch::flush. binds are the state commands recorded: pipelines, descriptor sets, vertex
+ * and index buffers, push constants, viewport and scissor. The saved counts are relative to drawing every item
+ * right away, which sets all of those for each draw. */
+struct batch_stats {
+  size_t items = 0;
+  size_t draws = 0, binds = 0;
+  size_t saved_draws = 0, saved_binds = 0;
+};
+
+/** Collects the draws of a command buffer and records them at once, with as few state changes and draws as possible.
+ * Within a layer, opaque items are sorted by pipeline, descriptor set, texture and buffers, then blended items follow
+ * in the order they were added. Without a depth buffer, reordering is only correct if the opaque items of a layer
+ * don't overlap each other: put overlapping ones in different layers, drawn in increasing order.
+ * Consecutive items that only differ by contiguous index or instance ranges are merged into a single draw.
+ * The drawables, buffers and images referenced must stay alive until flush(). Not thread-safe, it's meant to be
+ * used by one on_draw at a time, kept around to reuse its storage. */
+class batch {
+ public:
+  /** Layer of the next items, 0 after each flush(). */
+  void layer(uint32_t _layer) {
+    layer_ = _layer;
+  }
+  uint32_t layer() {
+    return layer_;
+  }
+
+  void add(const batch_item &_item);
+
+  /** Records the items collected since the last flush, sets the viewport and scissor to the whole _size. */
+  void flush(recorder &_recorder, const glm::uvec2 &_size);
+
+  const batch_stats &stats() {
+    return stats_;
+  }
+
+ protected:
+  enum change : uint8_t {
+    CPIPELINE = 1 << 0,
+    CDESCRIPTOR = 1 << 1,
+    CCONSTANTS = 1 << 2,
+    CVERTICES = 1 << 3,
+    CINDICES = 1 << 4,
+  };
+
+  std::vector<batch_item> items_;
+  std::vector<batch_item> draws_;  // merged items, in recording order
+  std::vector<uint8_t> changes_;   // state to set before each of draws_
+  std::vector<uint8_t> keys_;      // serialized resources of the items' set 2, copied as drawables may rebind
+  std::vector<std::shared_ptr<const void>> owners_;  // of those resources, kept by the recording at flush()
+  uint32_t layer_ = 0;
+  batch_stats stats_;
+
+  // fills draws_, changes_ and stats_ from items_
+  void merge();
+  static bool before(const batch_item &_a, const batch_item &_b);
+  static bool mergeable(const batch_item &_a, const batch_item &_b);
+};
+
+}  // namespace hut
@@ -29,10 +29,12 @@
 
 #include <memory>
 #include <set>
+#include <variant>
+#include <vector>
 
 #include <glm/glm.hpp>
 
-#include "hut/display.hpp"
+#include <vulkan/vulkan.h>
 
 namespace hut {
 
@@ -40,11 +42,11 @@ class display;
 
 class buffer {
   friend class display;
-  friend class rgb;
-  friend class rgba;
-  friend class tex;
-  friend class rgb_tex;
-  friend class rgba_tex;
+  friend class window;
+  friend class draw_list;
+  friend class image;
+  template <typename...>
+  friend class drawable;
 
  public:
   struct range_t {
@@ -87,23 +89,46 @@ class buffer {
       buffer_.update(offset_, size_, (void *)_data.begin().base());
     }
 
+    /** Updates _count elements from _first only, leaving the others untouched. */
+    void set(uint32_t _first, const T *_data, uint32_t _count) {
+      assert(_first + _count <= count());
+      buffer_.update(offset_ + _first * sizeof(T), _count * sizeof(T), (const void *)_data);
+    }
+
     uint32_t count() const {
       return size_ / sizeof(T);
     }
   };
 
+  /** Indices stored as uint16_t or uint32_t, see allocate_indices(). */
+  using indices = std::variant<std::shared_ptr<ref<uint16_t>>, std::shared_ptr<ref<uint32_t>>>;
+
   buffer(display &_display, uint32_t _size, VkMemoryPropertyFlags _type, VkBufferUsageFlagBits _usage);
   ~buffer();
 
   void update(uint32_t _offset, uint32_t _size, const void *_data);
   void copy_from(buffer &_other, uint32_t _other_offset, uint32_t _this_offset, uint32_t _size);
 
+  /** Zone of _count T, its offset aligned to alignof(T): index buffers are bound at multiples of their index size. */
   template <typename T>
   std::shared_ptr<ref<T>> allocate(uint32_t _count = 1) {
-    range_t result = do_alloc(sizeof(T) * _count);
+    range_t result = do_alloc(sizeof(T) * _count, alignof(T));
     return std::make_shared<ref<T>>(*this, result.offset_, result.size_);
   }
 
+  /** Same as allocate(), but returns null instead of growing the buffer when it's full: growing replaces the VkBuffer
+   * that command buffers already recorded may be using. */
+  template <typename T>
+  std::shared_ptr<ref<T>> try_allocate(uint32_t _count = 1) {
+    range_t result = do_alloc(sizeof(T) * _count, alignof(T), false);
+    if (!result.allocated_)
+      return nullptr;
+    return std::make_shared<ref<T>>(*this, result.offset_, result.size_);
+  }
+
+  /** Uploads _indices of a mesh of _vertex_count vertices, narrowed to uint16_t when they all fit. */
+  indices allocate_indices(uint32_t _vertex_count, const std::vector<uint32_t> &_indices);
+
   template <typename T>
   void free(const ref<T> &_ref) {
     do_free(_ref.offset_, _ref.size_);
@@ -126,7 +151,7 @@ class buffer {
   void init(uint32_t _size, VkMemoryPropertyFlags _type, VkBufferUsageFlagBits _usage);
   void copy_from(VkBuffer _other, uint32_t _other_offset, uint32_t _this_offset, uint32_t _size);
   void grow(uint32_t new_size);
-  range_t do_alloc(uint32_t _size);
+  range_t do_alloc(uint32_t _size, uint32_t _align = 1, bool _grow = true);
   void do_free(uint32_t _offset, uint32_t _size);
   void merge();
   void debug_ranges();
@@ -135,5 +160,8 @@ class buffer {
 
 template <typename T>
 using shared_ref = std::shared_ptr<buffer::ref<T>>;
+using shared_indices = buffer::indices;
 
 }  // namespace hut
+
+#include "hut/display.hpp"  // after buffer is complete, display holds shared_ref members
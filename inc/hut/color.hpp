@@ -29,6 +29,7 @@
 
 namespace hut {
 
+/** Porter-Duff compositing modes, see blend_attachment() for which expect premultiplied source colors. */
 enum blend_mode {
   BLEND_NONE = -1,
   BLEND_CLEAR = 0,
@@ -0,0 +1,134 @@
+/*  _ _ _   _       _
+ * | |_| |_| |_ _ _| |_
+ * | | | . |   | | |  _|
+ * |_|_|___|_|_|___|_|
+ * Hobby graphics and GUI library under the MIT License (MIT)
+ *
+ * Copyright (c) 2014 Jean-Baptiste Lepesme github.com/jiboo/libhut
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec4.hpp>
+
+#include "hut/recorder.hpp"
+
+namespace hut {
+
+class display;
+class window;
+struct shader_module;
+
+/** Instances culled on the GPU: a compute pass on the display's compute queue keeps the ones overlapping the clip
+ * rectangle, compacting them into a buffer drawn indirectly, see instanced::draw(..., culler &, ...).
+ * Each instance starts with a glm::vec2 position and a glm::vec2 size, both before the model and view transforms.
+ * The window runs the pass of each frame before its graphics work, which it waits for, while the previous frame's
+ * graphics may still be running. The visible instances are compacted in no particular order.
+ * Must not outlive its window. */
+class culler {
+  friend class window;
+
+ public:
+  culler(window &_window, uint32_t _capacity, uint32_t _stride);
+  ~culler();
+
+  culler(const culler &) = delete;
+  culler &operator=(const culler &) = delete;
+
+  uint32_t capacity() {
+    return capacity_;
+  }
+
+  /** Sets _count instances from _first, it's copied to the GPU along the next frames. */
+  template <typename TInstance>
+  void set(uint32_t _first, const TInstance *_instances, uint32_t _count) {
+    assert(sizeof(TInstance) == stride_);
+    write(_first, _instances, _count);
+  }
+  /** Number of instances to cull, from the first. */
+  void count(uint32_t _count);
+  /** Transform of the instances before the window's view, it must match the model they're drawn with. */
+  void model(const glm::mat4 &_model);
+  /** Instances outside of the rectangle, min and max corners in window pixels after the view, are culled.
+   * The whole window by default, or after clip() without arguments. */
+  void clip(const glm::vec4 &_rect);
+  void clip();
+
+  /** Binds the visible instances as vertex buffer 0 and draws them, with the pipeline and indices bound in
+   * _recorder. */
+  void record(recorder &_recorder);
+
+ protected:
+  struct params {
+    glm::mat4 transform;
+    glm::vec4 clip;
+    uint32_t count;
+    uint32_t stride;  // in 4 bytes words
+  };
+
+  /** Resources of one swapchain image: the host buffer holds the parameters and source instances, the device one
+   * the indirect command and the visible instances. */
+  struct image_data {
+    VkBuffer host_ = VK_NULL_HANDLE, device_ = VK_NULL_HANDLE;
+    VkDeviceMemory host_memory_ = VK_NULL_HANDLE, device_memory_ = VK_NULL_HANDLE;
+    uint8_t *mapped_ = nullptr;
+    VkDescriptorSet set_ = VK_NULL_HANDLE;
+    VkCommandBuffer cb_ = VK_NULL_HANDLE;
+    bool dirty_ = true;  // source instances changed since this image's last frame
+  };
+
+  window &window_;
+  display &display_;
+  uint32_t capacity_, stride_;
+  std::vector<uint8_t> instances_;
+  uint32_t count_ = 0;
+  glm::mat4 model_ = glm::mat4(1);
+  bool custom_clip_ = false;
+  glm::vec4 clip_;
+
+  VkDeviceSize params_size_, command_size_;  // offsets of the instances in their buffers
+  std::shared_ptr<shader_module> shader_;
+  VkDescriptorSetLayout layout_ = VK_NULL_HANDLE;
+  VkPipelineLayout pipeline_layout_ = VK_NULL_HANDLE;
+  VkPipeline pipeline_ = VK_NULL_HANDLE;
+  VkCommandPool command_pool_ = VK_NULL_HANDLE;
+  VkDescriptorPool descriptor_pool_ = VK_NULL_HANDLE;
+  std::vector<image_data> images_;
+
+  void write(uint32_t _first, const void *_instances, uint32_t _count);
+  void create_buffer(VkDeviceSize _size, VkBufferUsageFlags _usage, VkMemoryPropertyFlags _type, VkBuffer &_buffer,
+                     VkDeviceMemory &_memory);
+  void init_images(size_t _count);
+  void destroy_images();
+  // called by the window before recording a frame of _image, the GPU is done with its previous one
+  void update(uint32_t _image);
+};
+
+}  // namespace hut
@@ -0,0 +1,109 @@
+/*  _ _ _   _       _
+ * | |_| |_| |_ _ _| |_
+ * | | | . |   | | |  _|
+ * |_|_|___|_|_|___|_|
+ * Hobby graphics and GUI library under the MIT License (MIT)
+ *
+ * Copyright (c) 2014 Jean-Baptiste Lepesme github.com/jiboo/libhut
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+namespace hut {
+
+class display;
+
+/** Layout of a drawable's set 2 with the update template writing it from its serialized resources: one entry per
+ * binding, packed one after the other in the order of the bindings. Without VK_KHR_descriptor_update_template, the
+ * same entries are turned into regular descriptor writes. */
+class descriptor_layout {
+  friend class descriptor_cache;
+
+ public:
+  descriptor_layout(display &_display, VkDescriptorSetLayout _layout,
+                    const std::vector<VkDescriptorUpdateTemplateEntry> &_entries, size_t _size);
+  ~descriptor_layout();
+
+  descriptor_layout(const descriptor_layout &) = delete;
+  descriptor_layout &operator=(const descriptor_layout &) = delete;
+
+  /** Bytes of the serialized resources. */
+  size_t size() const {
+    return size_;
+  }
+
+ protected:
+  display &display_;
+  VkDescriptorSetLayout layout_;
+  std::vector<VkDescriptorUpdateTemplateEntry> entries_;
+  size_t size_;
+  VkDescriptorUpdateTemplate template_ = VK_NULL_HANDLE;
+};
+
+/** Descriptor sets allocated for one recording of a command buffer, freed all at once by reset() before recording it
+ * again, so that sets are never updated while a previous frame may use them. Nodes keep one per swapchain image and
+ * drawables get it from the recorder.
+ * Sets are cached by layout and resources, binding the same resources again is a hash lookup. */
+class descriptor_cache {
+ public:
+  explicit descriptor_cache(display &_display);
+  ~descriptor_cache();
+
+  descriptor_cache(const descriptor_cache &) = delete;
+  descriptor_cache &operator=(const descriptor_cache &) = delete;
+
+  /** Set of _layout holding the resources serialized in _data, written on first use, when _owners of those resources
+   * are also kept until reset(). */
+  VkDescriptorSet get(const descriptor_layout &_layout, const void *_data,
+                      const std::vector<std::shared_ptr<const void>> &_owners = {});
+  /** Frees every set and releases the kept resources, the command buffers using them must not be pending anymore. */
+  void reset();
+  /** Keeps _resource alive until reset(), for resources the recorded commands use but nothing else may own. */
+  void keep(std::shared_ptr<const void> _resource) {
+    kept_.emplace_back(std::move(_resource));
+  }
+
+  size_t size() const {
+    return sets_.size();
+  }
+
+ protected:
+  constexpr static uint32_t sets_per_pool_ = 64;
+
+  display &display_;
+  std::vector<VkDescriptorPool> pools_;
+  size_t current_ = 0;  // pool allocated from, the previous ones are full
+  std::unordered_map<std::string, VkDescriptorSet> sets_;  // layout handle and serialized resources
+  std::vector<std::shared_ptr<const void>> kept_;
+
+  VkDescriptorSet allocate(VkDescriptorSetLayout _layout);
+  void write(const descriptor_layout &_layout, VkDescriptorSet _set, const void *_data);
+};
+
+}  // namespace hut
@@ -29,6 +29,7 @@
 
 #include <chrono>
 #include <condition_variable>
+#include <deque>
 #include <functional>
 #include <list>
 #include <map>
@@ -45,6 +46,7 @@
 #endif
 
 #include "hut/buffer.hpp"
+#include "hut/shared_pipeline.hpp"
 #include "hut/utils.hpp"
 #include "image.hpp"
 
@@ -53,18 +55,23 @@ namespace hut {
 class window;
 class display;
 class buffer;
+struct sampler;
 
 class display {
   friend class window;
   friend class buffer;
   friend class image;
+  friend class node;
+  friend class recorder;
+  friend class draw_list;
+  friend class culler;
+  friend class descriptor_layout;
+  friend class descriptor_cache;
   friend class sampler;
+  friend struct shared_pipeline;
   friend class noinput;
-  friend class rgb;
-  friend class rgba;
-  friend class tex;
-  friend class rgb_tex;
-  friend class rgba_tex;
+  template <typename...>
+  friend class drawable;
 
  public:
   using clock = std::chrono::steady_clock;
@@ -73,7 +80,9 @@ class display {
   using callback = std::function<void(time_point)>;
   using scheduled_item = std::tuple<callback, duration>;
 
-  display(const char *_app_name, uint32_t _app_version = VK_MAKE_VERSION(1, 0, 0), const char *_display_name = nullptr);
+  /** _recording_threads is the number of threads recording command buffers, 0 to use every core. */
+  display(const char *_app_name, uint32_t _app_version = VK_MAKE_VERSION(1, 0, 0), const char *_display_name = nullptr,
+          uint8_t _recording_threads = 0);
   ~display();
 
   void flush();
@@ -83,6 +92,58 @@ class display {
   void post(callback _callback);
   void post_overridable(callback _callback, size_t _id);
   void post_delayed(callback _callback, std::chrono::milliseconds _delay);
+  void post_at(callback _callback, time_point _when);
+
+  /** True when pipelines are created from a cache saved by a previous run. */
+  bool pipeline_cache_warm() {
+    return pipeline_cache_warm_;
+  }
+  /** Whether _data is a pipeline cache produced by the same vendor, device and driver (cache UUID). */
+  static bool pipeline_cache_compatible(const std::vector<char> &_data, const VkPhysicalDeviceProperties &_props);
+
+  /** Pipeline matching _desc, shared with the drawables already using it, thread-safe.
+   * A new one is compiled in the background, see shared_pipeline::ready(). */
+  std::shared_ptr<shared_pipeline> get_pipeline(const pipeline_desc &_desc);
+
+  /** 6 indices drawing the quad of vertices 0-1-2-3 as two triangles, shared by the instanced drawables. */
+  const shared_ref<uint16_t> &quad_indices();
+  /** Indices drawing at least _quads quads, the quad i being made of the vertices 4i to 4i+3 as in quad_indices().
+   * 16 bits wide while the vertices fit, shared by all the drawables, thread-safe. The 16 bits list is allocated
+   * whole at once. The 32 bits one grows in new buffers, the previous ones are kept for the command buffers
+   * recorded with them and the windows are re-recorded. */
+  shared_indices quad_list_indices(uint32_t _quads);
+  /** 1x1 opaque white image, in texture slot 0. */
+  const std::shared_ptr<image> &white();
+
+  /** Whether the texture table uses descriptor indexing (VK_EXT_descriptor_indexing): it's then large, updated while
+   * in use, and shaders may index it with values varying within a draw. Otherwise it's a small fixed-size array,
+   * indexed once per draw, and registering an image re-records the windows. */
+  bool bindless() {
+    return bindless_;
+  }
+  /** Whether draw lists are drawn up to the count stored on the GPU (VK_KHR_draw_indirect_count), rather than
+   * up to their capacity with the unused commands drawing nothing. */
+  bool draw_indirect_count() {
+    return draw_indirect_count_ != nullptr;
+  }
+  /** Whether indirect draws, like the ones of draw lists, may start at a non-zero instance. */
+  bool draw_indirect_first_instance() {
+    return device_features_.drawIndirectFirstInstance == VK_TRUE;
+  }
+  /** Whether the blend enable and equation are dynamic state (VK_EXT_extended_dynamic_state3), so that drawables
+   * switch blend modes within the same pipeline. Otherwise each mode is a pipeline variant. */
+  bool dynamic_blend() {
+    return set_blend_equation_ != nullptr;
+  }
+  /** Whether descriptor sets are written with update templates (VK_KHR_descriptor_update_template), rather than
+   * descriptor writes built from the same entries. */
+  bool descriptor_templates() {
+    return update_with_template_ != nullptr;
+  }
+  /** Number of slots of the texture table, it's specialization constant 0 of every shader. */
+  uint32_t texture_slots() {
+    return texture_slots_;
+  }
 
   template <typename T>
   T get_proc(const std::string &_name) {
@@ -111,10 +172,97 @@ class display {
   VkPhysicalDeviceProperties device_props_;
   VkQueue queueg_, queuec_, queuet_, queuep_;
   VkCommandPool commandg_pool_ = VK_NULL_HANDLE;
+  PFN_vkCmdDrawIndexedIndirectCountKHR draw_indirect_count_ = nullptr;
+  PFN_vkCmdSetColorBlendEnableEXT set_blend_enable_ = nullptr;
+  PFN_vkCmdSetColorBlendEquationEXT set_blend_equation_ = nullptr;
+  PFN_vkCreateDescriptorUpdateTemplate create_template_ = nullptr;
+  PFN_vkDestroyDescriptorUpdateTemplate destroy_template_ = nullptr;
+  PFN_vkUpdateDescriptorSetWithTemplate update_with_template_ = nullptr;
+  bool has_device_extension(const char *_name);
+  bool detect_dynamic_blend(VkPhysicalDeviceExtendedDynamicState3FeaturesEXT &_features);
+
+  // Shared by every pipeline creation, persisted in $XDG_CACHE_HOME/hut/ (or ~/.cache/hut/) between runs.
+  std::string app_name_;
+  VkPipelineCache pipeline_cache_ = VK_NULL_HANDLE;
+  bool pipeline_cache_warm_ = false;
+
+  // Set 0 of every pipeline layout, each window's view and projection. The pipeline layout of this set alone
+  // binds it at the start of the nodes' command buffers, pipelines don't disturb it afterwards.
+  VkDescriptorSetLayout globals_layout_ = VK_NULL_HANDLE;
+  VkPipelineLayout globals_pipeline_layout_ = VK_NULL_HANDLE;  // sets 0 and 1
+  void init_globals_layout();
+
+  // Set 1 of every pipeline layout, the texture table: every sampled image in its slot, see image::slot().
+  bool has_properties2_ = false;
+  bool bindless_ = false;
+  uint32_t texture_slots_ = 0;
+  constexpr static uint32_t max_texture_slots_ = 4096;
+  constexpr static uint32_t fallback_texture_slots_ = 64;
+  constexpr static uint32_t reserved_texture_slots_ = 4;  // per stage, for the drawables' own image bindings
+  VkDescriptorSetLayout textures_layout_ = VK_NULL_HANDLE;
+  VkDescriptorPool textures_pool_ = VK_NULL_HANDLE;
+  VkDescriptorSet textures_ = VK_NULL_HANDLE;
+  std::unique_ptr<sampler> textures_sampler_;
+  std::mutex textures_mutex_;
+  uint32_t next_slot_ = 0;
+  std::deque<uint32_t> free_slots_;
+  std::vector<std::pair<uint32_t, VkImageView>> pending_writes_;  // compat mode, applied by a posted job
+  std::vector<std::function<void()>> pending_destroys_;           // of images whose slot is written white there
+  bool texture_writes_posted_ = false;
+  bool detect_bindless(VkPhysicalDeviceDescriptorIndexingFeaturesEXT &_features);
+  void init_textures();
+  uint32_t register_texture(VkImageView _view);
+  // calls _destroy and frees the slot once neither the texture table nor the frames in flight use the image
+  void release_texture(uint32_t _slot, const std::function<void()> &_destroy);
+  void queue_texture_write(uint32_t _slot, VkImageView _view, const std::function<void()> &_destroy);
+  void write_textures(const std::vector<std::pair<uint32_t, VkImageView>> &_writes);
+
+  std::mutex pipelines_mutex_;
+  std::unordered_map<int /*VkFormat*/, VkRenderPass> compatible_renderpasses_;
+  std::unordered_map<pipeline_desc, std::weak_ptr<shared_pipeline>, pipeline_desc::hasher> pipelines_;
+  std::unordered_map<spirv_code, std::weak_ptr<shader_module>, spirv_code::hasher> shaders_;
+  // shader module for the given SPIR-V code, shared while it's referenced, pipelines_mutex_ must be held
+  std::shared_ptr<shader_module> get_shader(const uint8_t *_code, size_t _size);
+  // pipelines are compiled against these, render passes of windows with the same format are compatible
+  VkRenderPass compatible_renderpass(VkFormat _format);
+  VkRenderPass create_renderpass(VkFormat _format);
+  // re-records every node, after draws were skipped while a pipeline was compiling
+  void invalidate_windows();
+
+  // Each recording thread gets its own pool, pools being externally synchronized.
+  thread_pool recorders_;
+  task_queue compilers_;  // background pipeline compilation
+  std::vector<VkCommandPool> record_pools_;
+  size_t next_record_pool_ = 0;
+  static thread_local bool recording_thread_;
   VkPhysicalDeviceMemoryProperties mem_props_;
 
+  /** A submitted batch of staged transfers, retired once its fence signals. */
+  struct staged_batch {
+    VkCommandBuffer cb_ = VK_NULL_HANDLE;
+    VkFence fence_ = VK_NULL_HANDLE;
+    std::vector<std::pair<uint32_t, uint32_t>> ranges_;  // offset, size in staging_
+    event<> on_done_;
+  };
+
   std::shared_ptr<buffer> staging_;
-  VkCommandBuffer staging_cb_;
+  // held while allocating in staging_ or recording in staging_cb_, buffers and images are updated while recording
+  std::recursive_mutex staging_mutex_;
+
+  // resources shared by the drawables, created on first use while recording, possibly on several threads
+  std::mutex indices_mutex_;
+  std::shared_ptr<buffer> indices_;  // sized for both of these, never grows
+  shared_ref<uint16_t> quad_indices_;
+  shared_ref<uint16_t> quad_list16_;
+  std::vector<std::shared_ptr<buffer>> quad_buffers32_;  // one per size of quad_lists32_
+  std::vector<shared_ref<uint32_t>> quad_lists32_;        // current last, the others may still be in use
+  void init_quad_indices();
+  std::shared_ptr<image> white_;
+  VkCommandBuffer staging_cb_ = VK_NULL_HANDLE;
+  VkFence staging_fence_ = VK_NULL_HANDLE;
+  std::vector<std::pair<uint32_t, uint32_t>> staging_ranges_;
+  std::list<staged_batch> staged_batches_;
+  std::vector<staged_batch> staged_spares_;
   bool dirty_staging_ = false;
 
   event<> on_staged;
@@ -122,10 +270,16 @@ class display {
   std::map<size_t, callback> overridable_jobs_;
   std::multimap<time_point, callback> delayed_jobs_;
   std::mutex posted_mutex_, overridable_mutex_, delayed_mutex_;
-  std::mutex cv_mutex_;
-  std::condition_variable cv_;
   std::thread::id dispatcher_;
 
+  constexpr static size_t stats_samples_ = 256;
+  rolling_window<double> jobs_durations_{stats_samples_};  // milliseconds, per jobs loop iteration
+
+  // The jobs loop sleeps in poll() on both: wake_fd_ (eventfd) for new jobs, timer_fd_ (timerfd) for delayed ones.
+  // The last spin_duration_ before a deadline is busy-waited, poll's wake up latency is too coarse for frame pacing.
+  constexpr static std::chrono::microseconds spin_duration_{200};
+  int wake_fd_ = -1, timer_fd_ = -1;
+
   void init_vulkan_instance(const char *_app_name, uint32_t _app_version, std::vector<const char *> &_extensions);
   void init_vulkan_device(VkSurfaceKHR _dummy);
   std::pair<uint32_t, VkMemoryPropertyFlags> find_memory_type(uint32_t _type_filter, VkMemoryPropertyFlags _properties);
@@ -133,6 +287,12 @@ class display {
   void stage_copy(VkBuffer _dst, const VkBufferCopy *_info);
   void stage_transition(VkImage _image, VkFormat _format, VkImageLayout _old_layout, VkImageLayout _new_layout);
   void stage_copy(VkImage _src, VkImage _dst, uint32_t _width, uint32_t _height);
+  void stage_copy(VkImage _dst, const VkBufferImageCopy *_info, uint32_t _staging_offset, uint32_t _staging_size);
+  std::string pipeline_cache_path();
+  void init_pipeline_cache();
+  void save_pipeline_cache();
+  void begin_staging();
+  void collect_staged(bool _wait);
   void destroy_vulkan();
 
   time_point next_job_time_point();
@@ -140,8 +300,15 @@ class display {
   void tick_posted(time_point _now);
   void tick_overridable(time_point _now);
   void tick_delayed(time_point _now);
+  void init_jobs_loop();
+  void destroy_jobs_loop();
+  void wakeup();
+  void wait_until(time_point _deadline);
   void jobs_loop();
   void check_thread();
+  static size_t recording_threads(uint8_t _requested);
+  size_t pick_record_pool();
+  void record_parallel(const thread_pool::task &_task);
 
 #if defined(VK_USE_PLATFORM_XCB_KHR)
   xcb_connection_t *connection_;
@@ -150,6 +317,8 @@ class display {
   std::unordered_map<xcb_window_t, window *> windows_;
 
   xcb_atom_t atom_wm_, atom_close_;
+#elif defined(VK_USE_PLATFORM_HEADLESS_KHR)
+  std::vector<window *> windows_;
 #endif
 };
 
@@ -0,0 +1,96 @@
+/*  _ _ _   _       _
+ * | |_| |_| |_ _ _| |_
+ * | | | . |   | | |  _|
+ * |_|_|___|_|_|___|_|
+ * Hobby graphics and GUI library under the MIT License (MIT)
+ *
+ * Copyright (c) 2014 Jean-Baptiste Lepesme github.com/jiboo/libhut
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "hut/buffer.hpp"
+#include "hut/recorder.hpp"
+
+namespace hut {
+
+/** Draw parameters kept in a GPU buffer, drawn with a single indirect draw recorded once.
+ * Adding, updating, hiding or removing a draw is a buffer write, the command buffers drawing the list stay valid:
+ * call window::invalidate(false) to present the change, there is no need to re-record.
+ * Commands are packed at the start of the buffer, the GPU reads their count when display::draw_indirect_count(),
+ * otherwise every slot up to the capacity is drawn, the unused ones drawing no instances.
+ * firstInstance must be 0 unless display::draw_indirect_first_instance(), add() and update() throw otherwise.
+ * Not thread-safe. */
+class draw_list {
+ public:
+  using command = VkDrawIndexedIndirectCommand;
+
+  draw_list(display &_display, uint32_t _capacity);
+
+  draw_list(const draw_list &) = delete;
+  draw_list &operator=(const draw_list &) = delete;
+
+  uint32_t capacity() const {
+    return capacity_;
+  }
+  /** Number of draws added and not removed, hidden ones included. */
+  uint32_t size() const {
+    return (uint32_t)slots_.size();
+  }
+
+  /** Returns the id of the draw, valid until it's removed. Throws if the list is full. */
+  uint32_t add(const command &_command, bool _visible = true);
+  void update(uint32_t _id, const command &_command);
+  void visible(uint32_t _id, bool _visible);
+  void remove(uint32_t _id);
+
+  /** Records the draws with the pipeline and buffers bound in _recorder, see the drawables' draw(..., draw_list &). */
+  void record(recorder &_recorder);
+
+ protected:
+  display &display_;
+  uint32_t capacity_;
+  std::shared_ptr<buffer> buffer_;  // sized once, growing it would change the VkBuffer recorded
+  shared_ref<command> commands_;
+  shared_ref<uint32_t> count_;
+
+  struct entry {
+    command command_;
+    uint32_t slot_;
+    bool visible_;
+  };
+  std::vector<entry> entries_;    // by id
+  std::vector<uint32_t> slots_;   // id of each used slot, packed
+  std::vector<uint32_t> free_ids_;
+
+  void check(const command &_command);
+  void write(uint32_t _slot);
+  void write_count();
+};
+
+}  // namespace hut
@@ -0,0 +1,69 @@
+/*  _ _ _   _       _
+ * | |_| |_| |_ _ _| |_
+ * | | | . |   | | |  _|
+ * |_|_|___|_|_|___|_|
+ * Hobby graphics and GUI library under the MIT License (MIT)
+ *
+ * Copyright (c) 2014 Jean-Baptiste Lepesme github.com/jiboo/libhut
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include "spv.h"
+
+#include "hut/pipeline.hpp"
+
+namespace hut {
+
+/** One rectangle of the rect drawable, from pos to pos + size, multiplying color with texture's texels.
+ * texcoords holds the top-left uv in xy and the bottom-right one in zw, texture is a slot of the display's texture
+ * table (image::slot()), 0 being white. */
+struct rect_instance {
+  glm::vec2 pos;
+  glm::vec2 size;
+  glm::vec4 color;
+  glm::vec4 texcoords = {0, 0, 1, 1};
+  uint32_t texture = 0;
+
+  static constexpr auto layout() {
+    return fields<HUT_FIELD(rect_instance, pos), HUT_FIELD(rect_instance, size), HUT_FIELD(rect_instance, color),
+                  HUT_FIELD(rect_instance, texcoords), HUT_FIELD(rect_instance, texture)>();
+  }
+};
+
+struct rect_shaders {
+  static const auto &vert() {
+    return __spv::rect_vert_spv;
+  }
+  static const auto &frag() {
+    return __spv::rect_frag_spv;
+  }
+  static const auto &frag_compat() {
+    return __spv::rect_compat_frag_spv;
+  }
+  constexpr static bool blend = true;
+};
+
+using rect = instanced<rect_shaders, rect_instance>;
+
+}  // namespace hut
@@ -31,353 +31,57 @@
 
 #include "spv.h"
 
-#include "hut/buffer.hpp"
-#include "hut/color.hpp"
-#include "hut/display.hpp"
-#include "hut/window.hpp"
+#include "hut/pipeline.hpp"
 
 namespace hut {
 
-class rgb_tex {
- private:
-  window &window_;
-  VkShaderModule vert_ = VK_NULL_HANDLE;
-  VkShaderModule frag_ = VK_NULL_HANDLE;
-  VkDescriptorSetLayout descriptor_layout_ = VK_NULL_HANDLE;
-  VkPipelineLayout layout_ = VK_NULL_HANDLE;
-  VkPipeline pipeline_ = VK_NULL_HANDLE;
-  VkDescriptorPool descriptor_pool_ = VK_NULL_HANDLE;
-  VkDescriptorSet descriptor_ = VK_NULL_HANDLE;
+struct rgb_tex_vertex {
+  glm::vec2 pos;
+  glm::vec3 color;
+  glm::vec2 texcoords;
 
- public:
-  struct vertex {
-    glm::vec2 pos;
-    glm::vec3 color;
-    glm::vec2 texcoords;
-
-    static VkVertexInputBindingDescription binding_desc() {
-      VkVertexInputBindingDescription bindingDescription = {};
-      bindingDescription.binding = 0;
-      bindingDescription.stride = sizeof(vertex);
-      bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-
-      return bindingDescription;
-    }
-    static std::array<VkVertexInputAttributeDescription, 3> attributes_desc() {
-      std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions = {};
-
-      attributeDescriptions[0].binding = 0;
-      attributeDescriptions[0].location = 0;
-      attributeDescriptions[0].format = VK_FORMAT_R32G32_SFLOAT;
-      attributeDescriptions[0].offset = offsetof(vertex, pos);
-
-      attributeDescriptions[1].binding = 0;
-      attributeDescriptions[1].location = 1;
-      attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-      attributeDescriptions[1].offset = offsetof(vertex, color);
-
-      attributeDescriptions[2].binding = 0;
-      attributeDescriptions[2].location = 2;
-      attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
-      attributeDescriptions[2].offset = offsetof(vertex, texcoords);
-
-      return attributeDescriptions;
-    }
-  };
-
-  struct ubo {
-    glm::mat4 model;
-    glm::mat4 view;
-    glm::mat4 proj;
-  };
-
-  rgb_tex(window &_window) : window_(_window) {
-    VkDevice device = _window.display_.device_;
-    const glm::uvec2 &size = _window.size_;
-
-    std::array<VkDescriptorPoolSize, 2> poolSizes = {};
-    poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    poolSizes[0].descriptorCount = 1;
-    poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    poolSizes[1].descriptorCount = 1;
-
-    VkDescriptorPoolCreateInfo descPoolInfo = {};
-    descPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    descPoolInfo.poolSizeCount = (uint32_t)poolSizes.size();
-    descPoolInfo.pPoolSizes = poolSizes.data();
-    descPoolInfo.maxSets = 1;
-
-    if (vkCreateDescriptorPool(device, &descPoolInfo, nullptr, &descriptor_pool_) != VK_SUCCESS)
-      throw std::runtime_error("failed to create descriptor pool!");
-
-    VkDescriptorSetLayoutBinding uboLayoutBinding = {};
-    uboLayoutBinding.binding = 0;
-    uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    uboLayoutBinding.descriptorCount = 1;
-    uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-    uboLayoutBinding.pImmutableSamplers = nullptr;
-
-    VkDescriptorSetLayoutBinding samplerLayoutBinding = {};
-    samplerLayoutBinding.binding = 1;
-    samplerLayoutBinding.descriptorCount = 1;
-    samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    samplerLayoutBinding.pImmutableSamplers = nullptr;
-    samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-
-    std::array<VkDescriptorSetLayoutBinding, 2> bindings = {uboLayoutBinding, samplerLayoutBinding};
-
-    VkDescriptorSetLayoutCreateInfo layoutInfo = {};
-    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    layoutInfo.bindingCount = (uint32_t)bindings.size();
-    layoutInfo.pBindings = bindings.data();
-
-    if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &descriptor_layout_) != VK_SUCCESS)
-      throw std::runtime_error("failed to create descriptor set layout!");
-
-    VkDescriptorSetLayout setLayouts[] = {descriptor_layout_};
-    VkDescriptorSetAllocateInfo allocInfo = {};
-    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    allocInfo.descriptorPool = descriptor_pool_;
-    allocInfo.descriptorSetCount = 1;
-    allocInfo.pSetLayouts = setLayouts;
-
-    if (vkAllocateDescriptorSets(device, &allocInfo, &descriptor_) != VK_SUCCESS) {
-      throw std::runtime_error("failed to allocate descriptor set!");
-    }
-
-    auto vertShaderCode = __spv::rgb_tex_vert_spv;
-    auto fragShaderCode = __spv::rgb_tex_frag_spv;
-
-    VkShaderModuleCreateInfo module_info = {};
-    module_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    module_info.codeSize = vertShaderCode.size();
-    module_info.pCode = (uint32_t *)vertShaderCode.data();
-
-    if (vkCreateShaderModule(device, &module_info, nullptr, &vert_) != VK_SUCCESS)
-      throw std::runtime_error("[sample] failed to create vertex module!");
-
-    module_info.codeSize = fragShaderCode.size();
-    module_info.pCode = (uint32_t *)fragShaderCode.data();
-
-    if (vkCreateShaderModule(device, &module_info, nullptr, &frag_) != VK_SUCCESS)
-      throw std::runtime_error("[sample] failed to create fragment module!");
-
-    VkPipelineShaderStageCreateInfo vert_stage_info = {};
-    vert_stage_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    vert_stage_info.stage = VK_SHADER_STAGE_VERTEX_BIT;
-    vert_stage_info.module = vert_;
-    vert_stage_info.pName = "main";
-
-    VkPipelineShaderStageCreateInfo frag_stage_info = {};
-    frag_stage_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    frag_stage_info.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-    frag_stage_info.module = frag_;
-    frag_stage_info.pName = "main";
-
-    VkPipelineShaderStageCreateInfo shaderStages[] = {vert_stage_info, frag_stage_info};
-
-    auto bindingDescription = vertex::binding_desc();
-    auto attributeDescriptions = vertex::attributes_desc();
-
-    VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
-    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-
-    vertexInputInfo.vertexBindingDescriptionCount = 1;
-    vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-    vertexInputInfo.vertexAttributeDescriptionCount = (uint32_t)attributeDescriptions.size();
-    vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
-
-    VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
-    inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-    inputAssembly.primitiveRestartEnable = VK_FALSE;
-
-    VkViewport viewport = {};
-    viewport.x = 0.0f;
-    viewport.y = 0.0f;
-    viewport.width = (float)size.x;
-    viewport.height = (float)size.y;
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
-
-    VkRect2D scissor = {};
-    scissor.offset = {0, 0};
-    scissor.extent = {size.x, size.y};
-
-    VkPipelineViewportStateCreateInfo viewportState = {};
-    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-    viewportState.viewportCount = 1;
-    viewportState.pViewports = &viewport;
-    viewportState.scissorCount = 1;
-    viewportState.pScissors = &scissor;
-
-    VkPipelineRasterizationStateCreateInfo rasterizer = {};
-    rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-    rasterizer.depthClampEnable = VK_FALSE;
-    rasterizer.rasterizerDiscardEnable = VK_FALSE;
-    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-    rasterizer.lineWidth = 1.0f;
-    rasterizer.cullMode = VK_CULL_MODE_FRONT_BIT;
-    rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-
-    rasterizer.depthBiasEnable = VK_FALSE;
-    rasterizer.depthBiasConstantFactor = 0.0f;  // Optional
-    rasterizer.depthBiasClamp = 0.0f;           // Optional
-    rasterizer.depthBiasSlopeFactor = 0.0f;     // Optional
-
-    VkPipelineMultisampleStateCreateInfo multisampling = {};
-    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-    multisampling.sampleShadingEnable = VK_FALSE;
-    multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-    multisampling.minSampleShading = 1.0f;           // Optional
-    multisampling.pSampleMask = nullptr;             /// Optional
-    multisampling.alphaToCoverageEnable = VK_FALSE;  // Optional
-    multisampling.alphaToOneEnable = VK_FALSE;       // Optional
-
-    VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
-    colorBlendAttachment.colorWriteMask =
-        VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-    colorBlendAttachment.blendEnable = VK_FALSE;
-    colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;   // Optional
-    colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;  // Optional
-    colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;              // Optional
-    colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;   // Optional
-    colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;  // Optional
-    colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;              // Optional
-
-    VkPipelineColorBlendStateCreateInfo colorBlending = {};
-    colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-    colorBlending.logicOpEnable = VK_FALSE;
-    colorBlending.logicOp = VK_LOGIC_OP_COPY;  // Optional
-    colorBlending.attachmentCount = 1;
-    colorBlending.pAttachments = &colorBlendAttachment;
-    colorBlending.blendConstants[0] = 0.0f;  // Optional
-    colorBlending.blendConstants[1] = 0.0f;  // Optional
-    colorBlending.blendConstants[2] = 0.0f;  // Optional
-    colorBlending.blendConstants[3] = 0.0f;  // Optional
-
-    const std::vector<VkDynamicState> dynamicStates = {
-        VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR,
-    };
-
-    VkPipelineDynamicStateCreateInfo dynamicState = {};
-    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-    dynamicState.dynamicStateCount = (uint32_t)dynamicStates.size();
-    dynamicState.pDynamicStates = dynamicStates.data();
-
-    VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
-    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutInfo.pushConstantRangeCount = 0;  // Optional
-    pipelineLayoutInfo.pPushConstantRanges = 0;     // Optional
-
-    pipelineLayoutInfo.setLayoutCount = 1;
-    pipelineLayoutInfo.pSetLayouts = setLayouts;
-
-    if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &layout_) != VK_SUCCESS)
-      throw std::runtime_error("[sample] failed to create pipeline layout!");
-
-    VkGraphicsPipelineCreateInfo pipelineInfo = {};
-    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-    pipelineInfo.stageCount = 2;
-    pipelineInfo.pStages = shaderStages;
-    pipelineInfo.pVertexInputState = &vertexInputInfo;
-    pipelineInfo.pInputAssemblyState = &inputAssembly;
-    pipelineInfo.pViewportState = &viewportState;
-    pipelineInfo.pRasterizationState = &rasterizer;
-    pipelineInfo.pMultisampleState = &multisampling;
-    pipelineInfo.pDepthStencilState = nullptr;  // Optional
-    pipelineInfo.pColorBlendState = &colorBlending;
-    pipelineInfo.pDynamicState = &dynamicState;  // Optional
-    pipelineInfo.layout = layout_;
-    pipelineInfo.renderPass = window_.renderpass_;
-    pipelineInfo.subpass = 0;
-    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
-    pipelineInfo.basePipelineIndex = -1;  // Optional
-
-    if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline_) != VK_SUCCESS) {
-      throw std::runtime_error("failed to create graphics pipeline!");
-    }
+  static constexpr auto layout() {
+    return fields<HUT_FIELD(rgb_tex_vertex, pos),
+                  HUT_FIELD(rgb_tex_vertex, color),
+                  HUT_FIELD(rgb_tex_vertex, texcoords)>();
   }
+};
 
-  ~rgb_tex() {
-    VkDevice device = window_.display_.device_;
-    vkDeviceWaitIdle(device);
-    if (descriptor_layout_ != VK_NULL_HANDLE)
-      vkDestroyDescriptorSetLayout(device, descriptor_layout_, nullptr);
-    if (descriptor_pool_ != VK_NULL_HANDLE)
-      vkDestroyDescriptorPool(device, descriptor_pool_, nullptr);
-    if (pipeline_ != VK_NULL_HANDLE)
-      vkDestroyPipeline(device, pipeline_, nullptr);
-    if (layout_ != VK_NULL_HANDLE)
-      vkDestroyPipelineLayout(device, layout_, nullptr);
-    if (vert_ != VK_NULL_HANDLE)
-      vkDestroyShaderModule(device, vert_, nullptr);
-    if (frag_ != VK_NULL_HANDLE)
-      vkDestroyShaderModule(device, frag_, nullptr);
+struct rgb_tex_shaders {
+  static const auto &vert() {
+    return __spv::rgb_tex_vert_spv;
   }
-
-  template <typename TVertices>
-  void draw(VkCommandBuffer _buffer, const glm::uvec2 &_size, const shared_ref<TVertices> &_vertices,
-            const shared_ref<uint16_t> &_indices) {
-    window_.display_.check_thread();
-
-    vkCmdBindPipeline(_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_);
-
-    VkBuffer vertexBuffers[] = {_vertices->buffer_.buffer_};
-    VkDeviceSize offsets[] = {_vertices->offset_};
-    vkCmdBindVertexBuffers(_buffer, 0, 1, vertexBuffers, offsets);
-    vkCmdBindIndexBuffer(_buffer, _indices->buffer_.buffer_, _indices->offset_, VK_INDEX_TYPE_UINT16);
-
-    vkCmdBindDescriptorSets(_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, layout_, 0, 1, &descriptor_, 0, nullptr);
-
-    VkRect2D scissor = {};
-    scissor.offset = {0, 0};
-    scissor.extent = {_size.x, _size.y};
-    vkCmdSetScissor(_buffer, 0, 1, &scissor);
-
-    VkViewport viewport = {};
-    viewport.x = 0.0f;
-    viewport.y = 0.0f;
-    viewport.width = (float)_size.x;
-    viewport.height = (float)_size.y;
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
-    vkCmdSetViewport(_buffer, 0, 1, &viewport);
-
-    vkCmdDrawIndexed(_buffer, _indices->count(), 1, 0, 0, 0);
+  static const auto &frag() {
+    return __spv::rgb_tex_frag_spv;
   }
+  constexpr static bool blend = false;
+};
 
-  void bind(const shared_ref<ubo> &_ubo, const shared_image &_tex, const sampler &_sampler) {
-    VkDescriptorBufferInfo bufferInfo = {};
-    bufferInfo.buffer = _ubo->buffer_.buffer_;
-    bufferInfo.offset = _ubo->offset_;
-    bufferInfo.range = _ubo->size_;
-
-    VkDescriptorImageInfo imageInfo = {};
-    imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-    imageInfo.imageView = _tex->view_;
-    imageInfo.sampler = _sampler.sampler_;
-
-    std::array<VkWriteDescriptorSet, 2> descriptorWrites = {};
+using rgb_tex = pipeline<rgb_tex_shaders, rgb_tex_vertex>;
 
-    descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    descriptorWrites[0].dstSet = descriptor_;
-    descriptorWrites[0].dstBinding = 0;
-    descriptorWrites[0].dstArrayElement = 0;
-    descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    descriptorWrites[0].descriptorCount = 1;
-    descriptorWrites[0].pBufferInfo = &bufferInfo;
+/** rgb_tex_vertex in 12 bytes: whole pixel positions and normalized attributes, filled with pack(). The alpha channel of the color is ignored. */
+struct rgb_tex_compact_vertex {
+  sint16x2 pos;
+  unorm8x4 color;
+  unorm16x2 texcoords;
 
-    descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    descriptorWrites[1].dstSet = descriptor_;
-    descriptorWrites[1].dstBinding = 1;
-    descriptorWrites[1].dstArrayElement = 0;
-    descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    descriptorWrites[1].descriptorCount = 1;
-    descriptorWrites[1].pImageInfo = &imageInfo;
+  static constexpr auto layout() {
+    return fields<HUT_FIELD(rgb_tex_compact_vertex, pos),
+                  HUT_FIELD(rgb_tex_compact_vertex, color),
+                  HUT_FIELD(rgb_tex_compact_vertex, texcoords)>();
+  }
+};
 
-    vkUpdateDescriptorSets(window_.display_.device_, descriptorWrites.size(), descriptorWrites.data(), 0, nullptr);
+struct rgb_tex_compact_shaders {
+  static const auto &vert() {
+    return __spv::rgb_tex_compact_vert_spv;
+  }
+  static const auto &frag() {
+    return __spv::rgb_tex_frag_spv;
   }
+  constexpr static bool blend = false;
 };
 
+using rgb_tex_compact = pipeline<rgb_tex_compact_shaders, rgb_tex_compact_vertex>;
+
 }  // namespace hut
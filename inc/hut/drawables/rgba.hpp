@@ -31,321 +31,51 @@
 
 #include "spv.h"
 
-#include "hut/buffer.hpp"
-#include "hut/color.hpp"
-#include "hut/display.hpp"
-#include "hut/window.hpp"
+#include "hut/pipeline.hpp"
 
 namespace hut {
 
-class rgba {
- private:
-  window &window_;
-  VkShaderModule vert_ = VK_NULL_HANDLE;
-  VkShaderModule frag_ = VK_NULL_HANDLE;
-  VkDescriptorSetLayout descriptor_layout_ = VK_NULL_HANDLE;
-  VkPipelineLayout layout_ = VK_NULL_HANDLE;
-  VkPipeline pipeline_ = VK_NULL_HANDLE;
-  VkDescriptorPool descriptor_pool_ = VK_NULL_HANDLE;
-  VkDescriptorSet descriptor_ = VK_NULL_HANDLE;
+struct rgba_vertex {
+  glm::vec2 pos;
+  glm::vec4 color;
 
- public:
-  struct vertex {
-    glm::vec2 pos;
-    glm::vec4 color;
-
-    static VkVertexInputBindingDescription binding_desc() {
-      VkVertexInputBindingDescription desc = {};
-      desc.binding = 0;
-      desc.stride = sizeof(vertex);
-      desc.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-
-      return desc;
-    }
-    static std::array<VkVertexInputAttributeDescription, 2> attributes_desc() {
-      std::array<VkVertexInputAttributeDescription, 2> descs = {};
-      descs[0].binding = 0;
-      descs[0].location = 0;
-      descs[0].format = VK_FORMAT_R32G32_SFLOAT;
-      descs[0].offset = offsetof(vertex, pos);
-      descs[1].binding = 0;
-      descs[1].location = 1;
-      descs[1].format = VK_FORMAT_R32G32B32A32_SFLOAT;
-      descs[1].offset = offsetof(vertex, color);
-      return descs;
-    }
-  };
-
-  struct ubo {
-    glm::mat4 model;
-    glm::mat4 view;
-    glm::mat4 proj;
-  };
-
-  rgba(window &_window) : window_(_window) {
-    VkDevice device = _window.display_.device_;
-    const glm::uvec2 &size = _window.size_;
-
-    VkDescriptorPoolSize pool_sizes = {};
-    pool_sizes.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    pool_sizes.descriptorCount = 1;
-
-    VkDescriptorPoolCreateInfo pool_info = {};
-    pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    pool_info.poolSizeCount = 1;
-    pool_info.pPoolSizes = &pool_sizes;
-    pool_info.maxSets = 1;
-
-    if (vkCreateDescriptorPool(device, &pool_info, nullptr, &descriptor_pool_) != VK_SUCCESS)
-      throw std::runtime_error("failed to create descriptor pool!");
-
-    VkDescriptorSetLayoutBinding ubo_binding = {};
-    ubo_binding.binding = 0;
-    ubo_binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    ubo_binding.descriptorCount = 1;
-    ubo_binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-    ubo_binding.pImmutableSamplers = nullptr;
-
-    VkDescriptorSetLayoutCreateInfo layout_info = {};
-    layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    layout_info.bindingCount = 1;
-    layout_info.pBindings = &ubo_binding;
-
-    if (vkCreateDescriptorSetLayout(device, &layout_info, nullptr, &descriptor_layout_) != VK_SUCCESS)
-      throw std::runtime_error("failed to create descriptor set layout!");
-
-    VkDescriptorSetLayout layouts[] = {descriptor_layout_};
-    VkDescriptorSetAllocateInfo alloc_info = {};
-    alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    alloc_info.descriptorPool = descriptor_pool_;
-    alloc_info.descriptorSetCount = 1;
-    alloc_info.pSetLayouts = layouts;
-
-    if (vkAllocateDescriptorSets(device, &alloc_info, &descriptor_) != VK_SUCCESS) {
-      throw std::runtime_error("failed to allocate descriptor set!");
-    }
-
-    auto vshader_code = __spv::rgba_vert_spv;
-    auto fshader_code = __spv::rgba_frag_spv;
-
-    VkShaderModuleCreateInfo module_info = {};
-    module_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    module_info.codeSize = vshader_code.size();
-    module_info.pCode = (uint32_t *)vshader_code.data();
-
-    if (vkCreateShaderModule(device, &module_info, nullptr, &vert_) != VK_SUCCESS)
-      throw std::runtime_error("[sample] failed to create vertex module!");
-
-    module_info.codeSize = fshader_code.size();
-    module_info.pCode = (uint32_t *)fshader_code.data();
-
-    if (vkCreateShaderModule(device, &module_info, nullptr, &frag_) != VK_SUCCESS)
-      throw std::runtime_error("[sample] failed to create fragment module!");
-
-    VkPipelineShaderStageCreateInfo vert_stage_info = {};
-    vert_stage_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    vert_stage_info.stage = VK_SHADER_STAGE_VERTEX_BIT;
-    vert_stage_info.module = vert_;
-    vert_stage_info.pName = "main";
-
-    VkPipelineShaderStageCreateInfo frag_stage_info = {};
-    frag_stage_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    frag_stage_info.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-    frag_stage_info.module = frag_;
-    frag_stage_info.pName = "main";
-
-    VkPipelineShaderStageCreateInfo stages[] = {vert_stage_info, frag_stage_info};
-
-    auto bindings = vertex::binding_desc();
-    auto attributes = vertex::attributes_desc();
-
-    VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
-    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-
-    vertexInputInfo.vertexBindingDescriptionCount = 1;
-    vertexInputInfo.pVertexBindingDescriptions = &bindings;
-    vertexInputInfo.vertexAttributeDescriptionCount = (uint32_t)attributes.size();
-    vertexInputInfo.pVertexAttributeDescriptions = attributes.data();
-
-    VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
-    inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-    inputAssembly.primitiveRestartEnable = VK_FALSE;
-
-    VkViewport viewport = {};
-    viewport.x = 0.0f;
-    viewport.y = 0.0f;
-    viewport.width = (float)size.x;
-    viewport.height = (float)size.y;
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
-
-    VkRect2D scissor = {};
-    scissor.offset = {0, 0};
-    scissor.extent = {size.x, size.y};
-
-    VkPipelineViewportStateCreateInfo viewportState = {};
-    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-    viewportState.viewportCount = 1;
-    viewportState.pViewports = &viewport;
-    viewportState.scissorCount = 1;
-    viewportState.pScissors = &scissor;
-
-    VkPipelineRasterizationStateCreateInfo rasterizer = {};
-    rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-    rasterizer.depthClampEnable = VK_FALSE;
-    rasterizer.rasterizerDiscardEnable = VK_FALSE;
-    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-    rasterizer.lineWidth = 1.0f;
-    rasterizer.cullMode = VK_CULL_MODE_FRONT_BIT;
-    rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-
-    rasterizer.depthBiasEnable = VK_FALSE;
-    rasterizer.depthBiasConstantFactor = 0.0f;  // Optional
-    rasterizer.depthBiasClamp = 0.0f;           // Optional
-    rasterizer.depthBiasSlopeFactor = 0.0f;     // Optional
-
-    VkPipelineMultisampleStateCreateInfo multisampling = {};
-    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-    multisampling.sampleShadingEnable = VK_FALSE;
-    multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-    multisampling.minSampleShading = 1.0f;           // Optional
-    multisampling.pSampleMask = nullptr;             // Optional
-    multisampling.alphaToCoverageEnable = VK_FALSE;  // Optional
-    multisampling.alphaToOneEnable = VK_FALSE;       // Optional
-
-    VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
-    colorBlendAttachment.colorWriteMask =
-        VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-    colorBlendAttachment.blendEnable = VK_TRUE;
-    colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
-    colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
-    colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
-    colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-    colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-    colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
-
-    VkPipelineColorBlendStateCreateInfo colorBlending = {};
-    colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-    colorBlending.logicOpEnable = VK_FALSE;
-    colorBlending.logicOp = VK_LOGIC_OP_COPY;  // Optional
-    colorBlending.attachmentCount = 1;
-    colorBlending.pAttachments = &colorBlendAttachment;
-    colorBlending.blendConstants[0] = 0.0f;  // Optional
-    colorBlending.blendConstants[1] = 0.0f;  // Optional
-    colorBlending.blendConstants[2] = 0.0f;  // Optional
-    colorBlending.blendConstants[3] = 0.0f;  // Optional
-
-    const std::vector<VkDynamicState> dynamicStates = {
-        VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR,
-    };
-
-    VkPipelineDynamicStateCreateInfo dynamicState = {};
-    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-    dynamicState.dynamicStateCount = (uint32_t)dynamicStates.size();
-    dynamicState.pDynamicStates = dynamicStates.data();
-
-    VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
-    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutInfo.pushConstantRangeCount = 0;  // Optional
-    pipelineLayoutInfo.pPushConstantRanges = nullptr;     // Optional
-
-    pipelineLayoutInfo.setLayoutCount = 1;
-    pipelineLayoutInfo.pSetLayouts = layouts;
-
-    if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &layout_) != VK_SUCCESS)
-      throw std::runtime_error("[sample] failed to create pipeline layout!");
-
-    VkGraphicsPipelineCreateInfo pipelineInfo = {};
-    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-    pipelineInfo.stageCount = 2;
-    pipelineInfo.pStages = stages;
-    pipelineInfo.pVertexInputState = &vertexInputInfo;
-    pipelineInfo.pInputAssemblyState = &inputAssembly;
-    pipelineInfo.pViewportState = &viewportState;
-    pipelineInfo.pRasterizationState = &rasterizer;
-    pipelineInfo.pMultisampleState = &multisampling;
-    pipelineInfo.pDepthStencilState = nullptr;  // Optional
-    pipelineInfo.pColorBlendState = &colorBlending;
-    pipelineInfo.pDynamicState = &dynamicState;  // Optional
-    pipelineInfo.layout = layout_;
-    pipelineInfo.renderPass = window_.renderpass_;
-    pipelineInfo.subpass = 0;
-    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
-    pipelineInfo.basePipelineIndex = -1;  // Optional
-
-    if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline_) != VK_SUCCESS) {
-      throw std::runtime_error("failed to create graphics pipeline!");
-    }
+  static constexpr auto layout() {
+    return fields<HUT_FIELD(rgba_vertex, pos), HUT_FIELD(rgba_vertex, color)>();
   }
+};
 
-  ~rgba() {
-    VkDevice device = window_.display_.device_;
-    vkDeviceWaitIdle(device);
-    if (descriptor_layout_ != VK_NULL_HANDLE)
-      vkDestroyDescriptorSetLayout(device, descriptor_layout_, nullptr);
-    if (descriptor_pool_ != VK_NULL_HANDLE)
-      vkDestroyDescriptorPool(device, descriptor_pool_, nullptr);
-    if (pipeline_ != VK_NULL_HANDLE)
-      vkDestroyPipeline(device, pipeline_, nullptr);
-    if (layout_ != VK_NULL_HANDLE)
-      vkDestroyPipelineLayout(device, layout_, nullptr);
-    if (vert_ != VK_NULL_HANDLE)
-      vkDestroyShaderModule(device, vert_, nullptr);
-    if (frag_ != VK_NULL_HANDLE)
-      vkDestroyShaderModule(device, frag_, nullptr);
+struct rgba_shaders {
+  static const auto &vert() {
+    return __spv::rgba_vert_spv;
   }
+  static const auto &frag() {
+    return __spv::rgba_frag_spv;
+  }
+  constexpr static bool blend = true;
+};
 
-  template <typename TVertices>
-  void draw(VkCommandBuffer _buffer, const glm::uvec2 &_size, const shared_ref<TVertices> &_vertices,
-            const shared_ref<uint16_t> &_indices) {
-    window_.display_.check_thread();
-
-    vkCmdBindPipeline(_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_);
-
-    VkBuffer vertexBuffers[] = {_vertices->buffer_.buffer_};
-    VkDeviceSize offsets[] = {_vertices->offset_};
-    vkCmdBindVertexBuffers(_buffer, 0, 1, vertexBuffers, offsets);
-    vkCmdBindIndexBuffer(_buffer, _indices->buffer_.buffer_, _indices->offset_, VK_INDEX_TYPE_UINT16);
-
-    vkCmdBindDescriptorSets(_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, layout_, 0, 1, &descriptor_, 0, nullptr);
-
-    VkRect2D scissor = {};
-    scissor.offset = {0, 0};
-    scissor.extent = {_size.x, _size.y};
-    vkCmdSetScissor(_buffer, 0, 1, &scissor);
+using rgba = pipeline<rgba_shaders, rgba_vertex>;
 
-    VkViewport viewport = {};
-    viewport.x = 0.0f;
-    viewport.y = 0.0f;
-    viewport.width = (float)_size.x;
-    viewport.height = (float)_size.y;
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
-    vkCmdSetViewport(_buffer, 0, 1, &viewport);
+/** rgba_vertex in 8 bytes: whole pixel positions and normalized attributes, filled with pack(). */
+struct rgba_compact_vertex {
+  sint16x2 pos;
+  unorm8x4 color;
 
-    vkCmdDrawIndexed(_buffer, _indices->count(), 1, 0, 0, 0);
+  static constexpr auto layout() {
+    return fields<HUT_FIELD(rgba_compact_vertex, pos), HUT_FIELD(rgba_compact_vertex, color)>();
   }
+};
 
-  void bind(const shared_ref<ubo> &_ubo) {
-    VkDescriptorBufferInfo bufferInfo = {};
-    bufferInfo.buffer = _ubo->buffer_.buffer_;
-    bufferInfo.offset = _ubo->offset_;
-    bufferInfo.range = _ubo->size_;
-
-    VkWriteDescriptorSet descriptorWrite = {};
-    descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    descriptorWrite.dstSet = descriptor_;
-    descriptorWrite.dstBinding = 0;
-    descriptorWrite.dstArrayElement = 0;
-    descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    descriptorWrite.descriptorCount = 1;
-    descriptorWrite.pBufferInfo = &bufferInfo;
-    descriptorWrite.pImageInfo = nullptr;        // Optional
-    descriptorWrite.pTexelBufferView = nullptr;  // Optional
-
-    vkUpdateDescriptorSets(window_.display_.device_, 1, &descriptorWrite, 0, nullptr);
+struct rgba_compact_shaders {
+  static const auto &vert() {
+    return __spv::rgba_compact_vert_spv;
+  }
+  static const auto &frag() {
+    return __spv::rgba_frag_spv;
   }
+  constexpr static bool blend = true;
 };
 
+using rgba_compact = pipeline<rgba_compact_shaders, rgba_compact_vertex>;
+
 }  // namespace hut
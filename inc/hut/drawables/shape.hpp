@@ -0,0 +1,79 @@
+/*  _ _ _   _       _
+ * | |_| |_| |_ _ _| |_
+ * | | | . |   | | |  _|
+ * |_|_|___|_|_|___|_|
+ * Hobby graphics and GUI library under the MIT License (MIT)
+ *
+ * Copyright (c) 2014 Jean-Baptiste Lepesme github.com/jiboo/libhut
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include "spv.h"
+
+#include "hut/pipeline.hpp"
+
+namespace hut {
+
+/** Shapes drawn by the shape drawable. */
+enum shape_kind : uint32_t {
+  SHAPE_BOX,      // rounded with radii
+  SHAPE_ELLIPSE,  // inscribed in the box, radii are ignored
+};
+
+/** One shape of the shape drawable, in the box from pos to pos + size, evaluated as a signed distance in the fragment
+ * shader and anti-aliased over a pixel. radii are the corners' in the order top-left, top-right, bottom-right,
+ * bottom-left. A stroke over 0 draws a border of that width inside the shape, with stroke_color over fill.
+ * A blur over 0 draws a drop shadow instead: fill, softened by a gaussian of that deviation, which extends up to
+ * 3 * blur out of the box. As with rect, instances start with pos and size so that a culler can cull them. */
+struct shape_instance {
+  glm::vec2 pos;
+  glm::vec2 size;
+  glm::vec4 radii = {0, 0, 0, 0};
+  glm::vec4 fill;
+  glm::vec4 stroke_color = {0, 0, 0, 0};
+  float stroke = 0;
+  float blur = 0;
+  uint32_t kind = SHAPE_BOX;
+
+  static constexpr auto layout() {
+    return fields<HUT_FIELD(shape_instance, pos), HUT_FIELD(shape_instance, size), HUT_FIELD(shape_instance, radii),
+                  HUT_FIELD(shape_instance, fill), HUT_FIELD(shape_instance, stroke_color),
+                  HUT_FIELD(shape_instance, stroke), HUT_FIELD(shape_instance, blur),
+                  HUT_FIELD(shape_instance, kind)>();
+  }
+};
+
+struct shape_shaders {
+  static const auto &vert() {
+    return __spv::shape_vert_spv;
+  }
+  static const auto &frag() {
+    return __spv::shape_frag_spv;
+  }
+  constexpr static bool blend = true;
+};
+
+using shape = instanced<shape_shaders, shape_instance>;
+
+}  // namespace hut
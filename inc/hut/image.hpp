@@ -27,8 +27,10 @@
 
 #pragma once
 
+#include <limits>
 #include <memory>
 #include <set>
+#include <stdexcept>
 
 #include <glm/glm.hpp>
 
@@ -40,22 +42,43 @@ class display;
 
 class image {
   friend class display;
-  friend class rgb;
-  friend class rgba;
-  friend class tex;
-  friend class rgb_tex;
-  friend class rgba_tex;
+  friend struct image_binding;
+  template <typename...>
+  friend class drawable;
 
  public:
   static std::shared_ptr<image> load_png(display &, const uint8_t *_data, size_t _size);
+  /** Image of _size pixels in _format, from rows of _row_pitch bytes. _swizzle maps the channels when sampled,
+   * for example {ONE, ONE, ONE, R} makes a VK_FORMAT_R8_UNORM image a white alpha mask. */
+  static std::shared_ptr<image> load_raw(display &, const uint8_t *_data, size_t _row_pitch, glm::uvec2 _size,
+                                         VkFormat _format, VkComponentMapping _swizzle = {});
 
-  image(display &_display, glm::uvec2 _size, VkFormat _format, VkImage _staging_image, VkDeviceMemory _staging_memory);
+  image(display &_display, glm::uvec2 _size, VkFormat _format, VkImage _staging_image, VkDeviceMemory _staging_memory,
+        VkComponentMapping _swizzle = {});
   ~image();
 
+  glm::uvec2 size() const {
+    return size_;
+  }
+
+  /** Uploads the _size pixels at _offset from rows of _row_pitch bytes, the rest of the image is kept.
+   * Staged like the first upload, draws recorded before it is done may sample either content. */
+  void update(glm::uvec2 _offset, glm::uvec2 _size, const uint8_t *_data, size_t _row_pitch);
+
+  constexpr static uint32_t no_slot = std::numeric_limits<uint32_t>::max();
+  /** Slot of the image in the display's texture table, for draw_constants::texture or instance attributes.
+   * Throws if the table was full when the image was created. */
+  uint32_t slot() const {
+    if (slot_ == no_slot)
+      throw std::runtime_error("image has no texture slot, the texture table is full!");
+    return slot_;
+  }
+
  private:
   static VkDeviceSize create(display &_display, uint32_t _width, uint32_t _height, VkFormat _format,
                              VkImageTiling _tiling, VkImageUsageFlags _usage, VkMemoryPropertyFlags _properties,
                              VkImage *_image, VkDeviceMemory *_imageMemory);
+  static uint32_t texel_size(VkFormat _format);
 
   display &display_;
   glm::uvec2 size_;
@@ -64,6 +87,7 @@ class image {
   VkImage image_;
   VkDeviceMemory memory_;
   VkImageView view_;
+  uint32_t slot_ = no_slot;
 };
 
 using shared_image = std::shared_ptr<image>;
@@ -0,0 +1,78 @@
+/*  _ _ _   _       _
+ * | |_| |_| |_ _ _| |_
+ * | | | . |   | | |  _|
+ * |_|_|___|_|_|___|_|
+ * Hobby graphics and GUI library under the MIT License (MIT)
+ *
+ * Copyright (c) 2014 Jean-Baptiste Lepesme github.com/jiboo/libhut
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include <glm/vec2.hpp>
+
+#include "hut/descriptors.hpp"
+#include "hut/recorder.hpp"
+#include "hut/utils.hpp"
+
+namespace hut {
+
+class window;
+
+/** Part of a window's content, recorded once per swapchain image into its own secondary command buffers.
+ * The window only re-records the nodes that have been invalidated, the others are replayed as is.
+ * Nodes are spread over the display recording threads, so on_draw may be fired from any of them, except for the
+ * window root node (window::on_draw) which is always recorded by the dispatcher.
+ * A node must not outlive its window. */
+class node {
+  friend class window;
+
+ public:
+  event<recorder &, glm::uvec2 /*canvas_size*/> on_draw;
+
+  explicit node(window &_window);
+  ~node();
+
+  node(const node &) = delete;
+  node &operator=(const node &) = delete;
+
+  /** Calls on_draw again on the next frames, leaving the other nodes of the window untouched. */
+  void invalidate();
+
+ protected:
+  window &window_;
+  size_t pool_;  // index in display::record_pools_, decides which thread records this node
+  std::vector<VkCommandBuffer> cbs_;
+  std::vector<bool> dirty_;
+  std::vector<std::unique_ptr<descriptor_cache>> descriptors_;  // per image, reset when recording it again
+  recorder_stats recorded_;  // by the last recording
+
+  void init_cbs(size_t _images_count);
+  void destroy_cbs();
+  bool record(uint32_t _image_index);
+};
+
+}  // namespace hut
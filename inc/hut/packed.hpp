@@ -0,0 +1,75 @@
+/*  _ _ _   _       _
+ * | |_| |_| |_ _ _| |_
+ * | | | . |   | | |  _|
+ * |_|_|___|_|_|___|_|
+ * Hobby graphics and GUI library under the MIT License (MIT)
+ *
+ * Copyright (c) 2014 Jean-Baptiste Lepesme github.com/jiboo/libhut
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+namespace hut {
+
+/** Compact vertex attributes, each four bytes wide, fed to shaders through their VkFormat. */
+
+/** Position in whole pixels, read as an ivec2 (R16G16_SINT). */
+struct sint16x2 {
+  int16_t x, y;
+};
+
+/** Half-float vector, read as a vec2 (R16G16_SFLOAT). */
+struct half2 {
+  uint16_t x, y;
+};
+
+/** Color normalized to [0, 1], read as a vec4 (R8G8B8A8_UNORM). */
+struct unorm8x4 {
+  uint8_t r, g, b, a;
+};
+
+/** Texture coordinates normalized to [0, 1], read as a vec2 (R16G16_UNORM). */
+struct unorm16x2 {
+  uint16_t x, y;
+};
+
+/** Pack _count values of _src into _dst, whose elements are _stride bytes apart so that a single member of an array
+ * of vertices can be filled. Values are rounded to nearest and saturated to the range of the destination. */
+void pack(const glm::vec2 *_src, size_t _count, sint16x2 *_dst, size_t _stride = sizeof(sint16x2));
+void pack(const glm::vec2 *_src, size_t _count, half2 *_dst, size_t _stride = sizeof(half2));
+void pack(const glm::vec3 *_src, size_t _count, unorm8x4 *_dst, size_t _stride = sizeof(unorm8x4));
+void pack(const glm::vec4 *_src, size_t _count, unorm8x4 *_dst, size_t _stride = sizeof(unorm8x4));
+void pack(const glm::vec2 *_src, size_t _count, unorm16x2 *_dst, size_t _stride = sizeof(unorm16x2));
+
+/** Pack a single value, see above. */
+template <typename TDst, typename TSrc>
+TDst pack(const TSrc &_src) {
+  TDst result;
+  pack(&_src, 1, &result);
+  return result;
+}
+
+}  // namespace hut
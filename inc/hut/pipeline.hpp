@@ -0,0 +1,571 @@
+/*  _ _ _   _       _
+ * | |_| |_| |_ _ _| |_
+ * | | | . |   | | |  _|
+ * |_|_|___|_|_|___|_|
+ * Hobby graphics and GUI library under the MIT License (MIT)
+ *
+ * Copyright (c) 2014 Jean-Baptiste Lepesme github.com/jiboo/libhut
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "hut/batch.hpp"
+#include "hut/buffer.hpp"
+#include "hut/culler.hpp"
+#include "hut/descriptors.hpp"
+#include "hut/display.hpp"
+#include "hut/draw_list.hpp"
+#include "hut/image.hpp"
+#include "hut/packed.hpp"
+#include "hut/recorder.hpp"
+#include "hut/shared_pipeline.hpp"
+#include "hut/window.hpp"
+
+namespace hut {
+
+/** VkFormat of a vertex attribute of type T. */
+template <typename T>
+struct vertex_format;
+template <>
+struct vertex_format<float> {
+  constexpr static VkFormat value = VK_FORMAT_R32_SFLOAT;
+};
+template <>
+struct vertex_format<uint32_t> {
+  constexpr static VkFormat value = VK_FORMAT_R32_UINT;
+};
+template <>
+struct vertex_format<glm::vec2> {
+  constexpr static VkFormat value = VK_FORMAT_R32G32_SFLOAT;
+};
+template <>
+struct vertex_format<glm::vec3> {
+  constexpr static VkFormat value = VK_FORMAT_R32G32B32_SFLOAT;
+};
+template <>
+struct vertex_format<glm::vec4> {
+  constexpr static VkFormat value = VK_FORMAT_R32G32B32A32_SFLOAT;
+};
+template <>
+struct vertex_format<sint16x2> {
+  constexpr static VkFormat value = VK_FORMAT_R16G16_SINT;
+};
+template <>
+struct vertex_format<half2> {
+  constexpr static VkFormat value = VK_FORMAT_R16G16_SFLOAT;
+};
+template <>
+struct vertex_format<unorm8x4> {
+  constexpr static VkFormat value = VK_FORMAT_R8G8B8A8_UNORM;
+};
+template <>
+struct vertex_format<unorm16x2> {
+  constexpr static VkFormat value = VK_FORMAT_R16G16_UNORM;
+};
+
+/** VkIndexType of indices of type T. */
+template <typename T>
+struct index_format;
+template <>
+struct index_format<uint16_t> {
+  constexpr static VkIndexType value = VK_INDEX_TYPE_UINT16;
+};
+template <>
+struct index_format<uint32_t> {
+  constexpr static VkIndexType value = VK_INDEX_TYPE_UINT32;
+};
+
+/** Vertex attribute of type T at TOffset in its vertex, usually declared with HUT_FIELD. */
+template <typename T, size_t TOffset, VkFormat TFormat = vertex_format<T>::value>
+struct field {
+  using type = T;
+  constexpr static uint32_t offset = TOffset;
+  constexpr static VkFormat format = TFormat;
+};
+
+/** Attributes of a vertex type, the shader location of each field is its rank in the list.
+ * Vertex types return theirs from a static layout() function, so that offsetof() is evaluated on a complete type:
+ *   struct vertex {
+ *     glm::vec2 pos;
+ *     static constexpr auto layout() { return fields<HUT_FIELD(vertex, pos)>(); }
+ *   };
+ */
+template <typename... TFields>
+struct fields {
+  constexpr static size_t count = sizeof...(TFields);
+
+  constexpr static std::array<VkVertexInputAttributeDescription, count> attributes(uint32_t _binding = 0,
+                                                                                   uint32_t _first_location = 0) {
+    return attributes(_binding, _first_location, std::index_sequence_for<TFields...>());
+  }
+
+ private:
+  template <size_t... TIndices>
+  constexpr static std::array<VkVertexInputAttributeDescription, count> attributes(uint32_t _binding,
+                                                                                   uint32_t _first_location,
+                                                                                   std::index_sequence<TIndices...>) {
+    return {{VkVertexInputAttributeDescription{_first_location + (uint32_t)TIndices, _binding, TFields::format,
+                                               TFields::offset}...}};
+  }
+};
+
+#define HUT_FIELD(type, member) hut::field<decltype(type::member), offsetof(type, member)>
+
+/** Descriptor binding of a drawable: an image sampled by the fragment shader. */
+struct image_binding {
+  constexpr static VkDescriptorType type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  constexpr static VkShaderStageFlags stages = VK_SHADER_STAGE_FRAGMENT_BIT;
+  constexpr static uint32_t count = 1;
+
+  struct resource {
+    const shared_image &image_;
+    const sampler &sampler_;
+  };
+  using info = VkDescriptorImageInfo;
+
+  static void write(display &, VkWriteDescriptorSet &_write, info &_info, const resource &_resource) {
+    _info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    _info.imageView = _resource.image_->view_;
+    _info.sampler = _resource.sampler_.sampler_;
+    _write.pImageInfo = &_info;
+  }
+
+  /** What the recordings using the set keep alive, see descriptor_cache::get(). */
+  static std::shared_ptr<const void> owner(const resource &_resource) {
+    return _resource.image_;
+  }
+};
+
+/** Fragment shader used when the display isn't bindless: TShaders::frag_compat() if there's one, for shaders indexing
+ * the texture table with values varying within a draw, TShaders::frag() otherwise. */
+template <typename TShaders, typename = void>
+struct compat_frag {
+  static const auto &get() {
+    return TShaders::frag();
+  }
+};
+template <typename TShaders>
+struct compat_frag<TShaders, std::void_t<decltype(TShaders::frag_compat())>> {
+  static const auto &get() {
+    return TShaders::frag_compat();
+  }
+};
+
+/** Shared pipeline and descriptor set of a drawable, set 2 holding one binding per TBindings.
+ * Set 0 is the window's view and projection, set 1 the display's texture table, and draw_constants are pushed for
+ * each draw. pipeline and instanced add their vertex input and draw() on top of it.
+ * Set 2 is taken from the recorder's descriptor_cache at each draw, for the resources of the last bind(). */
+template <typename... TBindings>
+class drawable {
+ public:
+  ~drawable() {
+    vkDeviceWaitIdle(display_.device_);
+  }
+
+  drawable(const drawable &) = delete;
+  drawable &operator=(const drawable &) = delete;
+
+  /** False while the pipeline is compiled in the background, draw() does nothing until then. */
+  bool ready() {
+    return pipeline_->ready();
+  }
+  /** Blocks until the pipeline is compiled. */
+  void wait() {
+    pipeline_->wait();
+  }
+
+  /** Blending of the next draws. Unless display::dynamic_blend(), each mode uses its own pipeline variant, compiled
+   * in the background the first time it's used and shared with the other drawables through the display. */
+  void blend(blend_mode _mode) {
+    blend_ = _mode;
+    if (display_.dynamic_blend())
+      return;
+
+    auto &variant = variants_[_mode];
+    if (!variant) {
+      pipeline_desc desc = pipeline_->desc_;
+      desc.blending(_mode);
+      variant = display_.get_pipeline(desc);
+    }
+    pipeline_ = variant;
+  }
+  blend_mode blend() {
+    return blend_;
+  }
+
+  /** Binds one resource per descriptor binding for the next draws, for example {image, sampler} for image_binding.
+   * Nothing is written until a draw needs the set, binding again resources already used is free.
+   * The recordings drawing with them keep them alive, they may be released right after binding others. */
+  void bind(const typename TBindings::resource &... _resources) {
+    if (sizeof...(TBindings) == 0)
+      return;
+
+    bound_.resize(set_layout_->size());
+    serialize(std::index_sequence_for<TBindings...>(), _resources...);
+    owners_ = {TBindings::owner(_resources)...};
+  }
+
+ protected:
+  window &window_;
+  display &display_;
+  std::shared_ptr<shared_pipeline> pipeline_;
+  std::unique_ptr<descriptor_layout> set_layout_;  // of set 2, null without bindings
+  std::vector<uint8_t> bound_;                     // resources of the last bind(), see descriptor_layout
+  std::vector<std::shared_ptr<const void>> owners_;  // of bound_'s resources, kept by the recordings using them
+  blend_mode blend_;
+  std::unordered_map<int /*blend_mode*/, std::shared_ptr<shared_pipeline>> variants_;
+
+  /** _desc only has to describe the vertex input, shaders, descriptors, blending and format are added here. */
+  template <typename TShaders>
+  drawable(window &_window, TShaders, pipeline_desc _desc, blend_mode _blend)
+      : window_(_window), display_(_window.display_), blend_(_blend) {
+    if (display_.bindless())
+      _desc.shaders(TShaders::vert(), TShaders::frag());
+    else
+      _desc.shaders(TShaders::vert(), compat_frag<TShaders>::get());
+
+    std::array<std::pair<VkDescriptorType, VkShaderStageFlags>, sizeof...(TBindings)> bindings = {
+        {std::make_pair(TBindings::type, TBindings::stages)...}};
+    std::array<uint32_t, sizeof...(TBindings)> counts = {{TBindings::count...}};
+    for (size_t i = 0; i < bindings.size(); i++)
+      _desc.descriptors.emplace_back(descriptor(i, bindings[i].first, bindings[i].second, counts[i]));
+
+    // with dynamic blending, a single pipeline serves every mode
+    _desc.dynamic_blend = display_.dynamic_blend();
+    _desc.blending(_desc.dynamic_blend ? BLEND_NONE : _blend);
+    _desc.format = _window.surface_format_.format;
+    pipeline_ = display_.get_pipeline(_desc);
+    variants_[_blend] = pipeline_;
+    if (_desc.descriptors.empty())
+      return;  // nothing to bind in set 2
+
+    // the blend variants' layouts are identical, sets of this one are compatible with all of them
+    constexpr auto offsets = info_offsets();
+    constexpr size_t sizes[] = {sizeof(typename TBindings::info)..., 0};
+    std::vector<VkDescriptorUpdateTemplateEntry> entries;
+    for (uint32_t i = 0; i < offsets.size(); i++) {
+      auto &descriptor = _desc.descriptors[i];
+      entries.emplace_back(VkDescriptorUpdateTemplateEntry{i, 0, descriptor.descriptorCount,
+                                                           descriptor.descriptorType, offsets[i], sizes[i]});
+    }
+    set_layout_ = std::make_unique<descriptor_layout>(display_, pipeline_->descriptor_layout_, entries,
+                                                      (sizeof(typename TBindings::info) + ... + 0));
+  }
+
+  /** Set 2 for the resources of the last bind(), VK_NULL_HANDLE if there's none. */
+  VkDescriptorSet descriptor(recorder &_recorder) {
+    if (bound_.empty())
+      return VK_NULL_HANDLE;
+    return _recorder.descriptors().get(*set_layout_, bound_.data(), owners_);
+  }
+
+  /** Binds the pipeline and descriptor set, pushes _constants, and sets the viewport and scissor to the whole window.
+   * Returns false while the pipeline isn't compiled, the draw has to be skipped then. */
+  bool bind_state(recorder &_recorder, const glm::uvec2 &_size, const draw_constants &_constants) {
+    display_.check_thread();
+    if (!pipeline_->ready())
+      return false;  // still compiling, the window is invalidated once it's done
+
+    _recorder.bind_pipeline(pipeline_->pipeline_);
+    _recorder.blend(blend_);
+    VkDescriptorSet set = descriptor(_recorder);
+    if (set != VK_NULL_HANDLE)
+      _recorder.bind_descriptor_sets(pipeline_->layout_, 2, 1, &set);
+    _recorder.push_constants(pipeline_->layout_, draw_constants_range.stageFlags, draw_constants_range.offset,
+                             draw_constants_range.size, &_constants);
+    _recorder.full_viewport(_size);
+    return true;
+  }
+
+  /** Fills the state of _item shared by every draw of this drawable, returns false like bind_state(). */
+  bool batch_state(batch_item &_item, const draw_constants &_constants) {
+    if (!pipeline_->ready())
+      return false;
+    _item.pipeline_ = pipeline_->pipeline_;
+    _item.layout_ = pipeline_->layout_;
+    _item.blend_ = blend_ != BLEND_NONE;
+    _item.mode_ = blend_;
+    if (!bound_.empty()) {
+      _item.set_layout_ = set_layout_.get();
+      _item.set_data_ = bound_.data();
+      _item.owners_ = &owners_;
+    }
+    _item.constants_ = _constants;
+    return true;
+  }
+
+  template <typename T>
+  static VkBuffer vk_buffer(const shared_ref<T> &_ref) {
+    return _ref->buffer_.buffer_;
+  }
+
+ private:
+  static VkDescriptorSetLayoutBinding descriptor(uint32_t _binding, VkDescriptorType _type,
+                                                 VkShaderStageFlags _stages, uint32_t _count) {
+    VkDescriptorSetLayoutBinding result = {};
+    result.binding = _binding;
+    result.descriptorType = _type;
+    result.descriptorCount = _count;
+    result.stageFlags = _stages;
+    return result;
+  }
+
+  // where the info of each binding is in bound_
+  constexpr static std::array<size_t, sizeof...(TBindings)> info_offsets() {
+    std::array<size_t, sizeof...(TBindings)> result = {};
+    constexpr size_t sizes[] = {sizeof(typename TBindings::info)..., 0};
+    for (size_t i = 1; i < result.size(); i++)
+      result[i] = result[i - 1] + sizes[i - 1];
+    return result;
+  }
+
+  template <size_t... TIndices>
+  void serialize(std::index_sequence<TIndices...>, const typename TBindings::resource &... _resources) {
+    constexpr auto offsets = info_offsets();
+    std::tuple<typename TBindings::info...> infos;
+    memset((void *)&infos, 0, sizeof(infos));  // padding included, it's part of the cache key
+    VkWriteDescriptorSet write = {};  // only the infos are kept, the writes are made from the layout's entries
+    ((TBindings::write(display_, write, std::get<TIndices>(infos), _resources),
+      memcpy(bound_.data() + offsets[TIndices], &std::get<TIndices>(infos), sizeof(std::get<TIndices>(infos)))),
+     ...);
+  }
+};
+
+/** Drawable built from SPIR-V shaders and a vertex type, drawing indexed vertices.
+ * TShaders provides the code through static vert() and frag() functions, and the default blending in blend. */
+template <typename TShaders, typename TVertex, typename... TBindings>
+class pipeline : public drawable<TBindings...> {
+  using base = drawable<TBindings...>;
+
+ public:
+  using vertex = TVertex;
+
+  explicit pipeline(window &_window, blend_mode _blend = TShaders::blend ? BLEND_OVER : BLEND_NONE)
+      : base(_window, TShaders(), describe(), _blend) {
+  }
+
+  /** Draws _count indices from _first, every index of _indices by default. */
+  template <typename TVertices, typename TIndex>
+  void draw(recorder &_recorder, const glm::uvec2 &_size, const shared_ref<TVertices> &_vertices,
+            const shared_ref<TIndex> &_indices, const draw_constants &_constants = draw_constants(),
+            uint32_t _first = 0, uint32_t _count = std::numeric_limits<uint32_t>::max()) {
+    _count = std::min(_count, _indices->count() - std::min(_first, _indices->count()));
+    if (_count == 0 || !base::bind_state(_recorder, _size, _constants))
+      return;
+
+    _recorder.bind_vertex_buffer(0, base::vk_buffer(_vertices), _vertices->offset_);
+    _recorder.bind_index_buffer(base::vk_buffer(_indices), _indices->offset_, index_format<TIndex>::value);
+    _recorder.draw_indexed(_count, 1, _first, 0, 0);
+  }
+
+  /** Same as above, with indices of either width. */
+  template <typename TVertices>
+  void draw(recorder &_recorder, const glm::uvec2 &_size, const shared_ref<TVertices> &_vertices,
+            const shared_indices &_indices, const draw_constants &_constants = draw_constants(), uint32_t _first = 0,
+            uint32_t _count = std::numeric_limits<uint32_t>::max()) {
+    std::visit([&](const auto &_ref) { draw(_recorder, _size, _vertices, _ref, _constants, _first, _count); },
+               _indices);
+  }
+
+  /** Draws _vertices as a list of quads, each made of 4 vertices, with the display's shared indices. */
+  template <typename TVertices>
+  void draw_quads(recorder &_recorder, const glm::uvec2 &_size, const shared_ref<TVertices> &_vertices,
+                  const draw_constants &_constants = draw_constants()) {
+    uint32_t quads = _vertices->count() / 4;
+    draw(_recorder, _size, _vertices, base::display_.quad_list_indices(quads), _constants, 0, quads * 6);
+  }
+
+  /** Draws the commands of _list, their indices are relative to _indices. */
+  template <typename TVertices, typename TIndex>
+  void draw(recorder &_recorder, const glm::uvec2 &_size, const shared_ref<TVertices> &_vertices,
+            const shared_ref<TIndex> &_indices, draw_list &_list,
+            const draw_constants &_constants = draw_constants()) {
+    if (!base::bind_state(_recorder, _size, _constants))
+      return;
+
+    _recorder.bind_vertex_buffer(0, base::vk_buffer(_vertices), _vertices->offset_);
+    _recorder.bind_index_buffer(base::vk_buffer(_indices), _indices->offset_, index_format<TIndex>::value);
+    _list.record(_recorder);
+  }
+
+  /** Same as above, with indices of either width. */
+  template <typename TVertices>
+  void draw(recorder &_recorder, const glm::uvec2 &_size, const shared_ref<TVertices> &_vertices,
+            const shared_indices &_indices, draw_list &_list, const draw_constants &_constants = draw_constants()) {
+    std::visit([&](const auto &_ref) { draw(_recorder, _size, _vertices, _ref, _list, _constants); }, _indices);
+  }
+
+  /** Draws _count indices from _first, recorded later by _batch.flush(). */
+  template <typename TVertices, typename TIndex>
+  void draw(batch &_batch, const shared_ref<TVertices> &_vertices, const shared_ref<TIndex> &_indices,
+            const draw_constants &_constants = draw_constants(), uint32_t _first = 0,
+            uint32_t _count = std::numeric_limits<uint32_t>::max()) {
+    _count = std::min(_count, _indices->count() - std::min(_first, _indices->count()));
+    batch_item item;
+    if (_count == 0 || !base::batch_state(item, _constants))
+      return;
+
+    item.vertices_ = base::vk_buffer(_vertices);
+    item.vertices_offset_ = _vertices->offset_;
+    item.indices_ = base::vk_buffer(_indices);
+    item.index_type_ = index_format<TIndex>::value;
+    item.first_index_ = _indices->offset_ / sizeof(TIndex) + _first;
+    item.index_count_ = _count;
+    _batch.add(item);
+  }
+
+  /** Same as above, with indices of either width. */
+  template <typename TVertices>
+  void draw(batch &_batch, const shared_ref<TVertices> &_vertices, const shared_indices &_indices,
+            const draw_constants &_constants = draw_constants(), uint32_t _first = 0,
+            uint32_t _count = std::numeric_limits<uint32_t>::max()) {
+    std::visit([&](const auto &_ref) { draw(_batch, _vertices, _ref, _constants, _first, _count); }, _indices);
+  }
+
+  /** Same as draw_quads() above, recorded later by _batch.flush(). */
+  template <typename TVertices>
+  void draw_quads(batch &_batch, const shared_ref<TVertices> &_vertices,
+                  const draw_constants &_constants = draw_constants()) {
+    uint32_t quads = _vertices->count() / 4;
+    draw(_batch, _vertices, base::display_.quad_list_indices(quads), _constants, 0, quads * 6);
+  }
+
+ private:
+  static pipeline_desc describe() {
+    pipeline_desc desc;
+
+    VkVertexInputBindingDescription binding = {};
+    binding.binding = 0;
+    binding.stride = sizeof(TVertex);
+    binding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    desc.bindings = {binding};
+
+    constexpr auto attributes = decltype(TVertex::layout())::attributes();
+    desc.attributes.assign(attributes.begin(), attributes.end());
+    return desc;
+  }
+};
+
+/** Drawable of quads, one per instance of TInstance. The vertex shader gets the quad corner from gl_VertexIndex
+ * (0 to 3, counter-clockwise from the origin), there is no vertex buffer, only the display's shared quad indices. */
+template <typename TShaders, typename TInstance, typename... TBindings>
+class instanced : public drawable<TBindings...> {
+  using base = drawable<TBindings...>;
+
+ public:
+  using instance = TInstance;
+
+  explicit instanced(window &_window, blend_mode _blend = TShaders::blend ? BLEND_OVER : BLEND_NONE)
+      : base(_window, TShaders(), describe(), _blend), indices_(base::display_.quad_indices()) {
+  }
+
+  /** Draws _count instances from _first, every instance of _instances by default. */
+  void draw(recorder &_recorder, const glm::uvec2 &_size, const shared_ref<TInstance> &_instances,
+            const draw_constants &_constants = draw_constants(), uint32_t _first = 0,
+            uint32_t _count = std::numeric_limits<uint32_t>::max()) {
+    _count = std::min(_count, _instances->count() - std::min(_first, _instances->count()));
+    if (_count == 0 || !base::bind_state(_recorder, _size, _constants))
+      return;
+
+    _recorder.bind_vertex_buffer(0, base::vk_buffer(_instances), _instances->offset_);
+    _recorder.bind_index_buffer(base::vk_buffer(indices_), indices_->offset_, VK_INDEX_TYPE_UINT16);
+    _recorder.draw_indexed(indices_->count(), _count, 0, 0, _first);
+  }
+
+  /** Draws the commands of _list, see command(). */
+  void draw(recorder &_recorder, const glm::uvec2 &_size, const shared_ref<TInstance> &_instances, draw_list &_list,
+            const draw_constants &_constants = draw_constants()) {
+    if (!base::bind_state(_recorder, _size, _constants))
+      return;
+
+    _recorder.bind_vertex_buffer(0, base::vk_buffer(_instances), _instances->offset_);
+    _recorder.bind_index_buffer(base::vk_buffer(indices_), indices_->offset_, VK_INDEX_TYPE_UINT16);
+    _list.record(_recorder);
+  }
+
+  /** Draws the instances set in _culler that are left after culling, its stride must be sizeof(TInstance). */
+  void draw(recorder &_recorder, const glm::uvec2 &_size, culler &_culler,
+            const draw_constants &_constants = draw_constants()) {
+    if (!base::bind_state(_recorder, _size, _constants))
+      return;
+
+    _recorder.bind_index_buffer(base::vk_buffer(indices_), indices_->offset_, VK_INDEX_TYPE_UINT16);
+    _culler.record(_recorder);
+  }
+
+  /** Command of a draw_list drawing _count instances from _first, with the 6 quad indices.
+   * _first must be 0 unless display::draw_indirect_first_instance(). */
+  static draw_list::command command(uint32_t _first, uint32_t _count) {
+    return {6, _count, 0, 0, _first};
+  }
+
+  /** Same as above, recorded later by _batch.flush(). */
+  void draw(batch &_batch, const shared_ref<TInstance> &_instances, const draw_constants &_constants = draw_constants(),
+            uint32_t _first = 0, uint32_t _count = std::numeric_limits<uint32_t>::max()) {
+    _count = std::min(_count, _instances->count() - std::min(_first, _instances->count()));
+    batch_item item;
+    if (_count == 0 || !base::batch_state(item, _constants))
+      return;
+
+    item.vertices_ = base::vk_buffer(_instances);
+    item.vertices_offset_ = _instances->offset_;
+    item.indices_ = base::vk_buffer(indices_);
+    item.first_index_ = indices_->offset_ / sizeof(uint16_t);
+    item.index_count_ = indices_->count();
+    item.first_instance_ = _first;
+    item.instance_count_ = _count;
+    _batch.add(item);
+  }
+
+ private:
+  shared_ref<uint16_t> indices_;
+
+  static pipeline_desc describe() {
+    pipeline_desc desc;
+
+    VkVertexInputBindingDescription binding = {};
+    binding.binding = 0;
+    binding.stride = sizeof(TInstance);
+    binding.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+    desc.bindings = {binding};
+
+    constexpr auto attributes = decltype(TInstance::layout())::attributes();
+    desc.attributes.assign(attributes.begin(), attributes.end());
+    return desc;
+  }
+};
+
+}  // namespace hut
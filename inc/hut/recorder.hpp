@@ -0,0 +1,135 @@
+/*  _ _ _   _       _
+ * | |_| |_| |_ _ _| |_
+ * | | | . |   | | |  _|
+ * |_|_|___|_|_|___|_|
+ * Hobby graphics and GUI library under the MIT License (MIT)
+ *
+ * Copyright (c) 2014 Jean-Baptiste Lepesme github.com/jiboo/libhut
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <utility>
+
+#include <vulkan/vulkan.h>
+
+#include <glm/vec2.hpp>
+
+#include "hut/color.hpp"
+
+namespace hut {
+
+class descriptor_cache;
+class display;
+
+/** Commands recorded by a recorder, and the ones dropped because they would set the state already set. */
+struct recorder_stats {
+  size_t issued = 0;
+  size_t elided = 0;
+};
+
+/** Records into a command buffer, tracking the bound state to drop the commands that wouldn't change it.
+ * It's what on_draw gets, drawables record through it. Every pipeline of hut has a dynamic viewport and scissor,
+ * and its layouts share sets 0 and 1, so binding a pipeline or set 2 leaves those untouched.
+ * Commands recorded directly in buffer() aren't tracked, call reset() afterwards. */
+class recorder {
+ public:
+  recorder(display &_display, VkCommandBuffer _buffer, uint32_t _image, descriptor_cache &_descriptors)
+      : display_(_display), buffer_(_buffer), image_(_image), descriptors_(_descriptors) {
+  }
+
+  recorder(const recorder &) = delete;
+  recorder &operator=(const recorder &) = delete;
+
+  VkCommandBuffer buffer() {
+    return buffer_;
+  }
+  /** Index of the swapchain image recorded for, to pick resources kept per image. */
+  uint32_t image() {
+    return image_;
+  }
+  /** Descriptor sets living as long as this recording, see drawable::bind(). */
+  descriptor_cache &descriptors() {
+    return descriptors_;
+  }
+  /** Forgets the tracked state, the next commands are all issued. */
+  void reset();
+
+  void bind_pipeline(VkPipeline _pipeline);
+  void bind_descriptor_sets(VkPipelineLayout _layout, uint32_t _first, uint32_t _count, const VkDescriptorSet *_sets);
+  void push_constants(VkPipelineLayout _layout, VkShaderStageFlags _stages, uint32_t _offset, uint32_t _size,
+                      const void *_data);
+  void bind_vertex_buffer(uint32_t _binding, VkBuffer _buffer, VkDeviceSize _offset);
+  void bind_index_buffer(VkBuffer _buffer, VkDeviceSize _offset, VkIndexType _type);
+  void viewport(const VkViewport &_viewport);
+  void scissor(const VkRect2D &_scissor);
+  /** Viewport and scissor covering the whole _size. */
+  void full_viewport(const glm::uvec2 &_size);
+  /** Blending of the next draws, only if display::dynamic_blend(), it's part of the pipelines otherwise. */
+  void blend(blend_mode _mode);
+
+  void draw_indexed(uint32_t _index_count, uint32_t _instance_count, uint32_t _first_index, int32_t _vertex_offset,
+                    uint32_t _first_instance);
+  void draw_indexed_indirect(VkBuffer _buffer, VkDeviceSize _offset, uint32_t _count, uint32_t _stride);
+  /** Only if display::draw_indirect_count(). */
+  void draw_indexed_indirect_count(VkBuffer _buffer, VkDeviceSize _offset, VkBuffer _count_buffer,
+                                   VkDeviceSize _count_offset, uint32_t _max_count, uint32_t _stride);
+
+  const recorder_stats &stats() {
+    return stats_;
+  }
+
+ protected:
+  constexpr static uint32_t max_sets_ = 4;
+  constexpr static uint32_t max_vertex_bindings_ = 4;
+  constexpr static uint32_t max_constants_ = 128;  // minimum maxPushConstantsSize, bigger pushes aren't tracked
+
+  display &display_;
+  VkCommandBuffer buffer_;
+  uint32_t image_;
+  descriptor_cache &descriptors_;
+  recorder_stats stats_;
+
+  VkPipeline pipeline_ = VK_NULL_HANDLE;
+  std::array<std::pair<VkPipelineLayout, VkDescriptorSet>, max_sets_> sets_ = {};
+  VkShaderStageFlags constants_stages_ = 0;
+  uint32_t constants_offset_ = 0, constants_size_ = 0;
+  std::array<uint8_t, max_constants_> constants_;
+  std::array<std::pair<VkBuffer, VkDeviceSize>, max_vertex_bindings_> vertices_ = {};
+  VkBuffer indices_ = VK_NULL_HANDLE;
+  VkDeviceSize indices_offset_ = 0;
+  VkIndexType index_type_ = VK_INDEX_TYPE_UINT16;
+  bool has_viewport_ = false, has_scissor_ = false;
+  VkViewport viewport_;
+  VkRect2D scissor_;
+  bool has_blend_ = false;
+  blend_mode blend_ = BLEND_NONE;
+
+  bool elide(bool _redundant) {
+    (_redundant ? stats_.elided : stats_.issued)++;
+    return _redundant;
+  }
+};
+
+}  // namespace hut
@@ -0,0 +1,146 @@
+/*  _ _ _   _       _
+ * | |_| |_| |_ _ _| |_
+ * | | | . |   | | |  _|
+ * |_|_|___|_|_|___|_|
+ * Hobby graphics and GUI library under the MIT License (MIT)
+ *
+ * Copyright (c) 2014 Jean-Baptiste Lepesme github.com/jiboo/libhut
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <future>
+#include <memory>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include <glm/mat4x4.hpp>
+
+#include "hut/color.hpp"
+
+namespace hut {
+
+class display;
+
+/** Push constants of every draw: the model matrix, and the slot of the texture in the display's texture table.
+ * All the pipeline layouts share this range and sets 0 and 1, so that those stay bound across pipelines. */
+struct draw_constants {
+  glm::mat4 model = glm::mat4(1);
+  uint32_t texture = 0;
+};
+constexpr VkPushConstantRange draw_constants_range = {VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0,
+                                                      sizeof(draw_constants)};
+
+/** Blending of _mode, Porter-Duff factors applied to non-premultiplied source colors: where the source factor is one,
+ * the source color is weighted by its alpha, like BLEND_OVER always did. BLEND_NONE disables blending.
+ * A single factor can't weight by both alphas: where the source factor uses the destination alpha (XOR, ATOP, IN,
+ * OUT, DST_ATOP, DST_OVER), translucent source colors must be premultiplied, non-premultiplied ones blend as if
+ * opaque. Only SRC and OVER are exact for non-premultiplied colors. */
+VkPipelineColorBlendAttachmentState blend_attachment(blend_mode _mode);
+
+/** SPIR-V code compared and hashed by content, as resources included in several translation units may have several
+ * copies. It's the key of the display's shader registry, the code must outlive it. */
+struct spirv_code {
+  const uint8_t *data_ = nullptr;
+  size_t size_ = 0;
+
+  bool operator==(const spirv_code &_other) const;
+
+  struct hasher {
+    size_t operator()(const spirv_code &_code) const;
+  };
+};
+
+/** Everything that makes two pipelines interchangeable, it's the key of the display's pipeline registry. */
+struct pipeline_desc {
+  const uint8_t *vert_code = nullptr;
+  size_t vert_size = 0;
+  const uint8_t *frag_code = nullptr;
+  size_t frag_size = 0;
+
+  std::vector<VkVertexInputBindingDescription> bindings;
+  std::vector<VkVertexInputAttributeDescription> attributes;
+  std::vector<VkDescriptorSetLayoutBinding> descriptors;
+  VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+  VkPipelineColorBlendAttachmentState blend = {};
+  bool dynamic_blend = false;  // blend enable and equation set while recording, see display::dynamic_blend()
+  VkFormat format = VK_FORMAT_UNDEFINED;  // of the render pass color attachment, pipelines are shared between
+                                          // windows with compatible render passes
+
+  template <size_t TVert, size_t TFrag>
+  void shaders(const std::array<uint8_t, TVert> &_vert, const std::array<uint8_t, TFrag> &_frag) {
+    vert_code = _vert.data();
+    vert_size = _vert.size();
+    frag_code = _frag.data();
+    frag_size = _frag.size();
+  }
+
+  /** Source-alpha "over" blending when _enable is true, plain overwrite otherwise. */
+  void alpha_blend(bool _enable);
+  void blending(blend_mode _mode);
+
+  bool operator==(const pipeline_desc &_other) const;
+
+  struct hasher {
+    size_t operator()(const pipeline_desc &_desc) const;
+  };
+};
+
+struct shader_module {
+  VkDevice device_;
+  VkShaderModule module_ = VK_NULL_HANDLE;
+
+  shader_module(VkDevice _device, const uint8_t *_code, size_t _size);
+  ~shader_module();
+};
+
+/** Shader modules, layouts and pipeline built once per pipeline_desc and shared by all the drawables using it,
+ * get them through display::get_pipeline. Layouts are created right away so that descriptor sets can be allocated,
+ * the pipeline itself is compiled on the display's compiler threads. */
+struct shared_pipeline {
+  display &display_;
+  const pipeline_desc desc_;
+  std::shared_ptr<shader_module> vert_, frag_;
+  VkDescriptorSetLayout descriptor_layout_ = VK_NULL_HANDLE;  // set 2, after the window's and the textures
+  VkPipelineLayout layout_ = VK_NULL_HANDLE;
+  VkPipeline pipeline_ = VK_NULL_HANDLE;  // only valid once ready()
+
+  shared_pipeline(display &_display, const pipeline_desc &_desc);
+  ~shared_pipeline();
+
+  /** True once compiled. Until then draws using it should be skipped, windows get invalidated when it's ready so
+   * that the skipped draws are recorded again. Rethrows the compilation error if it failed, which the display's
+   * dispatch() also throws. */
+  bool ready();
+  /** Blocks until compiled, rethrows the compilation error if any. */
+  void wait();
+
+ protected:
+  std::atomic<bool> ready_{false}, skipped_{false}, failed_{false};
+  std::shared_future<void> compiled_;
+
+  void compile(VkRenderPass _renderpass);
+};
+
+}  // namespace hut
@@ -0,0 +1,166 @@
+/*  _ _ _   _       _
+ * | |_| |_| |_ _ _| |_
+ * | | | . |   | | |  _|
+ * |_|_|___|_|_|___|_|
+ * Hobby graphics and GUI library under the MIT License (MIT)
+ *
+ * Copyright (c) 2014 Jean-Baptiste Lepesme github.com/jiboo/libhut
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "hut/buffer.hpp"
+#include "hut/drawables/rect.hpp"
+#include "hut/image.hpp"
+#include "hut/utils.hpp"
+
+struct FT_LibraryRec_;
+struct FT_FaceRec_;
+
+namespace hut {
+
+/** A TrueType or OpenType font rasterized by FreeType, from a file in memory that must outlive it, thread-safe.
+ * Only built when FreeType is found, HUT_TEXT is defined then. */
+class font {
+  friend class glyph_atlas;
+  friend class text;
+
+ public:
+  font(const uint8_t *_data, size_t _size, uint32_t _face_index = 0);
+  ~font();
+
+  font(const font &) = delete;
+  font &operator=(const font &) = delete;
+
+  /** Distance between two baselines at _size pixels. */
+  float line_height(uint32_t _size);
+
+ protected:
+  FT_LibraryRec_ *library_ = nullptr;
+  FT_FaceRec_ *face_ = nullptr;
+  std::mutex mutex_;   // of face_, held while shaping
+  uint32_t id_;        // part of the caches' keys, unlike addresses it isn't reused
+  uint32_t size_ = 0;  // pixel size set on face_
+
+  void pixel_size(uint32_t _size);
+  uint32_t index(char32_t _code_point);
+  float kerning(uint32_t _left, uint32_t _right, uint32_t _size);
+};
+
+/** Glyphs rasterized on first use as coverage masks, shelf-packed into pages of white alpha images, so that they
+ * are drawn by rect with their color as tint. A page is added once the last one is full. */
+class glyph_atlas {
+ public:
+  struct glyph {
+    glm::vec2 offset;     // of the mask's top-left from the pen position on the baseline
+    glm::vec2 size;       // of the mask in pixels, zero for blank glyphs
+    glm::vec4 texcoords;  // top-left uv in xy, bottom-right in zw
+    uint32_t texture;     // slot of the page
+    float advance;
+  };
+
+  explicit glyph_atlas(display &_display, glm::uvec2 _page_size = {1024, 1024});
+
+  /** Glyph _index of _font at _size pixels, throws if it doesn't fit in a page. */
+  const glyph &get(font &_font, uint32_t _size, uint32_t _index);
+
+  size_t pages() const {
+    return pages_.size();
+  }
+  size_t size() const {
+    return glyphs_.size();
+  }
+
+ protected:
+  constexpr static uint32_t padding_ = 1;  // between masks, as the texture table's sampler filters linearly
+
+  struct page {
+    shared_image image_;
+    uint32_t x_ = 0, y_ = 0, shelf_height_ = 0;  // free space of the current shelf
+  };
+
+  display &display_;
+  glm::uvec2 page_size_;
+  std::vector<page> pages_;
+  std::unordered_map<uint64_t, glyph> glyphs_;  // by font id, size and glyph index
+
+  page &place(glm::uvec2 _size, glm::uvec2 &_pos);
+};
+
+/** Glyph quads of a string, relative to the pen position on its first baseline. */
+struct text_run {
+  std::shared_ptr<buffer> chunk_;        // holding instances_, alive as long as it's drawn
+  shared_ref<rect_instance> instances_;  // null if the string has nothing to draw
+  glm::vec2 extent_;                     // width of the longest line, height of the lines
+};
+
+/** Draws strings as rect instances, one instanced draw per run whatever the atlas pages its glyphs are on, as each
+ * instance has its page's texture slot. Runs are shaped once and kept in an LRU cache, drawing an unchanged string
+ * again only records the draw. Thread-safe, nodes recording in parallel may share it.
+ * Runs drawn are kept alive by the recording until it's redone, evicting them from the cache doesn't affect the
+ * command buffers using them. */
+class text {
+ public:
+  explicit text(window &_window, size_t _cache_size = 1024, glm::uvec2 _page_size = {1024, 1024});
+
+  /** Run of _string at _size pixels, cached by font, size, color and string, lines broken at '\n'. */
+  std::shared_ptr<const text_run> shape(font &_font, uint32_t _size, const glm::vec4 &_color,
+                                        const std::string &_string);
+
+  /** Draws _run with its first baseline starting at _pos, rounded to whole pixels to keep the glyphs sharp. */
+  void draw(recorder &_recorder, const glm::uvec2 &_size, const std::shared_ptr<const text_run> &_run, glm::vec2 _pos);
+  void draw(recorder &_recorder, const glm::uvec2 &_size, font &_font, uint32_t _pixel_size, const glm::vec4 &_color,
+            const std::string &_string, glm::vec2 _pos) {
+    draw(_recorder, _size, shape(_font, _pixel_size, _color, _string), _pos);
+  }
+
+  bool ready() {
+    return drawable_.ready();
+  }
+
+  const glyph_atlas &atlas() const {
+    return atlas_;
+  }
+
+ protected:
+  window &window_;
+  // of everything below, held while shaping and when a run is freed, shared with the runs as a recording may be the
+  // last to drop them
+  std::shared_ptr<std::recursive_mutex> mutex_ = std::make_shared<std::recursive_mutex>();
+  rect drawable_;
+  glyph_atlas atlas_;
+  // host visible, written right away even while recording, and never grown as that would replace the VkBuffer
+  // bound by the command buffers already recorded, a new chunk is added instead
+  constexpr static uint32_t chunk_size_ = 64 * 1024;
+  std::vector<std::shared_ptr<buffer>> chunks_;
+  lru_cache<std::string, std::shared_ptr<text_run>> runs_;
+};
+
+}  // namespace hut
@@ -0,0 +1,92 @@
+/*  _ _ _   _       _
+ * | |_| |_| |_ _ _| |_
+ * | | | . |   | | |  _|
+ * |_|_|___|_|_|___|_|
+ * Hobby graphics and GUI library under the MIT License (MIT)
+ *
+ * Copyright (c) 2014 Jean-Baptiste Lepesme github.com/jiboo/libhut
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <string>
+
+namespace hut {
+
+/** Low overhead tracing of CPU and GPU zones, dumped as a Chrome trace JSON file (chrome://tracing, Perfetto).
+ * Zones are stored in fixed size per-thread ring buffers, the oldest ones are overwritten.
+ * Recording is disabled by default, and then costs a relaxed atomic load per zone. */
+class trace {
+ public:
+  using clock = std::chrono::steady_clock;
+  using time_point = clock::time_point;
+
+  /** Records a zone from construction to destruction, _category and _name must be string literals. */
+  class zone {
+   public:
+    zone(const char *_category, const char *_name) : category_(_category), name_(_name) {
+      if (enabled())
+        begin_ = clock::now();
+    }
+    ~zone() {
+      if (begin_ != time_point())
+        record(category_, name_, begin_, clock::now());
+    }
+
+    zone(const zone &) = delete;
+    zone &operator=(const zone &) = delete;
+
+   protected:
+    const char *category_, *name_;
+    time_point begin_;
+  };
+
+  static void enable(bool _enabled) {
+    enabled_.store(_enabled, std::memory_order_relaxed);
+  }
+  static bool enabled() {
+    return enabled_.load(std::memory_order_relaxed);
+  }
+
+  /** Names the calling thread in dumps. */
+  static void thread_name(const std::string &_name);
+
+  /** Records a zone measured by the caller, ignored while disabled. */
+  static void record(const char *_category, const char *_name, time_point _begin, time_point _end);
+  /** GPU work, already mapped on the CPU clock, shown on its own "GPU" track. */
+  static void record_gpu(const char *_name, time_point _begin, time_point _end);
+
+  /** Writes every zone still held in the ring buffers, throws if _path can't be written. */
+  static void dump(const std::string &_path);
+  /** Forgets every recorded zone. */
+  static void clear();
+
+ protected:
+  static std::atomic<bool> enabled_;
+};
+
+}  // namespace hut
+
+#define HUT_TRACE_CONCAT_(a, b) a##b
+#define HUT_TRACE_CONCAT(a, b) HUT_TRACE_CONCAT_(a, b)
+#define HUT_TRACE_ZONE(category, name) hut::trace::zone HUT_TRACE_CONCAT(hut_trace_zone_, __LINE__)(category, name)
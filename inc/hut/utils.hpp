@@ -27,13 +27,23 @@
 
 #pragma once
 
+#include <algorithm>
+#include <cmath>
 #include <codecvt>
+#include <condition_variable>
+#include <deque>
+#include <exception>
 #include <fstream>
 #include <functional>
+#include <future>
+#include <list>
 #include <locale>
+#include <mutex>
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
 namespace hut {
@@ -43,6 +53,12 @@ inline std::string to_utf8(char32_t ch) {
   return convert.to_bytes(ch);
 }
 
+/** Code points of _str, throws std::range_error if it isn't valid UTF-8. */
+inline std::u32string to_utf32(const std::string &_str) {
+  std::wstring_convert<std::codecvt_utf8<char32_t>, char32_t> convert;
+  return convert.from_bytes(_str);
+}
+
 template <typename... TArgTypes>
 class event {
  public:
@@ -79,6 +95,250 @@ class event {
   std::vector<callback> cbs_, onces_;
 };
 
+/** Keeps the last samples pushed, to compute order statistics over them. */
+template <typename T>
+class rolling_window {
+ public:
+  explicit rolling_window(size_t _capacity) : samples_(std::max<size_t>(1, _capacity)) {
+  }
+
+  void push(const T &_sample) {
+    samples_[next_] = _sample;
+    next_ = (next_ + 1) % samples_.size();
+    count_ = std::min(count_ + 1, samples_.size());
+  }
+
+  size_t size() const {
+    return count_;
+  }
+
+  /** Nearest-rank percentile, _p in [0, 1]; T() when no sample has been pushed yet. */
+  T percentile(double _p) const {
+    if (count_ == 0)
+      return T();
+    std::vector<T> sorted(samples_.begin(), samples_.begin() + count_);
+    size_t rank = (size_t)std::max(1.0, std::ceil(_p * count_)) - 1;
+    rank = std::min(rank, count_ - 1);
+    std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+    return sorted[rank];
+  }
+
+  T max() const {
+    if (count_ == 0)
+      return T();
+    return *std::max_element(samples_.begin(), samples_.begin() + count_);
+  }
+
+ protected:
+  std::vector<T> samples_;
+  size_t next_ = 0, count_ = 0;
+};
+
+/** Map of at most capacity entries, inserting a new one evicts the least recently used. */
+template <typename TKey, typename TValue, typename THash = std::hash<TKey>>
+class lru_cache {
+ public:
+  explicit lru_cache(size_t _capacity) : capacity_(std::max<size_t>(1, _capacity)) {
+  }
+
+  /** Value of _key, made the most recently used, nullptr if it isn't cached. */
+  TValue *find(const TKey &_key) {
+    auto it = index_.find(_key);
+    if (it == index_.end())
+      return nullptr;
+    entries_.splice(entries_.begin(), entries_, it->second);
+    return &it->second->second;
+  }
+
+  /** Inserts or replaces the value of _key, as the most recently used. */
+  TValue &insert(const TKey &_key, TValue _value) {
+    auto it = index_.find(_key);
+    if (it != index_.end()) {
+      entries_.splice(entries_.begin(), entries_, it->second);
+      it->second->second = std::move(_value);
+      return it->second->second;
+    }
+
+    if (entries_.size() == capacity_) {
+      index_.erase(entries_.back().first);
+      entries_.pop_back();
+    }
+    entries_.emplace_front(_key, std::move(_value));
+    index_.emplace(_key, entries_.begin());
+    return entries_.front().second;
+  }
+
+  size_t size() const {
+    return entries_.size();
+  }
+
+  void clear() {
+    index_.clear();
+    entries_.clear();
+  }
+
+ protected:
+  using entry = std::pair<TKey, TValue>;
+
+  size_t capacity_;
+  std::list<entry> entries_;  // most recently used first
+  std::unordered_map<TKey, typename std::list<entry>::iterator, THash> index_;
+};
+
+/** Fixed set of worker threads sharing the iterations of parallel_for() with the calling thread. */
+class thread_pool {
+ public:
+  using task = std::function<void(size_t /*index*/)>;
+
+  explicit thread_pool(size_t _workers) {
+    for (size_t i = 0; i < _workers; i++)
+      threads_.emplace_back([this] { run(); });
+  }
+
+  ~thread_pool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    wake_cv_.notify_all();
+    for (auto &thread : threads_)
+      thread.join();
+  }
+
+  thread_pool(const thread_pool &) = delete;
+  thread_pool &operator=(const thread_pool &) = delete;
+
+  /** Number of threads taking part in parallel_for(), including the calling one. */
+  size_t size() const {
+    return threads_.size() + 1;
+  }
+
+  /** Calls _task for every index in [0, _count) and returns once they are all done.
+   * Index 0 always runs on the calling thread, the first exception thrown by a task is rethrown here. */
+  void parallel_for(size_t _count, const task &_task) {
+    if (_count == 0)
+      return;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    task_ = &_task;
+    next_ = 1;
+    count_ = _count;
+    pending_ = _count;
+    error_ = nullptr;
+    lock.unlock();
+    wake_cv_.notify_all();
+
+    execute(0);
+
+    lock.lock();
+    while (next_ < count_) {
+      size_t index = next_++;
+      lock.unlock();
+      execute(index);
+      lock.lock();
+    }
+    done_cv_.wait(lock, [this] { return pending_ == 0; });
+    task_ = nullptr;
+    count_ = 0;
+
+    if (error_)
+      std::rethrow_exception(error_);
+  }
+
+ protected:
+  std::vector<std::thread> threads_;
+  std::mutex mutex_;
+  std::condition_variable wake_cv_, done_cv_;
+  const task *task_ = nullptr;
+  size_t next_ = 0, count_ = 0, pending_ = 0;
+  std::exception_ptr error_;
+  bool stop_ = false;
+
+  void execute(size_t _index) {
+    std::exception_ptr error;
+    try {
+      (*task_)(_index);
+    } catch (...) {
+      error = std::current_exception();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (error && !error_)
+      error_ = error;
+    if (--pending_ == 0)
+      done_cv_.notify_all();
+  }
+
+  void run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      wake_cv_.wait(lock, [this] { return stop_ || next_ < count_; });
+      if (stop_)
+        return;
+      size_t index = next_++;
+      lock.unlock();
+      execute(index);
+      lock.lock();
+    }
+  }
+};
+
+/** Worker threads running posted tasks in FIFO order, the completion of each task is reported through a future. */
+class task_queue {
+ public:
+  explicit task_queue(size_t _workers) {
+    for (size_t i = 0; i < _workers; i++)
+      threads_.emplace_back([this] { run(); });
+  }
+
+  /** Runs the tasks still queued, then joins the workers. */
+  ~task_queue() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    cv_.notify_all();
+    for (auto &thread : threads_)
+      thread.join();
+  }
+
+  task_queue(const task_queue &) = delete;
+  task_queue &operator=(const task_queue &) = delete;
+
+  /** The future holds the exception thrown by _task, if any. */
+  std::future<void> post(std::function<void()> _task) {
+    std::packaged_task<void()> task(std::move(_task));
+    auto result = task.get_future();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      tasks_.emplace_back(std::move(task));
+    }
+    cv_.notify_one();
+    return result;
+  }
+
+ protected:
+  std::vector<std::thread> threads_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<std::packaged_task<void()>> tasks_;
+  bool stop_ = false;
+
+  void run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      cv_.wait(lock, [this] { return stop_ || !tasks_.empty(); });
+      if (tasks_.empty())
+        return;
+      auto task = std::move(tasks_.front());
+      tasks_.pop_front();
+      lock.unlock();
+      task();
+      lock.lock();
+    }
+  }
+};
+
 class sstream {
  private:
   std::ostringstream stream_;
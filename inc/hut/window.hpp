@@ -28,6 +28,8 @@
 #pragma once
 
 #include <chrono>
+#include <list>
+#include <memory>
 #include <string>
 
 #include <vulkan/vulkan.h>
@@ -37,9 +39,12 @@
 #include <xcb/xcb_keysyms.h>
 #endif
 
+#include <glm/mat4x4.hpp>
 #include <glm/vec2.hpp>
 #include <glm/vec4.hpp>
 
+#include "hut/buffer.hpp"
+#include "hut/node.hpp"
 #include "hut/utils.hpp"
 
 namespace hut {
@@ -48,6 +53,15 @@ enum touch_event_type { TDOWN, TUP, TMOVE };
 
 enum mouse_event_type { MDOWN, MUP, MMOVE, MENTER, MLEAVE, MWHEEL_UP, MWHEEL_DOWN };
 
+/** Presentation policy of a window, unsupported modes fall back to the closest supported one:
+ * IMMEDIATE to MAILBOX to FIFO, MAILBOX and FIFO_RELAXED to FIFO, which is always available. */
+enum present_mode {
+  PRESENT_FIFO,          // vsync, lowest power
+  PRESENT_FIFO_RELAXED,  // vsync, but tears instead of waiting when a frame is late
+  PRESENT_MAILBOX,       // vsync without blocking, only the latest frame is shown: lowest latency without tearing
+  PRESENT_IMMEDIATE,     // no vsync, tears, for benchmarking
+};
+
 enum keysym : char32_t {
   KENUM_START = 0xffffff00,
   KTAB,
@@ -86,22 +100,46 @@ enum keysym : char32_t {
 };
 
 class display;
+class culler;
+
+/** Rolling statistics over the last frames of a window, durations in milliseconds. */
+struct frame_stats {
+  struct percentiles {
+    double p50 = 0, p99 = 0, max = 0;
+  };
+  percentiles acquire;  // waiting for the frame slot and the next swapchain image
+  percentiles draw;     // on_frame, staging flush and recording
+  percentiles submit;
+  percentiles present;
+  percentiles total;  // CPU time of redraw, from start to present
+  percentiles gpu;    // render pass execution, from timestamp queries (zeroes if unsupported)
+  percentiles jobs;   // display jobs loop iterations, redraw included
+  size_t frames = 0;
+  size_t commands_issued = 0, commands_elided = 0;  // by the last recording of each node, see recorder
+};
+
+/** Uniforms shared by every drawable of a window, bound once at the start of each node's command buffer. */
+struct view_ubo {
+  glm::mat4 view;
+  glm::mat4 proj;
+};
 
 class window {
   friend class display;
+  friend class node;
   friend class noinput;
-  friend class rgb;
-  friend class rgba;
-  friend class tex;
-  friend class rgb_tex;
-  friend class rgba_tex;
+  friend class culler;
+  friend class text;
+  template <typename...>
+  friend class drawable;
 
  public:
   event<> on_pause, on_resume, on_focus, on_blur, on_close;
   event<glm::uvec4> on_expose;
   event<glm::uvec2> on_resize;
-  event<VkCommandBuffer, glm::uvec2 /*canvas_size*/> on_draw;
+  event<recorder &, glm::uvec2 /*canvas_size*/> on_draw;
   event<glm::uvec2, display::duration /*delta*/> on_frame;
+  event<frame_stats> on_stats;  // about once per second while redrawing
   event<std::string /*path*/, glm::uvec2 /*pos*/> on_drop;
 
   event<uint8_t /*finger*/, touch_event_type, glm::uvec2 /*pos*/> on_touch;
@@ -137,11 +175,50 @@ class window {
     invalidate(true);
   }
 
+  /** View transform of the drawables, identity by default. */
+  void view(const glm::mat4 &_view);
+  /** Projection of the drawables. By default it follows the window size, mapping pixels with the origin at the
+   * top-left corner, until a projection is set. */
+  void projection(const glm::mat4 &_proj);
+
+  /** Switches presentation policy, recreating the swapchain. 0 images means minimum supported + 1. */
+  void present_policy(present_mode _mode, uint32_t _images_count = 0);
+  present_mode present_policy() {
+    return requested_present_mode_;
+  }
+  /** Mode and swapchain images count actually obtained from the driver. */
+  present_mode active_present_mode();
+  uint32_t images_count() {
+    return (uint32_t)swapchain_images_.size();
+  }
+
+  /** Caps redraws to _fps frames per second, 0 for no cap besides the present mode's own.
+   * Early redraw requests are deferred to the next frame deadline, the dispatcher keeps serving jobs meanwhile. */
+  void frame_rate(uint16_t _fps);
+  uint16_t frame_rate() {
+    return frame_rate_;
+  }
+
+  frame_stats stats();
+
+  /** Reads back the next frame. _callback runs on the dispatcher once the GPU is done with it, pixels are tightly
+   * packed rows of 4 bytes in the surface format. Throws if the surface doesn't allow reading its images. */
+  using capture_callback = std::function<void(glm::uvec2 /*size*/, VkFormat, const uint8_t * /*pixels*/)>;
+  void capture(const capture_callback &_callback);
+
+  /** Number of frames the CPU may record and submit ahead of the GPU. */
+  uint8_t frames_in_flight() {
+    return (uint8_t)frames_.size();
+  }
+  void frames_in_flight(uint8_t _count);
+
  protected:
   display &display_;
   VkSurfaceKHR surface_ = VK_NULL_HANDLE;
 
   VkPresentModeKHR present_mode_;
+  present_mode requested_present_mode_ = PRESENT_FIFO;
+  uint32_t requested_images_count_ = 0;
   VkSurfaceFormatKHR surface_format_;
   VkRenderPass renderpass_ = VK_NULL_HANDLE;
 
@@ -153,19 +230,66 @@ class window {
   std::vector<VkCommandBuffer> primary_cbs_;
   std::vector<VkCommandBuffer> cbs_;
   std::vector<bool> dirty_;
+  std::list<node *> nodes_;
+  std::list<culler *> cullers_;  // run on the compute queue before each frame
+  std::unique_ptr<node> root_;  // forwards on_draw
+  std::vector<std::vector<node *>> record_work_;  // dirty nodes, per recording pool
+  std::vector<VkFence> images_fences_;
+
+  /** Synchronization and transient resources of one frame in flight. */
+  struct frame {
+    VkSemaphore sem_available_ = VK_NULL_HANDLE;
+    VkSemaphore sem_rendered_ = VK_NULL_HANDLE;
+    VkSemaphore sem_culled_ = VK_NULL_HANDLE;  // the cullers' compute pass is done
+    VkFence fence_ = VK_NULL_HANDLE;
+    event<> on_recycle_;  // fired once the GPU is done with the previous use of this slot
+  };
+  std::vector<capture_callback> captures_;  // for the next frame
+  bool capturable_ = false;
 
-  VkSemaphore sem_available_ = VK_NULL_HANDLE;
-  VkSemaphore sem_rendered_ = VK_NULL_HANDLE;
+  constexpr static uint8_t default_frames_in_flight = 2;
+  std::vector<frame> frames_;
+  size_t current_frame_ = 0;
 
   bool visible_ = false;
-  uint16_t fps_limit_ = 0;
+  uint16_t frame_rate_ = 0;
+  display::duration frame_period_ = display::duration::zero();
+  display::time_point next_frame_ = display::clock::now();
+  bool paced_redraw_ = false;  // a redraw is already scheduled at next_frame_
+
+  // Two timestamps per swapchain image, around the render pass of its primary command buffer.
+  VkQueryPool timestamps_ = VK_NULL_HANDLE;
+  uint64_t timestamps_mask_ = ~uint64_t(0);  // timestampValidBits of the graphics queue family
+  std::vector<display::time_point> timestamps_submitted_;  // time_point() when no result is pending
+  display::duration gpu_clock_offset_;                    // GPU timestamps to display::clock, for tracing
+  bool gpu_clock_offset_known_ = false;
+  rolling_window<double> acquire_durations_{display::stats_samples_}, draw_durations_{display::stats_samples_},
+      submit_durations_{display::stats_samples_}, present_durations_{display::stats_samples_},
+      total_durations_{display::stats_samples_}, gpu_durations_{display::stats_samples_};
+  display::time_point last_stats_ = display::clock::now();
   glm::uvec2 size_;
   glm::vec4 clear_color_ = {0.0f, 0.0f, 0.0f, 1.0f};
+
+  view_ubo globals_values_ = {glm::mat4(1), glm::mat4(1)};
+  bool custom_proj_ = false;
+  std::shared_ptr<buffer> globals_buffer_;
+  shared_ref<view_ubo> globals_ubo_;
+  VkDescriptorPool globals_pool_ = VK_NULL_HANDLE;
+  VkDescriptorSet globals_ = VK_NULL_HANDLE;
   display::time_point last_frame_ = display::clock::now();
 
   void init_vulkan_surface();
+  static std::vector<VkPresentModeKHR> present_fallbacks(present_mode _mode);
+  void init_frames(size_t _count);
+  void init_globals();
+  void update_globals();
+  void init_timestamps(size_t _images_count);
+  void read_timestamps(uint32_t _image_index);
+  void record_capture(uint32_t _image_index, frame &_frame);
+  void destroy_frames();
   void dispatch_resize(const glm::uvec2 &);
-  void rebuild_cb(VkFramebuffer _fbo, VkCommandBuffer _cb);
+  bool record_nodes(uint32_t _image_index);
+  void rebuild_cb(uint32_t _image_index);
   void destroy_vulkan();
   void redraw(display::time_point);
 
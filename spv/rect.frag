@@ -0,0 +1,16 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(constant_id = 0) const uint textureSlots = 1;
+layout(set = 1, binding = 0) uniform sampler2D textures[textureSlots];
+
+layout(location = 0) in vec4 fragColor;
+layout(location = 1) in vec2 fragTexCoord;
+layout(location = 2) flat in uint fragTexture;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    outColor = fragColor * texture(textures[nonuniformEXT(fragTexture)], fragTexCoord);
+}
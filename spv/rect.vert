@@ -0,0 +1,36 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(set = 0, binding = 0) uniform WindowUniforms {
+    mat4 view;
+    mat4 proj;
+} globals;
+
+layout(push_constant) uniform PushConstants {
+    mat4 model;
+    uint textureIndex;
+} draw;
+
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec2 inSize;
+layout(location = 2) in vec4 inColor;
+layout(location = 3) in vec4 inTexCoords;
+layout(location = 4) in uint inTexture;
+
+layout(location = 0) out vec4 fragColor;
+layout(location = 1) out vec2 fragTexCoord;
+layout(location = 2) flat out uint fragTexture;
+
+out gl_PerVertex {
+    vec4 gl_Position;
+};
+
+const vec2 corners[4] = vec2[](vec2(0, 0), vec2(1, 0), vec2(1, 1), vec2(0, 1));
+
+void main() {
+    vec2 corner = corners[gl_VertexIndex];
+    gl_Position = globals.proj * globals.view * draw.model * vec4(inPosition + corner * inSize, 0.0, 1.0);
+    fragColor = inColor;
+    fragTexCoord = mix(inTexCoords.xy, inTexCoords.zw, corner);
+    fragTexture = inTexture;
+}
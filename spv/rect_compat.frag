@@ -0,0 +1,23 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(constant_id = 0) const uint textureSlots = 1;
+layout(set = 1, binding = 0) uniform sampler2D textures[textureSlots];
+
+layout(location = 0) in vec4 fragColor;
+layout(location = 1) in vec2 fragTexCoord;
+layout(location = 2) flat in uint fragTexture;
+
+layout(location = 0) out vec4 outColor;
+
+// Without descriptor indexing the table can't be indexed by a value varying within a draw, the loop counter is
+// uniform though. Gradients are taken outside of the non-uniform branch.
+void main() {
+    vec2 dx = dFdx(fragTexCoord), dy = dFdy(fragTexCoord);
+    vec4 texel = vec4(1.0);
+    for (uint i = 0; i < textureSlots; i++) {
+        if (i == fragTexture)
+            texel = textureGrad(textures[i], fragTexCoord, dx, dy);
+    }
+    outColor = fragColor * texel;
+}
@@ -1,7 +1,13 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
-layout(binding = 1) uniform sampler2D texSampler;
+layout(constant_id = 0) const uint textureSlots = 1;
+layout(set = 1, binding = 0) uniform sampler2D textures[textureSlots];
+
+layout(push_constant) uniform PushConstants {
+    mat4 model;
+    uint textureIndex;
+} draw;
 
 layout(location = 0) in vec3 fragColor;
 layout(location = 1) in vec2 fragTexCoord;
@@ -9,6 +15,6 @@ layout(location = 1) in vec2 fragTexCoord;
 layout(location = 0) out vec4 outColor;
 
 void main() {
-    vec4 texColor = texture(texSampler, fragTexCoord);
+    vec4 texColor = texture(textures[draw.textureIndex], fragTexCoord);
     outColor = mix(vec4(fragColor, 1.0), texColor, texColor.a);
 }
@@ -0,0 +1,29 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(set = 0, binding = 0) uniform WindowUniforms {
+    mat4 view;
+    mat4 proj;
+} globals;
+
+layout(push_constant) uniform PushConstants {
+    mat4 model;
+    uint textureIndex;
+} draw;
+
+layout(location = 0) in ivec2 inPosition;
+layout(location = 1) in vec3 inColor;
+layout(location = 2) in vec2 inTexCoord;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragTexCoord;
+
+out gl_PerVertex {
+    vec4 gl_Position;
+};
+
+void main() {
+    gl_Position = globals.proj * globals.view * draw.model * vec4(vec2(inPosition), 0.0, 1.0);
+    fragColor = inColor;
+    fragTexCoord = inTexCoord;
+}
\ No newline at end of file
@@ -1,11 +1,15 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
-layout(binding = 0) uniform UniformBufferObject {
-    mat4 model;
+layout(set = 0, binding = 0) uniform WindowUniforms {
     mat4 view;
     mat4 proj;
-} ubo;
+} globals;
+
+layout(push_constant) uniform PushConstants {
+    mat4 model;
+    uint textureIndex;
+} draw;
 
 layout(location = 0) in vec2 inPosition;
 layout(location = 1) in vec4 inColor;
@@ -17,6 +21,6 @@ out gl_PerVertex {
 };
 
 void main() {
-    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 0.0, 1.0);
+    gl_Position = globals.proj * globals.view * draw.model * vec4(inPosition, 0.0, 1.0);
     fragColor = inColor;
 }
@@ -0,0 +1,55 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(location = 0) in vec2 fragPosition;
+layout(location = 1) flat in vec2 fragHalfSize;
+layout(location = 2) flat in vec4 fragRadii;
+layout(location = 3) flat in vec4 fragFill;
+layout(location = 4) flat in vec4 fragStrokeColor;
+layout(location = 5) flat in vec2 fragStrokeBlur;
+layout(location = 6) flat in uint fragKind;
+
+layout(location = 0) out vec4 outColor;
+
+const uint SHAPE_ELLIPSE = 1;
+
+// radii are top-left, top-right, bottom-right, bottom-left, y grows downwards
+float boxDistance(vec2 p, vec2 halfSize, vec4 radii) {
+    vec2 side = p.x > 0.0 ? radii.yz : radii.xw;
+    float radius = p.y > 0.0 ? side.y : side.x;
+    vec2 q = abs(p) - halfSize + radius;
+    return min(max(q.x, q.y), 0.0) + length(max(q, 0.0)) - radius;
+}
+
+// not exact away from the outline, but good enough for its anti-aliasing, strokes and shadows
+float ellipseDistance(vec2 p, vec2 halfSize) {
+    float k0 = length(p / halfSize);
+    float k1 = length(p / (halfSize * halfSize));
+    return k1 > 1e-6 ? k0 * (k0 - 1.0) / k1 : -min(halfSize.x, halfSize.y);
+}
+
+float erfApprox(float x) {
+    float a = abs(x);
+    float d = 1.0 + (0.278393 + (0.230389 + 0.078108 * a * a) * a) * a;
+    d *= d;
+    return sign(x) * (1.0 - 1.0 / (d * d));
+}
+
+void main() {
+    float d = fragKind == SHAPE_ELLIPSE ? ellipseDistance(fragPosition, fragHalfSize)
+                                        : boxDistance(fragPosition, fragHalfSize, fragRadii);
+    float stroke = fragStrokeBlur.x, blur = fragStrokeBlur.y;
+
+    if (blur > 0.0) {
+        // exact for straight edges, the coverage of a gaussian across the outline
+        outColor = vec4(fragFill.rgb, fragFill.a * (0.5 - 0.5 * erfApprox(d / (blur * sqrt(2.0)))));
+        return;
+    }
+
+    float pixel = max(fwidth(d), 1e-4);  // follows the model's scale and rotation
+    float coverage = clamp(0.5 - d / pixel, 0.0, 1.0);
+    vec4 color = fragFill;
+    if (stroke > 0.0)
+        color = mix(fragFill, fragStrokeColor, clamp(0.5 + (d + stroke) / pixel, 0.0, 1.0));
+    outColor = vec4(color.rgb, color.a * coverage);
+}
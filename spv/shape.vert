@@ -0,0 +1,52 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(set = 0, binding = 0) uniform WindowUniforms {
+    mat4 view;
+    mat4 proj;
+} globals;
+
+layout(push_constant) uniform PushConstants {
+    mat4 model;
+    uint textureIndex;
+} draw;
+
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec2 inSize;
+layout(location = 2) in vec4 inRadii;
+layout(location = 3) in vec4 inFill;
+layout(location = 4) in vec4 inStrokeColor;
+layout(location = 5) in float inStroke;
+layout(location = 6) in float inBlur;
+layout(location = 7) in uint inKind;
+
+layout(location = 0) out vec2 fragPosition;  // from the center of the shape
+layout(location = 1) flat out vec2 fragHalfSize;
+layout(location = 2) flat out vec4 fragRadii;
+layout(location = 3) flat out vec4 fragFill;
+layout(location = 4) flat out vec4 fragStrokeColor;
+layout(location = 5) flat out vec2 fragStrokeBlur;
+layout(location = 6) flat out uint fragKind;
+
+out gl_PerVertex {
+    vec4 gl_Position;
+};
+
+const vec2 corners[4] = vec2[](vec2(0, 0), vec2(1, 0), vec2(1, 1), vec2(0, 1));
+
+void main() {
+    // grown by a pixel for anti-aliasing, assuming a model scale close to 1, and by the reach of the shadow's gaussian
+    float margin = 1.0 + 3.0 * inBlur;
+    vec2 corner = corners[gl_VertexIndex];
+    vec2 local = corner * (inSize + 2.0 * margin) - margin;
+    gl_Position = globals.proj * globals.view * draw.model * vec4(inPosition + local, 0.0, 1.0);
+
+    fragHalfSize = inSize * 0.5;
+    fragPosition = local - fragHalfSize;
+    // a radius can't be over half of the shorter side
+    fragRadii = min(inRadii, vec4(min(fragHalfSize.x, fragHalfSize.y)));
+    fragFill = inFill;
+    fragStrokeColor = inStrokeColor;
+    fragStrokeBlur = vec2(inStroke, inBlur);
+    fragKind = inKind;
+}
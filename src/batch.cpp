@@ -0,0 +1,183 @@
+/*  _ _ _   _       _
+ * | |_| |_| |_ _ _| |_
+ * | | | . |   | | |  _|
+ * |_|_|___|_|_|___|_|
+ * Hobby graphics and GUI library under the MIT License (MIT)
+ *
+ * Copyright (c) 2014 Jean-Baptiste Lepesme github.com/jiboo/libhut
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <algorithm>
+#include <cstring>
+#include <tuple>
+
+#include "hut/batch.hpp"
+
+using namespace hut;
+
+void batch::add(const batch_item &_item) {
+  items_.emplace_back(_item);
+  items_.back().layer_ = layer_;
+  items_.back().order_ = (uint32_t)items_.size() - 1;
+  if (_item.set_layout_ != nullptr) {
+    auto size = _item.set_layout_->size();
+    items_.back().set_offset_ = keys_.size();
+    items_.back().set_data_ = nullptr;
+    keys_.insert(keys_.end(), (const uint8_t *)_item.set_data_, (const uint8_t *)_item.set_data_ + size);
+  }
+  if (_item.owners_ != nullptr) {
+    owners_.insert(owners_.end(), _item.owners_->begin(), _item.owners_->end());
+    items_.back().owners_ = nullptr;
+  }
+}
+
+bool batch::before(const batch_item &_a, const batch_item &_b) {
+  if (_a.layer_ != _b.layer_)
+    return _a.layer_ < _b.layer_;
+  if (_a.blend_ != _b.blend_)
+    return !_a.blend_;  // opaque first
+  if (_a.blend_)
+    return _a.order_ < _b.order_;  // painter's order
+
+  auto key = [](const batch_item &_item) {
+    return std::tie(_item.pipeline_, _item.descriptor_, _item.constants_.texture, _item.vertices_,
+                    _item.vertices_offset_, _item.indices_);
+  };
+  if (key(_a) != key(_b))
+    return key(_a) < key(_b);
+  // only items with the same model can merge, group them before ordering their ranges
+  int model = memcmp(&_a.constants_.model, &_b.constants_.model, sizeof(_a.constants_.model));
+  if (model != 0)
+    return model < 0;
+  return std::tie(_a.first_index_, _a.first_instance_, _a.order_)
+         < std::tie(_b.first_index_, _b.first_instance_, _b.order_);
+}
+
+bool batch::mergeable(const batch_item &_a, const batch_item &_b) {
+  if (_a.pipeline_ != _b.pipeline_ || _a.mode_ != _b.mode_ || _a.descriptor_ != _b.descriptor_
+      || _a.vertices_ != _b.vertices_ || _a.vertices_offset_ != _b.vertices_offset_ || _a.indices_ != _b.indices_
+      || _a.index_type_ != _b.index_type_
+      || memcmp(&_a.constants_, &_b.constants_, sizeof(draw_constants)) != 0)
+    return false;
+
+  bool same_indices = _a.first_index_ == _b.first_index_ && _a.index_count_ == _b.index_count_;
+  bool same_instances = _a.first_instance_ == _b.first_instance_ && _a.instance_count_ == _b.instance_count_;
+  if (same_indices)
+    return _a.first_instance_ + _a.instance_count_ == _b.first_instance_;  // instances following each other
+  if (same_instances)
+    return _a.first_index_ + _a.index_count_ == _b.first_index_;  // indices following each other
+  return false;
+}
+
+void batch::merge() {
+  std::sort(items_.begin(), items_.end(), before);
+
+  draws_.clear();
+  changes_.clear();
+  stats_ = batch_stats();
+  stats_.items = items_.size();
+
+  size_t immediate_binds = 0;
+  for (auto &item : items_) {
+    immediate_binds += item.descriptor_ == VK_NULL_HANDLE ? 6 : 7;
+
+    if (!draws_.empty() && mergeable(draws_.back(), item)) {
+      auto &last = draws_.back();
+      if (last.first_index_ == item.first_index_ && last.index_count_ == item.index_count_)
+        last.instance_count_ += item.instance_count_;
+      else
+        last.index_count_ += item.index_count_;
+      continue;
+    }
+
+    uint8_t changes = CPIPELINE | CDESCRIPTOR | CCONSTANTS | CVERTICES | CINDICES;
+    if (!draws_.empty()) {
+      auto &last = draws_.back();
+      changes = 0;
+      if (item.pipeline_ != last.pipeline_ || item.mode_ != last.mode_)
+        changes |= CPIPELINE;
+      // a different layout may disturb set 2, sets 0 and 1 and the push constants are compatible across pipelines
+      if (item.descriptor_ != last.descriptor_ || item.layout_ != last.layout_)
+        changes |= CDESCRIPTOR;
+      if (memcmp(&item.constants_, &last.constants_, sizeof(draw_constants)) != 0)
+        changes |= CCONSTANTS;
+      if (item.vertices_ != last.vertices_ || item.vertices_offset_ != last.vertices_offset_)
+        changes |= CVERTICES;
+      if (item.indices_ != last.indices_ || item.index_type_ != last.index_type_)
+        changes |= CINDICES;
+    }
+    if (item.descriptor_ == VK_NULL_HANDLE)
+      changes &= ~CDESCRIPTOR;
+
+    draws_.emplace_back(item);
+    changes_.emplace_back(changes);
+    for (uint8_t bit = changes; bit != 0; bit &= bit - 1)
+      stats_.binds++;
+  }
+  items_.clear();
+
+  if (!draws_.empty())
+    stats_.binds += 2;  // viewport and scissor
+  stats_.draws = draws_.size();
+  stats_.saved_draws = stats_.items - stats_.draws;
+  stats_.saved_binds = immediate_binds - stats_.binds;
+}
+
+void batch::flush(recorder &_recorder, const glm::uvec2 &_size) {
+  for (auto &item : items_) {
+    if (item.set_layout_ != nullptr)
+      item.descriptor_ = _recorder.descriptors().get(*item.set_layout_, keys_.data() + item.set_offset_);
+  }
+  keys_.clear();
+  std::sort(owners_.begin(), owners_.end());
+  owners_.erase(std::unique(owners_.begin(), owners_.end()), owners_.end());
+  for (auto &owner : owners_) {
+    if (owner)
+      _recorder.descriptors().keep(owner);
+  }
+  owners_.clear();
+  merge();
+  layer_ = 0;
+  if (draws_.empty())
+    return;
+
+  _recorder.full_viewport(_size);
+
+  for (size_t i = 0; i < draws_.size(); i++) {
+    auto &draw = draws_[i];
+    uint8_t changes = changes_[i];
+    if (changes & CPIPELINE) {
+      _recorder.bind_pipeline(draw.pipeline_);
+      _recorder.blend(draw.mode_);
+    }
+    if (changes & CDESCRIPTOR)
+      _recorder.bind_descriptor_sets(draw.layout_, 2, 1, &draw.descriptor_);
+    if (changes & CCONSTANTS)
+      _recorder.push_constants(draw.layout_, draw_constants_range.stageFlags, draw_constants_range.offset,
+                               draw_constants_range.size, &draw.constants_);
+    if (changes & CVERTICES)
+      _recorder.bind_vertex_buffer(0, draw.vertices_, draw.vertices_offset_);
+    if (changes & CINDICES)
+      _recorder.bind_index_buffer(draw.indices_, 0, draw.index_type_);
+    _recorder.draw_indexed(draw.index_count_, draw.instance_count_, draw.first_index_, 0, draw.first_instance_);
+  }
+}
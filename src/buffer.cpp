@@ -28,8 +28,10 @@
 #include <algorithm>
 #include <cstring>
 #include <iostream>
+#include <limits>
 
 #include "hut/buffer.hpp"
+#include "hut/trace.hpp"
 
 using namespace hut;
 
@@ -77,12 +79,14 @@ void buffer::init(uint32_t _size, VkMemoryPropertyFlags _type, VkBufferUsageFlag
 }
 
 void buffer::update(uint32_t _offset, uint32_t _size, const void *_data) {
+  HUT_TRACE_ZONE("upload", "buffer update");
   if (type_ & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
     void *target;
     vkMapMemory(display_.device_, memory_, _offset, _size, 0, &target);
     memcpy(target, _data, _size);
     vkUnmapMemory(display_.device_, memory_);
   } else {
+    std::lock_guard<std::recursive_mutex> lock(display_.staging_mutex_);
     buffer::range_t staging = display_.staging_->do_alloc(_size);
     VkBufferCopy copy;
     copy.size = _size;
@@ -111,8 +115,23 @@ void buffer::copy_from(buffer &_other, uint32_t _other_offset, uint32_t _this_of
   copy_from(_other.buffer_, _other_offset, _this_offset, _size);
 }
 
+buffer::indices buffer::allocate_indices(uint32_t _vertex_count, const std::vector<uint32_t> &_indices) {
+  if (_vertex_count > std::numeric_limits<uint16_t>::max() + 1) {
+    auto result = allocate<uint32_t>(_indices.size());
+    result->set(_indices);
+    return result;
+  }
+
+  std::vector<uint16_t> narrowed(_indices.begin(), _indices.end());
+  auto result = allocate<uint16_t>(narrowed.size());
+  result->set(narrowed);
+  return result;
+}
+
 void buffer::grow(uint32_t new_size) {
+  HUT_TRACE_ZONE("upload", "buffer grow");
   assert(new_size > size_);
+  std::lock_guard<std::recursive_mutex> lock(display_.staging_mutex_);  // records a copy, may be called while recording
 
   VkBuffer old_buff = buffer_;
   VkDeviceMemory old_mem = memory_;
@@ -143,29 +162,36 @@ void buffer::grow(uint32_t new_size) {
   }
 }
 
-buffer::range_t buffer::do_alloc(uint32_t _size) {
+buffer::range_t buffer::do_alloc(uint32_t _size, uint32_t _align, bool _grow) {
+  auto aligned = [_align](uint32_t _offset) { return (_offset + _align - 1) / _align * _align; };
+
   auto it = ranges_.cbegin();
   for (; it != ranges_.cend(); it++) {
-    if (!it->allocated_ && it->size_ >= _size)
+    if (!it->allocated_ && it->size_ >= aligned(it->offset_) - it->offset_ + _size)
       break;
   }
 
   if (it == ranges_.cend()) {
-    grow(_size < size_ ? size_ * 2 : _size * 2);
-    return do_alloc(_size);
+    if (!_grow)
+      return range_t{0, 0, false};
+    grow(_size < size_ ? size_ * 2 : (_size + _align) * 2);
+    return do_alloc(_size, _align);
   }
 
   range_t result;
-  result.offset_ = it->offset_;
+  result.offset_ = aligned(it->offset_);
   result.size_ = _size;
   result.allocated_ = true;
 
+  range_t padding = {it->offset_, result.offset_ - it->offset_, false};
   range_t free_block = *it;
   ranges_.erase(it);
 
-  free_block.offset_ += _size;
-  free_block.size_ -= _size;
+  free_block.offset_ = result.offset_ + _size;
+  free_block.size_ -= padding.size_ + _size;
 
+  if (padding.size_ != 0)
+    ranges_.insert(padding);
   ranges_.insert(result);
   ranges_.insert(free_block);
 
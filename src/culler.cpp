@@ -0,0 +1,295 @@
+/*  _ _ _   _       _
+ * | |_| |_| |_ _ _| |_
+ * | | | . |   | | |  _|
+ * |_|_|___|_|_|___|_|
+ * Hobby graphics and GUI library under the MIT License (MIT)
+ *
+ * Copyright (c) 2014 Jean-Baptiste Lepesme github.com/jiboo/libhut
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+
+#include "spv.h"
+
+#include "hut/culler.hpp"
+#include "hut/display.hpp"
+#include "hut/window.hpp"
+
+using namespace hut;
+
+namespace {
+
+VkDeviceSize align(VkDeviceSize _size, VkDeviceSize _alignment) {
+  return (_size + _alignment - 1) / _alignment * _alignment;
+}
+
+}  // namespace
+
+culler::culler(window &_window, uint32_t _capacity, uint32_t _stride)
+    : window_(_window), display_(_window.display_), capacity_(_capacity), stride_(_stride),
+      instances_((size_t)_capacity * _stride) {
+  display_.check_thread();
+  if (_stride < 4 * sizeof(float) || _stride % 4 != 0)
+    throw std::runtime_error("culled instances must start with a position and a size, in 4 bytes words!");
+
+  VkDeviceSize alignment = std::max<VkDeviceSize>(display_.device_props_.limits.minStorageBufferOffsetAlignment, 16);
+  params_size_ = align(sizeof(params), alignment);
+  command_size_ = align(sizeof(VkDrawIndexedIndirectCommand), alignment);
+
+  {
+    std::lock_guard<std::mutex> lock(display_.pipelines_mutex_);
+    shader_ = display_.get_shader(__spv::cull_comp_spv.data(), __spv::cull_comp_spv.size());
+  }
+
+  std::array<VkDescriptorSetLayoutBinding, 4> bindings = {};
+  for (uint32_t i = 0; i < bindings.size(); i++) {
+    bindings[i].binding = i;
+    bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[i].descriptorCount = 1;
+    bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  }
+  VkDescriptorSetLayoutCreateInfo layout_info = {};
+  layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layout_info.bindingCount = (uint32_t)bindings.size();
+  layout_info.pBindings = bindings.data();
+  if (vkCreateDescriptorSetLayout(display_.device_, &layout_info, nullptr, &layout_) != VK_SUCCESS)
+    throw std::runtime_error("failed to create culling descriptor set layout!");
+
+  VkPipelineLayoutCreateInfo pipeline_layout_info = {};
+  pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipeline_layout_info.setLayoutCount = 1;
+  pipeline_layout_info.pSetLayouts = &layout_;
+  if (vkCreatePipelineLayout(display_.device_, &pipeline_layout_info, nullptr, &pipeline_layout_) != VK_SUCCESS)
+    throw std::runtime_error("failed to create culling pipeline layout!");
+
+  VkComputePipelineCreateInfo pipeline_info = {};
+  pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  pipeline_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  pipeline_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  pipeline_info.stage.module = shader_->module_;
+  pipeline_info.stage.pName = "main";
+  pipeline_info.layout = pipeline_layout_;
+  if (vkCreateComputePipelines(display_.device_, display_.pipeline_cache_, 1, &pipeline_info, nullptr, &pipeline_)
+      != VK_SUCCESS)
+    throw std::runtime_error("failed to create culling pipeline!");
+
+  VkCommandPoolCreateInfo pool_info = {};
+  pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  pool_info.queueFamilyIndex = display_.iqueuec_;
+  if (vkCreateCommandPool(display_.device_, &pool_info, nullptr, &command_pool_) != VK_SUCCESS)
+    throw std::runtime_error("failed to create culling command pool!");
+
+  window_.cullers_.emplace_back(this);
+}
+
+culler::~culler() {
+  display_.check_thread();
+  window_.cullers_.erase(std::find(window_.cullers_.begin(), window_.cullers_.end(), this));
+
+  VkDevice device = display_.device_;
+  vkDeviceWaitIdle(device);
+  destroy_images();
+  vkDestroyCommandPool(device, command_pool_, nullptr);
+  vkDestroyPipeline(device, pipeline_, nullptr);
+  vkDestroyPipelineLayout(device, pipeline_layout_, nullptr);
+  vkDestroyDescriptorSetLayout(device, layout_, nullptr);
+}
+
+void culler::write(uint32_t _first, const void *_instances, uint32_t _count) {
+  assert(_first + _count <= capacity_);
+  memcpy(instances_.data() + (size_t)_first * stride_, _instances, (size_t)_count * stride_);
+  for (auto &image : images_)
+    image.dirty_ = true;
+}
+
+void culler::count(uint32_t _count) {
+  assert(_count <= capacity_);
+  if (_count > count_) {
+    for (auto &image : images_)
+      image.dirty_ = true;
+  }
+  count_ = _count;
+}
+
+void culler::model(const glm::mat4 &_model) {
+  model_ = _model;
+}
+
+void culler::clip(const glm::vec4 &_rect) {
+  custom_clip_ = true;
+  clip_ = _rect;
+}
+
+void culler::clip() {
+  custom_clip_ = false;
+}
+
+void culler::create_buffer(VkDeviceSize _size, VkBufferUsageFlags _usage, VkMemoryPropertyFlags _type,
+                           VkBuffer &_buffer, VkDeviceMemory &_memory) {
+  uint32_t families[] = {display_.iqueueg_, display_.iqueuec_};
+  VkBufferCreateInfo buffer_info = {};
+  buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  buffer_info.size = _size;
+  buffer_info.usage = _usage;
+  // written by the compute queue and read by the graphics one, without ownership transfers
+  buffer_info.sharingMode = families[0] == families[1] ? VK_SHARING_MODE_EXCLUSIVE : VK_SHARING_MODE_CONCURRENT;
+  buffer_info.queueFamilyIndexCount = families[0] == families[1] ? 0 : 2;
+  buffer_info.pQueueFamilyIndices = families;
+  if (vkCreateBuffer(display_.device_, &buffer_info, nullptr, &_buffer) != VK_SUCCESS)
+    throw std::runtime_error("failed to create culling buffer!");
+
+  VkMemoryRequirements requirements;
+  vkGetBufferMemoryRequirements(display_.device_, _buffer, &requirements);
+  VkMemoryAllocateInfo alloc_info = {};
+  alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  alloc_info.allocationSize = requirements.size;
+  alloc_info.memoryTypeIndex = display_.find_memory_type(requirements.memoryTypeBits, _type).first;
+  if (vkAllocateMemory(display_.device_, &alloc_info, nullptr, &_memory) != VK_SUCCESS)
+    throw std::runtime_error("failed to allocate culling buffer memory!");
+  vkBindBufferMemory(display_.device_, _buffer, _memory, 0);
+}
+
+void culler::init_images(size_t _count) {
+  destroy_images();
+  images_.resize(_count);
+  VkDevice device = display_.device_;
+  VkDeviceSize instances_size = std::max<VkDeviceSize>(instances_.size(), 4);
+
+  VkDescriptorPoolSize pool_size = {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, (uint32_t)(4 * _count)};
+  VkDescriptorPoolCreateInfo pool_info = {};
+  pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  pool_info.poolSizeCount = 1;
+  pool_info.pPoolSizes = &pool_size;
+  pool_info.maxSets = (uint32_t)_count;
+  if (vkCreateDescriptorPool(device, &pool_info, nullptr, &descriptor_pool_) != VK_SUCCESS)
+    throw std::runtime_error("failed to create culling descriptor pool!");
+
+  for (auto &image : images_) {
+    create_buffer(params_size_ + instances_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, image.host_,
+                  image.host_memory_);
+    vkMapMemory(device, image.host_memory_, 0, VK_WHOLE_SIZE, 0, (void **)&image.mapped_);
+    create_buffer(command_size_ + instances_size,
+                  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT
+                      | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image.device_, image.device_memory_);
+
+    VkDescriptorSetAllocateInfo alloc_info = {};
+    alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    alloc_info.descriptorPool = descriptor_pool_;
+    alloc_info.descriptorSetCount = 1;
+    alloc_info.pSetLayouts = &layout_;
+    if (vkAllocateDescriptorSets(device, &alloc_info, &image.set_) != VK_SUCCESS)
+      throw std::runtime_error("failed to allocate culling descriptor set!");
+
+    std::array<VkDescriptorBufferInfo, 4> infos = {{
+        {image.host_, 0, sizeof(params)},
+        {image.host_, params_size_, instances_size},
+        {image.device_, 0, sizeof(VkDrawIndexedIndirectCommand)},
+        {image.device_, command_size_, instances_size},
+    }};
+    std::array<VkWriteDescriptorSet, 4> writes = {};
+    for (uint32_t i = 0; i < writes.size(); i++) {
+      writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+      writes[i].dstSet = image.set_;
+      writes[i].dstBinding = i;
+      writes[i].descriptorCount = 1;
+      writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+      writes[i].pBufferInfo = &infos[i];
+    }
+    vkUpdateDescriptorSets(device, (uint32_t)writes.size(), writes.data(), 0, nullptr);
+
+    // recorded once, the parameters are read from the host buffer
+    VkCommandBufferAllocateInfo cb_info = {};
+    cb_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    cb_info.commandPool = command_pool_;
+    cb_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    cb_info.commandBufferCount = 1;
+    if (vkAllocateCommandBuffers(device, &cb_info, &image.cb_) != VK_SUCCESS)
+      throw std::runtime_error("failed to allocate culling command buffer!");
+
+    VkCommandBufferBeginInfo begin_info = {};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    vkBeginCommandBuffer(image.cb_, &begin_info);
+    vkCmdFillBuffer(image.cb_, image.device_, offsetof(VkDrawIndexedIndirectCommand, instanceCount),
+                    sizeof(uint32_t), 0);
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(image.cb_, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                         &barrier, 0, nullptr, 0, nullptr);
+    vkCmdBindPipeline(image.cb_, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_);
+    vkCmdBindDescriptorSets(image.cb_, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout_, 0, 1, &image.set_, 0,
+                            nullptr);
+    vkCmdDispatch(image.cb_, (capacity_ + 63) / 64, 1, 1);
+    if (vkEndCommandBuffer(image.cb_) != VK_SUCCESS)
+      throw std::runtime_error("failed to record culling command buffer!");
+  }
+}
+
+void culler::destroy_images() {
+  VkDevice device = display_.device_;
+  for (auto &image : images_) {
+    if (image.cb_ != VK_NULL_HANDLE)
+      vkFreeCommandBuffers(device, command_pool_, 1, &image.cb_);
+    if (image.mapped_ != nullptr)
+      vkUnmapMemory(device, image.host_memory_);
+    vkDestroyBuffer(device, image.host_, nullptr);
+    vkDestroyBuffer(device, image.device_, nullptr);
+    vkFreeMemory(device, image.host_memory_, nullptr);
+    vkFreeMemory(device, image.device_memory_, nullptr);
+  }
+  images_.clear();
+  if (descriptor_pool_ != VK_NULL_HANDLE)
+    vkDestroyDescriptorPool(device, descriptor_pool_, nullptr);
+  descriptor_pool_ = VK_NULL_HANDLE;
+}
+
+void culler::update(uint32_t _image) {
+  if (images_.size() != window_.swapchain_images_.size())
+    init_images(window_.swapchain_images_.size());  // the window waited for the device when recreating them
+
+  auto &image = images_[_image];
+  params values;
+  values.transform = window_.globals_values_.view * model_;
+  values.clip = custom_clip_ ? clip_ : glm::vec4(0, 0, window_.size_.x, window_.size_.y);
+  values.count = count_;
+  values.stride = stride_ / 4;
+  memcpy(image.mapped_, &values, sizeof(params));
+
+  if (image.dirty_) {
+    memcpy(image.mapped_ + params_size_, instances_.data(), (size_t)count_ * stride_);
+    image.dirty_ = false;
+  }
+}
+
+void culler::record(recorder &_recorder) {
+  uint32_t image = _recorder.image();
+  assert(image < images_.size());  // the window updates its cullers before recording
+  _recorder.bind_vertex_buffer(0, images_[image].device_, command_size_);
+  _recorder.draw_indexed_indirect(images_[image].device_, 0, 1, sizeof(VkDrawIndexedIndirectCommand));
+}
@@ -0,0 +1,170 @@
+/*  _ _ _   _       _
+ * | |_| |_| |_ _ _| |_
+ * | | | . |   | | |  _|
+ * |_|_|___|_|_|___|_|
+ * Hobby graphics and GUI library under the MIT License (MIT)
+ *
+ * Copyright (c) 2014 Jean-Baptiste Lepesme github.com/jiboo/libhut
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <cstring>
+
+#include "hut/descriptors.hpp"
+#include "hut/display.hpp"
+
+using namespace hut;
+
+descriptor_layout::descriptor_layout(display &_display, VkDescriptorSetLayout _layout,
+                                     const std::vector<VkDescriptorUpdateTemplateEntry> &_entries, size_t _size)
+    : display_(_display), layout_(_layout), entries_(_entries), size_(_size) {
+  if (!display_.descriptor_templates() || entries_.empty())
+    return;
+
+  VkDescriptorUpdateTemplateCreateInfo info = {};
+  info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO;
+  info.descriptorUpdateEntryCount = (uint32_t)entries_.size();
+  info.pDescriptorUpdateEntries = entries_.data();
+  info.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET;
+  info.descriptorSetLayout = layout_;
+
+  if (display_.create_template_(display_.device_, &info, nullptr, &template_) != VK_SUCCESS)
+    throw std::runtime_error("failed to create descriptor update template!");
+}
+
+descriptor_layout::~descriptor_layout() {
+  if (template_ != VK_NULL_HANDLE)
+    display_.destroy_template_(display_.device_, template_, nullptr);
+}
+
+descriptor_cache::descriptor_cache(display &_display) : display_(_display) {
+}
+
+descriptor_cache::~descriptor_cache() {
+  for (auto pool : pools_)
+    vkDestroyDescriptorPool(display_.device_, pool, nullptr);
+}
+
+VkDescriptorSet descriptor_cache::get(const descriptor_layout &_layout, const void *_data,
+                                      const std::vector<std::shared_ptr<const void>> &_owners) {
+  std::string key(sizeof(VkDescriptorSetLayout) + _layout.size_, '\0');
+  memcpy(&key[0], &_layout.layout_, sizeof(VkDescriptorSetLayout));
+  memcpy(&key[sizeof(VkDescriptorSetLayout)], _data, _layout.size_);
+
+  auto it = sets_.find(key);
+  if (it != sets_.end())
+    return it->second;
+
+  VkDescriptorSet result = allocate(_layout.layout_);
+  write(_layout, result, _data);
+  sets_.emplace(std::move(key), result);
+  for (auto &owner : _owners) {  // the set exists as long as the recording, so do its resources
+    if (owner)
+      keep(owner);
+  }
+  return result;
+}
+
+void descriptor_cache::reset() {
+  for (size_t i = 0; i < pools_.size() && i <= current_; i++)
+    vkResetDescriptorPool(display_.device_, pools_[i], 0);
+  current_ = 0;
+  sets_.clear();
+  kept_.clear();
+}
+
+VkDescriptorSet descriptor_cache::allocate(VkDescriptorSetLayout _layout) {
+  VkDescriptorSetAllocateInfo alloc_info = {};
+  alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  alloc_info.descriptorSetCount = 1;
+  alloc_info.pSetLayouts = &_layout;
+
+  for (; current_ < pools_.size(); current_++) {
+    alloc_info.descriptorPool = pools_[current_];
+    VkDescriptorSet result;
+    VkResult status = vkAllocateDescriptorSets(display_.device_, &alloc_info, &result);
+    if (status == VK_SUCCESS)
+      return result;
+    if (status != VK_ERROR_OUT_OF_POOL_MEMORY && status != VK_ERROR_FRAGMENTED_POOL)
+      throw std::runtime_error("failed to allocate descriptor set!");
+  }
+
+  // every pool is full, sized for the bindings of hut's drawables
+  VkDescriptorPoolSize sizes[] = {
+      {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, sets_per_pool_ * 2},
+      {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, sets_per_pool_},
+      {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, sets_per_pool_},
+  };
+  VkDescriptorPoolCreateInfo pool_info = {};
+  pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  pool_info.poolSizeCount = sizeof(sizes) / sizeof(sizes[0]);
+  pool_info.pPoolSizes = sizes;
+  pool_info.maxSets = sets_per_pool_;
+
+  VkDescriptorPool pool;
+  if (vkCreateDescriptorPool(display_.device_, &pool_info, nullptr, &pool) != VK_SUCCESS)
+    throw std::runtime_error("failed to create descriptor pool!");
+  pools_.emplace_back(pool);
+  current_ = pools_.size() - 1;
+
+  alloc_info.descriptorPool = pool;
+  VkDescriptorSet result;
+  if (vkAllocateDescriptorSets(display_.device_, &alloc_info, &result) != VK_SUCCESS)
+    throw std::runtime_error("failed to allocate descriptor set!");
+  return result;
+}
+
+void descriptor_cache::write(const descriptor_layout &_layout, VkDescriptorSet _set, const void *_data) {
+  if (_layout.template_ != VK_NULL_HANDLE) {
+    display_.update_with_template_(display_.device_, _set, _layout.template_, _data);
+    return;
+  }
+
+  std::vector<VkWriteDescriptorSet> writes(_layout.entries_.size());
+  for (size_t i = 0; i < writes.size(); i++) {
+    auto &entry = _layout.entries_[i];
+    auto &write = writes[i];
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = _set;
+    write.dstBinding = entry.dstBinding;
+    write.dstArrayElement = entry.dstArrayElement;
+    write.descriptorCount = entry.descriptorCount;
+    write.descriptorType = entry.descriptorType;
+
+    auto info = (const uint8_t *)_data + entry.offset;
+    switch (entry.descriptorType) {
+      case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+      case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+      case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
+      case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC:
+        write.pBufferInfo = (const VkDescriptorBufferInfo *)info;
+        break;
+      case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
+      case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:
+        write.pTexelBufferView = (const VkBufferView *)info;
+        break;
+      default:
+        write.pImageInfo = (const VkDescriptorImageInfo *)info;
+        break;
+    }
+  }
+  vkUpdateDescriptorSets(display_.device_, (uint32_t)writes.size(), writes.data(), 0, nullptr);
+}
@@ -28,12 +28,21 @@
 #include <cassert>
 #include <cstring>
 
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
 #include <algorithm>
+#include <fstream>
 #include <iostream>
+#include <limits>
 #include <set>
 #include <unordered_set>
 
 #include "hut/display.hpp"
+#include "hut/trace.hpp"
 
 using namespace hut;
 
@@ -42,7 +51,7 @@ void display::post(display::callback _callback) {
     std::lock_guard<std::mutex> lock(posted_mutex_);
     posted_jobs_.emplace(posted_jobs_.end(), _callback);
   }
-  cv_.notify_one();
+  wakeup();
 }
 
 void display::post_overridable(callback _callback, size_t _id) {
@@ -50,15 +59,19 @@ void display::post_overridable(callback _callback, size_t _id) {
     std::lock_guard<std::mutex> lock(overridable_mutex_);
     overridable_jobs_.emplace(_id, _callback);
   }
-  cv_.notify_one();
+  wakeup();
 }
 
 void display::post_delayed(display::callback _callback, std::chrono::milliseconds _delay) {
+  post_at(_callback, display::clock::now() + _delay);
+}
+
+void display::post_at(display::callback _callback, time_point _when) {
   {
     std::lock_guard<std::mutex> lock(delayed_mutex_);
-    delayed_jobs_.emplace(display::clock::now() + _delay, _callback);
+    delayed_jobs_.emplace(_when, _callback);
   }
-  cv_.notify_one();
+  wakeup();
 }
 
 display::time_point display::next_job_time_point() {
@@ -82,6 +95,7 @@ display::time_point display::next_job_time_point() {
 }
 
 void display::tick_posted(time_point _now) {
+  HUT_TRACE_ZONE("jobs", "tick_posted");
   decltype(posted_jobs_) tmp;
   {
     std::lock_guard<std::mutex> lock(posted_mutex_);
@@ -93,6 +107,7 @@ void display::tick_posted(time_point _now) {
 }
 
 void display::tick_overridable(time_point _now) {
+  HUT_TRACE_ZONE("jobs", "tick_overridable");
   decltype(overridable_jobs_) tmp;
   {
     std::lock_guard<std::mutex> lock(overridable_mutex_);
@@ -104,6 +119,7 @@ void display::tick_overridable(time_point _now) {
 }
 
 void display::tick_delayed(time_point _now) {
+  HUT_TRACE_ZONE("jobs", "tick_delayed");
   decltype(delayed_jobs_) tmp;
   {
     std::lock_guard<std::mutex> lock(delayed_mutex_);
@@ -124,24 +140,74 @@ void display::tick_delayed(time_point _now) {
   }
 }
 
+void display::init_jobs_loop() {
+  wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (wake_fd_ < 0)
+    throw std::runtime_error(sstream("failed to create eventfd: ") << strerror(errno));
+
+  timer_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (timer_fd_ < 0)
+    throw std::runtime_error(sstream("failed to create timerfd: ") << strerror(errno));
+}
+
+void display::destroy_jobs_loop() {
+  if (wake_fd_ >= 0)
+    close(wake_fd_);
+  if (timer_fd_ >= 0)
+    close(timer_fd_);
+  wake_fd_ = timer_fd_ = -1;
+}
+
+void display::wakeup() {
+  uint64_t one = 1;
+  if (write(wake_fd_, &one, sizeof(one)) < 0 && errno != EAGAIN)
+    throw std::runtime_error(sstream("failed to wake up jobs loop: ") << strerror(errno));
+}
+
+void display::wait_until(time_point _deadline) {
+  using namespace std::chrono;
+
+  const bool timed = _deadline != time_point::max();
+  const time_point alarm = timed ? _deadline - spin_duration_ : _deadline;
+
+  if (!timed || clock::now() < alarm) {
+    itimerspec timer = {};
+    if (timed) {
+      // steady_clock is CLOCK_MONOTONIC, so its epoch can be used as is with TFD_TIMER_ABSTIME
+      auto since_epoch = duration_cast<nanoseconds>(alarm.time_since_epoch());
+      timer.it_value.tv_sec = (time_t)duration_cast<seconds>(since_epoch).count();
+      timer.it_value.tv_nsec = (long)(since_epoch % seconds(1)).count();
+    }
+    timerfd_settime(timer_fd_, TFD_TIMER_ABSTIME, &timer, nullptr);
+
+    pollfd fds[2] = {{wake_fd_, POLLIN, 0}, {timer_fd_, POLLIN, 0}};
+    while (poll(fds, 2, -1) < 0 && errno == EINTR) {
+    }
+
+    uint64_t count;
+    if (fds[0].revents & POLLIN) {
+      read(wake_fd_, &count, sizeof(count));
+      return;  // new jobs may be due before _deadline
+    }
+    if (fds[1].revents & POLLIN)
+      read(timer_fd_, &count, sizeof(count));
+  }
+
+  while (clock::now() < _deadline)
+    std::this_thread::yield();
+}
+
 void display::jobs_loop() {
   time_point next = next_job_time_point();
-  if (next == time_point::max()) {
-    std::unique_lock<std::mutex> lk(cv_mutex_);
-    cv_.wait(lk);
-  } else if (next != time_point::min()) {
-    std::unique_lock<std::mutex> lk(cv_mutex_);
-    std::chrono::duration<double, std::milli> wait = next - display::clock::now();
-    cv_.wait_until(lk, next);
-  }
+  if (next != time_point::min())
+    wait_until(next);
 
+  HUT_TRACE_ZONE("jobs", "jobs_loop");
   const time_point now = display::clock::now();
   tick_overridable(now);
   tick_posted(now);
   tick_delayed(now);
-  std::chrono::duration<double, std::milli> duration = display::clock::now() - now;
-  // if (duration > std::chrono::milliseconds(16))
-  // std::cout << "Jobs done in " << duration.count() << "ms" << std::endl;
+  jobs_durations_.push(std::chrono::duration<double, std::milli>(display::clock::now() - now).count());
 }
 
 struct score_t {
@@ -265,6 +331,7 @@ const std::vector<const char *> layers = {
 
 void display::init_vulkan_instance(const char *_app_name, uint32_t _app_version,
                                    std::vector<const char *> &extensions) {
+  app_name_ = _app_name;
   extensions.emplace_back(VK_KHR_SURFACE_EXTENSION_NAME);
 
   uint32_t extension_count;
@@ -275,6 +342,8 @@ void display::init_vulkan_instance(const char *_app_name, uint32_t _app_version,
   bool has_debug_ext = false;
   for (const auto &extension : available_extensions) {
     //std::cout << '\t' << extension.extensionName << std::endl;
+    if (strcmp(extension.extensionName, VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) == 0)
+      has_properties2_ = true;
 #ifndef NDEBUG
     if (strcmp(extension.extensionName, VK_EXT_DEBUG_REPORT_EXTENSION_NAME) == 0)
       has_debug_ext = true;
@@ -283,6 +352,8 @@ void display::init_vulkan_instance(const char *_app_name, uint32_t _app_version,
 
   if (has_debug_ext)
     extensions.emplace_back(VK_EXT_DEBUG_REPORT_EXTENSION_NAME);
+  if (has_properties2_)
+    extensions.emplace_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
 
   VkApplicationInfo appInfo = {};
   appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
@@ -367,13 +438,47 @@ void display::init_vulkan_device(VkSurfaceKHR _dummy) {
     queue_create_infos.emplace_back(queue_create_info);
   }
 
-  const std::vector<const char *> device_extensions = {
+  std::vector<const char *> device_extensions = {
       VK_KHR_SWAPCHAIN_EXTENSION_NAME,
   };
 
+  VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexing_features = {};
+  indexing_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+  bindless_ = detect_bindless(indexing_features);
+  if (bindless_) {
+    device_extensions.emplace_back(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+    device_extensions.emplace_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+  } else if (!device_features_.shaderSampledImageArrayDynamicIndexing) {
+    throw std::runtime_error("device doesn't support descriptor indexing nor dynamic indexing of sampled images!");
+  }
+  bool indirect_count = has_device_extension(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+  if (indirect_count)
+    device_extensions.emplace_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+  bool templates = has_device_extension(VK_KHR_DESCRIPTOR_UPDATE_TEMPLATE_EXTENSION_NAME);
+  if (templates)
+    device_extensions.emplace_back(VK_KHR_DESCRIPTOR_UPDATE_TEMPLATE_EXTENSION_NAME);
+  VkPhysicalDeviceExtendedDynamicState3FeaturesEXT dynamic_features = {};
+  dynamic_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT;
+  bool dynamic_blend = detect_dynamic_blend(dynamic_features);
+  if (dynamic_blend)
+    device_extensions.emplace_back(VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME);
+
   VkPhysicalDeviceFeatures device_features = {};
+  device_features.shaderSampledImageArrayDynamicIndexing = device_features_.shaderSampledImageArrayDynamicIndexing;
+  device_features.multiDrawIndirect = device_features_.multiDrawIndirect;
+  device_features.drawIndirectFirstInstance = device_features_.drawIndirectFirstInstance;
   VkDeviceCreateInfo device_info = {};
   device_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+  void *features_chain = nullptr;
+  if (dynamic_blend) {
+    dynamic_features.pNext = features_chain;
+    features_chain = &dynamic_features;
+  }
+  if (bindless_) {
+    indexing_features.pNext = features_chain;
+    features_chain = &indexing_features;
+  }
+  device_info.pNext = features_chain;
   device_info.pQueueCreateInfos = queue_create_infos.data();
   device_info.queueCreateInfoCount = (uint32_t)queue_create_infos.size();
   device_info.pEnabledFeatures = &device_features;
@@ -385,6 +490,20 @@ void display::init_vulkan_device(VkSurfaceKHR _dummy) {
   VkResult result = vkCreateDevice(pdevice_, &device_info, nullptr, &device_);
   if (result != VK_SUCCESS)
     throw std::runtime_error(sstream("Couldn't create a vulkan device, code: ") << result);
+  if (indirect_count)
+    draw_indirect_count_ = get_proc<PFN_vkCmdDrawIndexedIndirectCountKHR>("vkCmdDrawIndexedIndirectCountKHR");
+  if (templates) {
+    create_template_ = get_proc<PFN_vkCreateDescriptorUpdateTemplate>("vkCreateDescriptorUpdateTemplateKHR");
+    destroy_template_ = get_proc<PFN_vkDestroyDescriptorUpdateTemplate>("vkDestroyDescriptorUpdateTemplateKHR");
+    update_with_template_ =
+        get_proc<PFN_vkUpdateDescriptorSetWithTemplate>("vkUpdateDescriptorSetWithTemplateKHR");
+  }
+  if (dynamic_blend) {
+    set_blend_enable_ = get_proc<PFN_vkCmdSetColorBlendEnableEXT>("vkCmdSetColorBlendEnableEXT");
+    set_blend_equation_ = get_proc<PFN_vkCmdSetColorBlendEquationEXT>("vkCmdSetColorBlendEquationEXT");
+  }
+
+  init_pipeline_cache();
 
   vkGetDeviceQueue(device_, prefered_rate.iqueueg_, 0, &queueg_);
   vkGetDeviceQueue(device_, prefered_rate.iqueuec_, 0, &queuec_);
@@ -400,30 +519,296 @@ void display::init_vulkan_device(VkSurfaceKHR _dummy) {
     throw std::runtime_error("failed to create command pool!");
   }
 
+  record_pools_.resize(recorders_.size());
+  for (auto &pool : record_pools_) {
+    if (vkCreateCommandPool(device_, &poolInfo, nullptr, &pool) != VK_SUCCESS)
+      throw std::runtime_error("failed to create recording command pool!");
+  }
+
   staging_ = std::make_shared<buffer>(*this, 8 * 1024,
                                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
                                       VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
 
-  VkCommandBufferAllocateInfo allocInfo = {};
-  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-  allocInfo.commandPool = commandg_pool_;
-  allocInfo.commandBufferCount = 1;
+  begin_staging();
+  init_textures();
+  init_globals_layout();
+}
 
-  vkAllocateCommandBuffers(device_, &allocInfo, &staging_cb_);
+bool display::has_device_extension(const char *_name) {
+  uint32_t extension_count;
+  vkEnumerateDeviceExtensionProperties(pdevice_, nullptr, &extension_count, nullptr);
+  std::vector<VkExtensionProperties> extensions(extension_count);
+  vkEnumerateDeviceExtensionProperties(pdevice_, nullptr, &extension_count, extensions.data());
+  return std::any_of(extensions.begin(), extensions.end(),
+                     [_name](const VkExtensionProperties &_ext) { return strcmp(_ext.extensionName, _name) == 0; });
+}
 
-  VkCommandBufferBeginInfo beginInfo = {};
-  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+bool display::detect_dynamic_blend(VkPhysicalDeviceExtendedDynamicState3FeaturesEXT &_features) {
+  if (!has_properties2_ || !has_device_extension(VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME))
+    return false;
+
+  VkPhysicalDeviceFeatures2 features = {};
+  features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+  features.pNext = &_features;
+  get_proc<PFN_vkGetPhysicalDeviceFeatures2KHR>("vkGetPhysicalDeviceFeatures2KHR")(pdevice_, &features);
+  if (!_features.extendedDynamicState3ColorBlendEnable || !_features.extendedDynamicState3ColorBlendEquation)
+    return false;
+
+  // only enable what the drawables use
+  _features = {};
+  _features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT;
+  _features.extendedDynamicState3ColorBlendEnable = VK_TRUE;
+  _features.extendedDynamicState3ColorBlendEquation = VK_TRUE;
+  return true;
+}
 
-  vkBeginCommandBuffer(staging_cb_, &beginInfo);
+bool display::detect_bindless(VkPhysicalDeviceDescriptorIndexingFeaturesEXT &_features) {
+  if (!has_properties2_ || !has_device_extension(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME)
+      || !has_device_extension(VK_KHR_MAINTENANCE3_EXTENSION_NAME))
+    return false;
+
+  VkPhysicalDeviceFeatures2 features = {};
+  features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+  features.pNext = &_features;
+  get_proc<PFN_vkGetPhysicalDeviceFeatures2KHR>("vkGetPhysicalDeviceFeatures2KHR")(pdevice_, &features);
+  if (!_features.shaderSampledImageArrayNonUniformIndexing || !_features.descriptorBindingSampledImageUpdateAfterBind
+      || !_features.descriptorBindingUpdateUnusedWhilePending || !_features.descriptorBindingPartiallyBound)
+    return false;
+
+  VkPhysicalDeviceDescriptorIndexingPropertiesEXT indexing_props = {};
+  indexing_props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+  VkPhysicalDeviceProperties2 props = {};
+  props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+  props.pNext = &indexing_props;
+  get_proc<PFN_vkGetPhysicalDeviceProperties2KHR>("vkGetPhysicalDeviceProperties2KHR")(pdevice_, &props);
+  texture_slots_ = std::min({indexing_props.maxPerStageDescriptorUpdateAfterBindSampledImages,
+                             indexing_props.maxPerStageDescriptorUpdateAfterBindSamplers,
+                             indexing_props.maxDescriptorSetUpdateAfterBindSampledImages, max_texture_slots_});
+
+  // only enable what the texture table uses
+  _features = {};
+  _features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+  _features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+  _features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+  _features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+  _features.descriptorBindingPartiallyBound = VK_TRUE;
+  return true;
+}
+
+void display::init_textures() {
+  if (!bindless_) {
+    const auto &limits = device_props_.limits;
+    uint32_t per_stage = std::min(limits.maxPerStageDescriptorSamplers, limits.maxPerStageDescriptorSampledImages);
+    texture_slots_ = std::min(per_stage - std::min(per_stage - 1, reserved_texture_slots_), fallback_texture_slots_);
+  }
+
+  VkDescriptorSetLayoutBinding binding = {};
+  binding.binding = 0;
+  binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  binding.descriptorCount = texture_slots_;
+  binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+  VkDescriptorBindingFlagsEXT binding_flags = VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT
+                                              | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT
+                                              | VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT;
+  VkDescriptorSetLayoutBindingFlagsCreateInfoEXT flags_info = {};
+  flags_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+  flags_info.bindingCount = 1;
+  flags_info.pBindingFlags = &binding_flags;
+
+  VkDescriptorSetLayoutCreateInfo layout_info = {};
+  layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layout_info.pNext = bindless_ ? &flags_info : nullptr;
+  layout_info.flags = bindless_ ? VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT : 0;
+  layout_info.bindingCount = 1;
+  layout_info.pBindings = &binding;
+
+  if (vkCreateDescriptorSetLayout(device_, &layout_info, nullptr, &textures_layout_) != VK_SUCCESS)
+    throw std::runtime_error("failed to create textures descriptor set layout!");
+
+  VkDescriptorPoolSize pool_size = {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, texture_slots_};
+  VkDescriptorPoolCreateInfo pool_info = {};
+  pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  pool_info.flags = bindless_ ? VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT : 0;
+  pool_info.poolSizeCount = 1;
+  pool_info.pPoolSizes = &pool_size;
+  pool_info.maxSets = 1;
+
+  if (vkCreateDescriptorPool(device_, &pool_info, nullptr, &textures_pool_) != VK_SUCCESS)
+    throw std::runtime_error("failed to create textures descriptor pool!");
+
+  VkDescriptorSetAllocateInfo alloc_info = {};
+  alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  alloc_info.descriptorPool = textures_pool_;
+  alloc_info.descriptorSetCount = 1;
+  alloc_info.pSetLayouts = &textures_layout_;
+
+  if (vkAllocateDescriptorSets(device_, &alloc_info, &textures_) != VK_SUCCESS)
+    throw std::runtime_error("failed to allocate textures descriptor set!");
+
+  textures_sampler_ = std::make_unique<sampler>(*this);
+
+  // registers in slot 0, a fixed-size table must be fully written, every slot starts as white
+  const uint8_t texel[] = {0xFF, 0xFF, 0xFF, 0xFF};
+  white_ = image::load_raw(*this, texel, sizeof(texel), {1, 1}, VK_FORMAT_R8G8B8A8_UNORM);
+  if (!bindless_) {
+    std::vector<std::pair<uint32_t, VkImageView>> writes;
+    for (uint32_t slot = 0; slot < texture_slots_; slot++)
+      writes.emplace_back(slot, white_->view_);
+    write_textures(writes);
+  }
+}
+
+uint32_t display::register_texture(VkImageView _view) {
+  std::lock_guard<std::mutex> lock(textures_mutex_);
+  uint32_t slot;
+  if (next_slot_ < texture_slots_) {
+    slot = next_slot_++;
+  } else if (!free_slots_.empty()) {
+    // oldest released first, to leave frames still in flight time to stop using it
+    slot = free_slots_.front();
+    free_slots_.pop_front();
+  } else {
+    return image::no_slot;
+  }
+
+  if (bindless_)
+    write_textures({{slot, _view}});
+  else
+    queue_texture_write(slot, _view, nullptr);
+  return slot;
+}
+
+void display::queue_texture_write(uint32_t _slot, VkImageView _view, const std::function<void()> &_destroy) {
+  // textures_mutex_ must be held
+  pending_writes_.emplace_back(_slot, _view);
+  if (_destroy)
+    pending_destroys_.emplace_back(_destroy);
+  if (texture_writes_posted_)
+    return;
+  texture_writes_posted_ = true;
+
+  // a fixed-size table can't change while used by pending command buffers, that would invalidate them: the writes
+  // queued until the job runs share a single wait and re-record
+  post([this](auto) {
+    decltype(pending_writes_) writes;
+    decltype(pending_destroys_) destroys;
+    {
+      std::lock_guard<std::mutex> lock(textures_mutex_);
+      writes.swap(pending_writes_);
+      destroys.swap(pending_destroys_);
+      texture_writes_posted_ = false;
+    }
+    if (textures_ == VK_NULL_HANDLE)
+      return;  // destroy_vulkan already released them
+    vkDeviceWaitIdle(device_);
+    write_textures(writes);  // in order, a slot released then registered again ends with the new view
+    for (auto &destroy : destroys)
+      destroy();
+    invalidate_windows();
+  });
+}
+
+void display::release_texture(uint32_t _slot, const std::function<void()> &_destroy) {
+  if (_slot == image::no_slot || textures_ == VK_NULL_HANDLE) {
+    _destroy();
+    return;
+  }
+
+  if (bindless_) {
+    // Frames in flight may still sample the slot: the next staging batch is submitted on the graphics queue after
+    // them, once it's done both the image and the slot are free.
+    std::lock_guard<std::recursive_mutex> lock(staging_mutex_);
+    dirty_staging_ = true;
+    on_staged.once([this, _slot, _destroy] {
+      _destroy();
+      std::lock_guard<std::mutex> lock(textures_mutex_);
+      free_slots_.emplace_back(_slot);
+      return true;
+    });
+    return;
+  }
+
+  // not partially bound, the slot has to hold a valid image: the view is destroyed once replaced by white
+  std::lock_guard<std::mutex> lock(textures_mutex_);
+  queue_texture_write(_slot, white_->view_, _destroy);
+  free_slots_.emplace_back(_slot);  // writes are applied in order, registering it again overwrites the white
+}
+
+void display::write_textures(const std::vector<std::pair<uint32_t, VkImageView>> &_writes) {
+  std::vector<VkDescriptorImageInfo> infos(_writes.size());
+  std::vector<VkWriteDescriptorSet> writes(_writes.size());
+  for (size_t i = 0; i < _writes.size(); i++) {
+    infos[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    infos[i].imageView = _writes[i].second;
+    infos[i].sampler = textures_sampler_->sampler_;
+
+    writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writes[i].dstSet = textures_;
+    writes[i].dstBinding = 0;
+    writes[i].dstArrayElement = _writes[i].first;
+    writes[i].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    writes[i].descriptorCount = 1;
+    writes[i].pImageInfo = &infos[i];
+  }
+  vkUpdateDescriptorSets(device_, (uint32_t)writes.size(), writes.data(), 0, nullptr);
 }
 
 void display::destroy_vulkan() {
   vkDeviceWaitIdle(device_);
 
+  collect_staged(true);
+  on_staged.fire();  // the device is idle, what waited for a staging batch not submitted yet can be released
+  on_staged = event<>();
+  for (auto &spare : staged_spares_) {
+    vkFreeCommandBuffers(device_, commandg_pool_, 1, &spare.cb_);
+    vkDestroyFence(device_, spare.fence_, nullptr);
+  }
+  staged_spares_.clear();
+  if (staging_cb_ != VK_NULL_HANDLE) {
+    vkEndCommandBuffer(staging_cb_);
+    vkFreeCommandBuffers(device_, commandg_pool_, 1, &staging_cb_);
+  }
+  if (staging_fence_ != VK_NULL_HANDLE)
+    vkDestroyFence(device_, staging_fence_, nullptr);
+  quad_indices_.reset();
+  quad_list16_.reset();
+  quad_lists32_.clear();  // before their buffers
+  quad_buffers32_.clear();
+  indices_.reset();
+  VkDescriptorPool textures_pool = textures_pool_;
+  textures_ = VK_NULL_HANDLE;  // images don't release their slot anymore
+  {
+    std::lock_guard<std::mutex> lock(textures_mutex_);
+    pending_writes_.clear();
+    for (auto &destroy : pending_destroys_)  // the device is idle, no need to write the table first
+      destroy();
+    pending_destroys_.clear();
+  }
+  white_.reset();
+  textures_sampler_.reset();
+  if (textures_pool != VK_NULL_HANDLE)
+    vkDestroyDescriptorPool(device_, textures_pool, nullptr);
+  if (textures_layout_ != VK_NULL_HANDLE)
+    vkDestroyDescriptorSetLayout(device_, textures_layout_, nullptr);
   staging_.reset();
-  vkFreeCommandBuffers(device_, commandg_pool_, 1, &staging_cb_);
+
+  for (auto &renderpass : compatible_renderpasses_)
+    vkDestroyRenderPass(device_, renderpass.second, nullptr);
+
+  if (globals_pipeline_layout_ != VK_NULL_HANDLE)
+    vkDestroyPipelineLayout(device_, globals_pipeline_layout_, nullptr);
+  if (globals_layout_ != VK_NULL_HANDLE)
+    vkDestroyDescriptorSetLayout(device_, globals_layout_, nullptr);
+
+  if (pipeline_cache_ != VK_NULL_HANDLE) {
+    save_pipeline_cache();
+    vkDestroyPipelineCache(device_, pipeline_cache_, nullptr);
+  }
+
+  for (auto pool : record_pools_)
+    vkDestroyCommandPool(device_, pool, nullptr);
+  record_pools_.clear();
 
   if (commandg_pool_ != VK_NULL_HANDLE)
     vkDestroyCommandPool(device_, commandg_pool_, nullptr);
@@ -454,21 +839,57 @@ std::pair<uint32_t, VkMemoryPropertyFlags> display::find_memory_type(uint32_t ty
   throw std::runtime_error("failed to find suitable memory type!");
 }
 
+thread_local bool display::recording_thread_ = false;
+
 void display::check_thread() {
-  assert(std::this_thread::get_id() == dispatcher_ || dispatcher_ == std::thread::id());
+  assert(std::this_thread::get_id() == dispatcher_ || dispatcher_ == std::thread::id() || recording_thread_);
+}
+
+size_t display::recording_threads(uint8_t _requested) {
+  if (_requested != 0)
+    return _requested;
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+size_t display::pick_record_pool() {
+  // Pool 0 is recorded by the dispatcher itself, keep it for the windows root nodes.
+  if (record_pools_.size() < 2)
+    return 0;
+  return 1 + (next_record_pool_++ % (record_pools_.size() - 1));
+}
+
+void display::record_parallel(const thread_pool::task &_task) {
+  check_thread();
+  recorders_.parallel_for(record_pools_.size(), [this, &_task](size_t _pool) {
+    if (trace::enabled() && !recording_thread_)
+      trace::thread_name(std::this_thread::get_id() == dispatcher_ ? "dispatcher" : "recorder");
+    bool was_recording = recording_thread_;
+    recording_thread_ = true;
+    try {
+      _task(_pool);
+    } catch (...) {
+      recording_thread_ = was_recording;
+      throw;
+    }
+    recording_thread_ = was_recording;
+  });
 }
 
 void display::stage_copy(VkBuffer _dst, const VkBufferCopy *_info) {
+  std::lock_guard<std::recursive_mutex> lock(staging_mutex_);
   dirty_staging_ = true;
+  staging_ranges_.emplace_back((uint32_t)_info->srcOffset, (uint32_t)_info->size);
   vkCmdCopyBuffer(staging_cb_, staging_->buffer_, _dst, 1, _info);
 }
 
 void display::stage_copy(VkBuffer _src, VkBuffer _dst, const VkBufferCopy *_info) {
+  std::lock_guard<std::recursive_mutex> lock(staging_mutex_);
   dirty_staging_ = true;
   vkCmdCopyBuffer(staging_cb_, _src, _dst, 1, _info);
 }
 
 void display::stage_transition(VkImage _image, VkFormat _format, VkImageLayout _old_layout, VkImageLayout _new_layout) {
+  std::lock_guard<std::recursive_mutex> lock(staging_mutex_);
   dirty_staging_ = true;
 
   VkImageMemoryBarrier barrier = {};
@@ -496,6 +917,12 @@ void display::stage_transition(VkImage _image, VkFormat _format, VkImageLayout _
     barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
     srcStage = VK_PIPELINE_STAGE_HOST_BIT;
     dstStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+  } else if (_old_layout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL &&
+             _new_layout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
+    barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    srcStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    dstStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
   } else if (_old_layout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL &&
              _new_layout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
     barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
@@ -510,6 +937,7 @@ void display::stage_transition(VkImage _image, VkFormat _format, VkImageLayout _
 }
 
 void display::stage_copy(VkImage srcImage, VkImage dstImage, uint32_t width, uint32_t height) {
+  std::lock_guard<std::recursive_mutex> lock(staging_mutex_);
   dirty_staging_ = true;
 
   VkImageSubresourceLayers subResource = {};
@@ -531,10 +959,338 @@ void display::stage_copy(VkImage srcImage, VkImage dstImage, uint32_t width, uin
                  VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
 }
 
+void display::stage_copy(VkImage _dst, const VkBufferImageCopy *_info, uint32_t _staging_offset,
+                         uint32_t _staging_size) {
+  std::lock_guard<std::recursive_mutex> lock(staging_mutex_);
+  dirty_staging_ = true;
+  staging_ranges_.emplace_back(_staging_offset, _staging_size);
+  vkCmdCopyBufferToImage(staging_cb_, staging_->buffer_, _dst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, _info);
+}
+
+std::string display::pipeline_cache_path() {
+  std::string dir;
+  if (const char *xdg = getenv("XDG_CACHE_HOME"))
+    dir = xdg;
+  else if (const char *home = getenv("HOME"))
+    dir = std::string(home) + "/.cache";
+  else
+    return "";
+
+  std::string name = app_name_.empty() ? "hut" : app_name_;
+  std::replace(name.begin(), name.end(), '/', '_');
+  return dir + "/hut/" + name + ".pipelines";
+}
+
+bool display::pipeline_cache_compatible(const std::vector<char> &_data, const VkPhysicalDeviceProperties &_props) {
+  // VkPipelineCacheHeaderVersionOne, read field by field as it is only declared by recent headers
+  constexpr size_t header_size = 4 * sizeof(uint32_t) + VK_UUID_SIZE;
+  if (_data.size() < header_size)
+    return false;
+
+  uint32_t fields[4];  // headerSize, headerVersion, vendorID, deviceID
+  memcpy(fields, _data.data(), sizeof(fields));
+  return fields[0] >= header_size && fields[1] == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+         fields[2] == _props.vendorID && fields[3] == _props.deviceID &&
+         memcmp(_data.data() + sizeof(fields), _props.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+void display::init_pipeline_cache() {
+  std::vector<char> data;
+  std::string path = pipeline_cache_path();
+  if (!path.empty()) {
+    std::ifstream file(path, std::ios::binary);
+    data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+  }
+
+  // A stale or foreign cache is simply ignored, pipelines are then compiled from scratch and the file overwritten.
+  pipeline_cache_warm_ = pipeline_cache_compatible(data, device_props_);
+  if (!pipeline_cache_warm_)
+    data.clear();
+
+  VkPipelineCacheCreateInfo cacheInfo = {};
+  cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+  cacheInfo.initialDataSize = data.size();
+  cacheInfo.pInitialData = data.empty() ? nullptr : data.data();
+  if (vkCreatePipelineCache(device_, &cacheInfo, nullptr, &pipeline_cache_) != VK_SUCCESS) {
+    pipeline_cache_warm_ = false;
+    cacheInfo.initialDataSize = 0;
+    cacheInfo.pInitialData = nullptr;
+    if (vkCreatePipelineCache(device_, &cacheInfo, nullptr, &pipeline_cache_) != VK_SUCCESS)
+      throw std::runtime_error("failed to create pipeline cache!");
+  }
+}
+
+void display::save_pipeline_cache() {
+  std::string path = pipeline_cache_path();
+  if (path.empty())
+    return;
+
+  size_t size = 0;
+  if (vkGetPipelineCacheData(device_, pipeline_cache_, &size, nullptr) != VK_SUCCESS || size == 0)
+    return;
+  std::vector<char> data(size);
+  if (vkGetPipelineCacheData(device_, pipeline_cache_, &size, data.data()) != VK_SUCCESS)
+    return;
+
+  // Failing to persist the cache only costs startup time, don't throw from the destructor path.
+  std::string dir = path.substr(0, path.rfind('/'));
+  mkdir(dir.substr(0, dir.rfind('/')).c_str(), 0755);
+  mkdir(dir.c_str(), 0755);
+
+  // Write then rename, so that a concurrent run never reads a truncated cache.
+  std::string tmp = path + ".tmp" + std::to_string(getpid());
+  {
+    std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+    file.write(data.data(), size);
+    if (!file) {
+      std::remove(tmp.c_str());
+      return;
+    }
+  }
+  if (std::rename(tmp.c_str(), path.c_str()) != 0)
+    std::remove(tmp.c_str());
+}
+
+void display::init_globals_layout() {
+  VkDescriptorSetLayoutBinding binding = {};
+  binding.binding = 0;
+  binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+  binding.descriptorCount = 1;
+  binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+  VkDescriptorSetLayoutCreateInfo layout_info = {};
+  layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layout_info.bindingCount = 1;
+  layout_info.pBindings = &binding;
+
+  if (vkCreateDescriptorSetLayout(device_, &layout_info, nullptr, &globals_layout_) != VK_SUCCESS)
+    throw std::runtime_error("failed to create globals descriptor set layout!");
+
+  VkPipelineLayoutCreateInfo pipeline_layout_info = {};
+  VkDescriptorSetLayout set_layouts[] = {globals_layout_, textures_layout_};
+  pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipeline_layout_info.setLayoutCount = 2;
+  pipeline_layout_info.pSetLayouts = set_layouts;
+  pipeline_layout_info.pushConstantRangeCount = 1;
+  pipeline_layout_info.pPushConstantRanges = &draw_constants_range;
+
+  if (vkCreatePipelineLayout(device_, &pipeline_layout_info, nullptr, &globals_pipeline_layout_) != VK_SUCCESS)
+    throw std::runtime_error("failed to create globals pipeline layout!");
+}
+
+// drops the entries of registries whose objects were all released
+template <typename TMap>
+static void erase_expired(TMap &_map) {
+  for (auto it = _map.begin(); it != _map.end();)
+    it = it->second.expired() ? _map.erase(it) : std::next(it);
+}
+
+std::shared_ptr<shared_pipeline> display::get_pipeline(const pipeline_desc &_desc) {
+  std::lock_guard<std::mutex> lock(pipelines_mutex_);
+  erase_expired(pipelines_);
+  auto &entry = pipelines_[_desc];
+  auto result = entry.lock();
+  if (!result) {
+    result = std::make_shared<shared_pipeline>(*this, _desc);
+    entry = result;
+  }
+  return result;
+}
+
+std::shared_ptr<shader_module> display::get_shader(const uint8_t *_code, size_t _size) {
+  // called by shared_pipeline's constructor, so with pipelines_mutex_ already held
+  erase_expired(shaders_);
+  auto &entry = shaders_[spirv_code{_code, _size}];
+  auto result = entry.lock();
+  if (!result) {
+    result = std::make_shared<shader_module>(device_, _code, _size);
+    entry = result;
+  }
+  return result;
+}
+
+VkRenderPass display::compatible_renderpass(VkFormat _format) {
+  auto &result = compatible_renderpasses_[_format];
+  if (result == VK_NULL_HANDLE)
+    result = create_renderpass(_format);
+  return result;
+}
+
+VkRenderPass display::create_renderpass(VkFormat _format) {
+  VkAttachmentDescription colorAttachment = {};
+  colorAttachment.format = _format;
+  colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+  colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+  VkAttachmentReference colorAttachmentRef = {};
+  colorAttachmentRef.attachment = 0;
+  colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+  VkSubpassDescription subpass = {};
+  subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+
+  subpass.colorAttachmentCount = 1;
+  subpass.pColorAttachments = &colorAttachmentRef;
+
+  VkSubpassDependency dependency = {};
+  dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+  dependency.dstSubpass = 0;
+  dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+  dependency.srcAccessMask = 0;
+  dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+  dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+  VkRenderPassCreateInfo renderPassInfo = {};
+  renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+  renderPassInfo.attachmentCount = 1;
+  renderPassInfo.pAttachments = &colorAttachment;
+  renderPassInfo.subpassCount = 1;
+  renderPassInfo.pSubpasses = &subpass;
+  renderPassInfo.dependencyCount = 1;
+  renderPassInfo.pDependencies = &dependency;
+
+  VkRenderPass result;
+  if (vkCreateRenderPass(device_, &renderPassInfo, nullptr, &result) != VK_SUCCESS)
+    throw std::runtime_error("failed to create render pass!");
+  return result;
+}
+
+template <typename T>
+static shared_ref<T> build_quad_list(buffer &_buffer, uint32_t _quads) {
+  std::vector<T> indices(_quads * 6);
+  for (uint32_t i = 0; i < _quads; i++) {
+    const T corners[] = {0, 1, 2, 2, 3, 0};
+    for (uint32_t j = 0; j < 6; j++)
+      indices[i * 6 + j] = T(i * 4 + corners[j]);
+  }
+  auto result = _buffer.allocate<T>(indices.size());
+  result->set(indices);
+  return result;
+}
+
+// 16 bits indices address up to 16384 quads
+constexpr uint32_t max_quads16 = (std::numeric_limits<uint16_t>::max() + 1) / 4;
+
+void display::init_quad_indices() {
+  if (indices_)
+    return;
+
+  indices_ = std::make_shared<buffer>(*this, (6 + max_quads16 * 6) * sizeof(uint16_t),
+                                      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                      (VkBufferUsageFlagBits)(VK_BUFFER_USAGE_TRANSFER_DST_BIT
+                                                              | VK_BUFFER_USAGE_INDEX_BUFFER_BIT));
+  quad_indices_ = indices_->allocate<uint16_t>(6);
+  quad_indices_->set({0, 1, 2, 2, 3, 0});
+  quad_list16_ = build_quad_list<uint16_t>(*indices_, max_quads16);
+}
+
+const shared_ref<uint16_t> &display::quad_indices() {
+  std::lock_guard<std::mutex> lock(indices_mutex_);
+  init_quad_indices();
+  return quad_indices_;
+}
+
+shared_indices display::quad_list_indices(uint32_t _quads) {
+  std::lock_guard<std::mutex> lock(indices_mutex_);
+  init_quad_indices();
+  if (_quads <= max_quads16)
+    return quad_list16_;
+  if (!quad_lists32_.empty() && quad_lists32_.back()->count() >= _quads * 6)
+    return quad_lists32_.back();
+
+  // grows geometrically, in a new buffer as the ones of the previous lists may be bound by recorded command buffers
+  uint32_t capacity = max_quads16 * 2;
+  while (capacity < _quads)
+    capacity *= 2;
+  auto list_buffer = std::make_shared<buffer>(*this, capacity * 6 * sizeof(uint32_t),
+                                              VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                              (VkBufferUsageFlagBits)(VK_BUFFER_USAGE_TRANSFER_DST_BIT
+                                                                      | VK_BUFFER_USAGE_INDEX_BUFFER_BIT));
+  quad_lists32_.emplace_back(build_quad_list<uint32_t>(*list_buffer, capacity));
+  quad_buffers32_.emplace_back(std::move(list_buffer));
+  if (quad_lists32_.size() > 1)  // move the nodes to the new list, from the dispatcher as we may be recording
+    post([this](auto) { invalidate_windows(); });
+  return quad_lists32_.back();
+}
+
+const std::shared_ptr<image> &display::white() {
+  return white_;
+}
+
+void display::begin_staging() {
+  if (!staged_spares_.empty()) {
+    staging_cb_ = staged_spares_.back().cb_;
+    staging_fence_ = staged_spares_.back().fence_;
+    staged_spares_.pop_back();
+    vkResetFences(device_, 1, &staging_fence_);
+  } else {
+    VkCommandBufferAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandPool = commandg_pool_;
+    allocInfo.commandBufferCount = 1;
+
+    if (vkAllocateCommandBuffers(device_, &allocInfo, &staging_cb_) != VK_SUCCESS)
+      throw std::runtime_error("failed to allocate staging command buffer!");
+
+    VkFenceCreateInfo fenceInfo = {};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    if (vkCreateFence(device_, &fenceInfo, nullptr, &staging_fence_) != VK_SUCCESS)
+      throw std::runtime_error("failed to create staging fence!");
+  }
+
+  VkCommandBufferBeginInfo beginInfo = {};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+  vkBeginCommandBuffer(staging_cb_, &beginInfo);
+
+  // Transfers must not overwrite data that frames submitted earlier are still reading.
+  vkCmdPipelineBarrier(staging_cb_, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
+                       nullptr, 0, nullptr);
+}
+
+void display::collect_staged(bool _wait) {
+  HUT_TRACE_ZONE("upload", "collect_staged");
+  while (!staged_batches_.empty()) {
+    staged_batch &batch = staged_batches_.front();
+    if (_wait)
+      vkWaitForFences(device_, 1, &batch.fence_, VK_TRUE, std::numeric_limits<uint64_t>::max());
+    else if (vkGetFenceStatus(device_, batch.fence_) != VK_SUCCESS)
+      break;  // batches are submitted on the same queue, so they retire in order
+
+    for (const auto &range : batch.ranges_)
+      staging_->do_free(range.first, range.second);
+    batch.on_done_.fire();
+
+    staged_batch spare;
+    spare.cb_ = batch.cb_;
+    spare.fence_ = batch.fence_;
+    staged_spares_.emplace_back(std::move(spare));
+    staged_batches_.pop_front();
+  }
+}
+
 void display::flush_staged() {
+  HUT_TRACE_ZONE("upload", "flush_staged");
+  std::lock_guard<std::recursive_mutex> lock(staging_mutex_);
+  collect_staged(false);
+
   if (!dirty_staging_)
     return;
 
+  // Make the transfers visible to everything submitted after this batch on the queue.
+  VkMemoryBarrier barrier = {};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+  vkCmdPipelineBarrier(staging_cb_, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier,
+                       0, nullptr, 0, nullptr);
   vkEndCommandBuffer(staging_cb_);
 
   VkSubmitInfo submitInfo = {};
@@ -542,19 +1298,18 @@ void display::flush_staged() {
   submitInfo.commandBufferCount = 1;
   submitInfo.pCommandBuffers = &staging_cb_;
 
-  vkQueueSubmit(queueg_, 1, &submitInfo, VK_NULL_HANDLE);
-
-  staging_->clear_ranges();
-  dirty_staging_ = false;
-
-  vkQueueWaitIdle(queueg_);
+  if (vkQueueSubmit(queueg_, 1, &submitInfo, staging_fence_) != VK_SUCCESS)
+    throw std::runtime_error("failed to submit staging command buffer!");
 
-  on_staged.fire();
-  on_staged.clear();
+  staged_batch batch;
+  batch.cb_ = staging_cb_;
+  batch.fence_ = staging_fence_;
+  batch.ranges_.swap(staging_ranges_);
+  batch.on_done_ = on_staged;
+  staged_batches_.emplace_back(std::move(batch));
 
-  VkCommandBufferBeginInfo beginInfo = {};
-  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  on_staged = event<>();
+  dirty_staging_ = false;
 
-  vkBeginCommandBuffer(staging_cb_, &beginInfo);
+  begin_staging();
 }
@@ -0,0 +1,131 @@
+/*  _ _ _   _       _
+ * | |_| |_| |_ _ _| |_
+ * | | | . |   | | |  _|
+ * |_|_|___|_|_|___|_|
+ * Hobby graphics and GUI library under the MIT License (MIT)
+ *
+ * Copyright (c) 2014 Jean-Baptiste Lepesme github.com/jiboo/libhut
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <stdexcept>
+
+#include "hut/display.hpp"
+#include "hut/draw_list.hpp"
+
+using namespace hut;
+
+draw_list::draw_list(display &_display, uint32_t _capacity) : display_(_display), capacity_(_capacity) {
+  if (_capacity == 0)
+    throw std::runtime_error("draw list capacity must not be 0!");
+  buffer_ = std::make_shared<buffer>(
+      display_, _capacity * sizeof(command) + sizeof(uint32_t), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+      (VkBufferUsageFlagBits)(VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT));
+  commands_ = buffer_->allocate<command>(_capacity);
+  count_ = buffer_->allocate<uint32_t>();
+
+  std::vector<command> empty(_capacity, command{});
+  commands_->set(empty);
+  write_count();
+}
+
+uint32_t draw_list::add(const command &_command, bool _visible) {
+  if (slots_.size() == capacity_)
+    throw std::runtime_error("draw list is full!");
+  check(_command);
+
+  uint32_t id;
+  if (free_ids_.empty()) {
+    id = (uint32_t)entries_.size();
+    entries_.emplace_back();
+  } else {
+    id = free_ids_.back();
+    free_ids_.pop_back();
+  }
+  entries_[id] = {_command, (uint32_t)slots_.size(), _visible};
+  slots_.emplace_back(id);
+
+  write(entries_[id].slot_);
+  write_count();
+  return id;
+}
+
+void draw_list::update(uint32_t _id, const command &_command) {
+  check(_command);
+  entries_[_id].command_ = _command;
+  write(entries_[_id].slot_);
+}
+
+void draw_list::visible(uint32_t _id, bool _visible) {
+  if (entries_[_id].visible_ == _visible)
+    return;
+  entries_[_id].visible_ = _visible;
+  write(entries_[_id].slot_);
+}
+
+void draw_list::remove(uint32_t _id) {
+  // the last draw takes the slot of the removed one, keeping the used slots packed
+  uint32_t slot = entries_[_id].slot_;
+  uint32_t last = slots_.back();
+  slots_[slot] = last;
+  entries_[last].slot_ = slot;
+  slots_.pop_back();
+  free_ids_.emplace_back(_id);
+
+  if (slot != slots_.size())
+    write(slot);
+  command empty = {};
+  commands_->set((uint32_t)slots_.size(), &empty, 1);
+  write_count();
+}
+
+void draw_list::check(const command &_command) {
+  // a non-zero firstInstance in an indirect draw is undefined behavior without the feature
+  if (_command.firstInstance != 0 && !display_.draw_indirect_first_instance())
+    throw std::runtime_error("draw list command starts at an instance, but drawIndirectFirstInstance isn't supported!");
+}
+
+void draw_list::write(uint32_t _slot) {
+  const auto &entry = entries_[slots_[_slot]];
+  command written = entry.command_;
+  if (!entry.visible_)
+    written.instanceCount = 0;
+  commands_->set(_slot, &written, 1);
+}
+
+void draw_list::write_count() {
+  uint32_t count = (uint32_t)slots_.size();
+  count_->set(0, &count, 1);
+}
+
+void draw_list::record(recorder &_recorder) {
+  VkBuffer buffer = buffer_->buffer_;
+  if (display_.draw_indirect_count()) {
+    _recorder.draw_indexed_indirect_count(buffer, commands_->offset_, buffer, count_->offset_, capacity_,
+                                          sizeof(command));
+  } else if (display_.device_features_.multiDrawIndirect
+             && capacity_ <= display_.device_props_.limits.maxDrawIndirectCount) {
+    _recorder.draw_indexed_indirect(buffer, commands_->offset_, capacity_, sizeof(command));
+  } else {
+    for (uint32_t i = 0; i < capacity_; i++)
+      _recorder.draw_indexed_indirect(buffer, commands_->offset_ + i * sizeof(command), 1, sizeof(command));
+  }
+}
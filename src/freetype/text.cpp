@@ -0,0 +1,238 @@
+/*  _ _ _   _       _
+ * | |_| |_| |_ _ _| |_
+ * | | | . |   | | |  _|
+ * |_|_|___|_|_|___|_|
+ * Hobby graphics and GUI library under the MIT License (MIT)
+ *
+ * Copyright (c) 2014 Jean-Baptiste Lepesme github.com/jiboo/libhut
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <atomic>
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "hut/text.hpp"
+#include "hut/trace.hpp"
+
+using namespace hut;
+
+font::font(const uint8_t *_data, size_t _size, uint32_t _face_index) {
+  static std::atomic<uint32_t> next_id{0};
+  id_ = next_id++;
+
+  if (FT_Init_FreeType(&library_) != 0)
+    throw std::runtime_error("failed to initialize FreeType!");
+  if (FT_New_Memory_Face(library_, _data, (FT_Long)_size, (FT_Long)_face_index, &face_) != 0) {
+    FT_Done_FreeType(library_);
+    throw std::runtime_error("failed to load font!");
+  }
+}
+
+font::~font() {
+  FT_Done_Face(face_);
+  FT_Done_FreeType(library_);
+}
+
+float font::line_height(uint32_t _size) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  pixel_size(_size);
+  return face_->size->metrics.height / 64.f;
+}
+
+void font::pixel_size(uint32_t _size) {
+  if (size_ == _size)
+    return;
+  if (FT_Set_Pixel_Sizes(face_, 0, _size) != 0)
+    throw std::runtime_error("unsupported font size!");
+  size_ = _size;
+}
+
+uint32_t font::index(char32_t _code_point) {
+  return FT_Get_Char_Index(face_, _code_point);
+}
+
+float font::kerning(uint32_t _left, uint32_t _right, uint32_t _size) {
+  if (_left == 0 || !FT_HAS_KERNING(face_))
+    return 0;
+  pixel_size(_size);
+  FT_Vector delta;
+  if (FT_Get_Kerning(face_, _left, _right, FT_KERNING_DEFAULT, &delta) != 0)
+    return 0;
+  return delta.x / 64.f;
+}
+
+glyph_atlas::glyph_atlas(display &_display, glm::uvec2 _page_size) : display_(_display), page_size_(_page_size) {
+}
+
+const glyph_atlas::glyph &glyph_atlas::get(font &_font, uint32_t _size, uint32_t _index) {
+  uint64_t key = (uint64_t(_font.id_) << 48) | (uint64_t(_size & 0xFFFF) << 32) | _index;
+  auto it = glyphs_.find(key);
+  if (it != glyphs_.end())
+    return it->second;
+
+  HUT_TRACE_ZONE("text", "rasterize glyph");
+  _font.pixel_size(_size);
+  if (FT_Load_Glyph(_font.face_, _index, FT_LOAD_RENDER | FT_LOAD_TARGET_NORMAL) != 0)
+    throw std::runtime_error("failed to rasterize glyph!");
+
+  FT_GlyphSlot slot = _font.face_->glyph;
+  const FT_Bitmap &bitmap = slot->bitmap;
+  glyph result = {};
+  result.offset = {slot->bitmap_left, -slot->bitmap_top};
+  result.size = {bitmap.width, bitmap.rows};
+  result.advance = slot->advance.x / 64.f;
+
+  if (bitmap.width != 0 && bitmap.rows != 0) {
+    if (bitmap.pixel_mode != FT_PIXEL_MODE_GRAY)
+      throw std::runtime_error("unsupported glyph bitmap!");
+
+    glm::uvec2 size{bitmap.width, bitmap.rows}, pos;
+    page &target = place(size, pos);
+    target.image_->update(pos, size, bitmap.buffer, (size_t)bitmap.pitch);
+
+    glm::vec2 page_size = page_size_;
+    result.texcoords = {glm::vec2(pos) / page_size, glm::vec2(pos + size) / page_size};
+    result.texture = target.image_->slot();
+  }
+
+  return glyphs_.emplace(key, result).first->second;
+}
+
+glyph_atlas::page &glyph_atlas::place(glm::uvec2 _size, glm::uvec2 &_pos) {
+  if (_size.x + padding_ > page_size_.x || _size.y + padding_ > page_size_.y)
+    throw std::runtime_error("glyph doesn't fit in an atlas page!");
+
+  if (!pages_.empty()) {
+    page &last = pages_.back();
+    if (last.x_ + _size.x + padding_ > page_size_.x) {  // next shelf
+      last.y_ += last.shelf_height_;
+      last.x_ = 0;
+      last.shelf_height_ = 0;
+    }
+  }
+
+  if (pages_.empty() || pages_.back().y_ + _size.y + padding_ > page_size_.y) {
+    std::vector<uint8_t> blank(page_size_.x * page_size_.y, 0);
+    page added;
+    added.image_ = image::load_raw(display_, blank.data(), page_size_.x, page_size_, VK_FORMAT_R8_UNORM,
+                                   {VK_COMPONENT_SWIZZLE_ONE, VK_COMPONENT_SWIZZLE_ONE, VK_COMPONENT_SWIZZLE_ONE,
+                                    VK_COMPONENT_SWIZZLE_R});
+    pages_.emplace_back(std::move(added));
+  }
+
+  page &result = pages_.back();
+  _pos = {result.x_, result.y_};
+  result.x_ += _size.x + padding_;
+  result.shelf_height_ = std::max(result.shelf_height_, _size.y + padding_);
+  return result;
+}
+
+text::text(window &_window, size_t _cache_size, glm::uvec2 _page_size)
+    : window_(_window), drawable_(_window), atlas_(_window.display_, _page_size), runs_(_cache_size) {
+}
+
+std::shared_ptr<const text_run> text::shape(font &_font, uint32_t _size, const glm::vec4 &_color,
+                                            const std::string &_string) {
+  std::string key;
+  key.append((const char *)&_font.id_, sizeof(_font.id_));
+  key.append((const char *)&_size, sizeof(_size));
+  key.append((const char *)&_color, sizeof(_color));
+  key += _string;
+
+  std::lock_guard<std::recursive_mutex> lock(*mutex_);
+  if (auto *cached = runs_.find(key))
+    return *cached;
+
+  HUT_TRACE_ZONE("text", "shape");
+  float line_height = _font.line_height(_size);
+  std::lock_guard<std::mutex> font_lock(_font.mutex_);
+  size_t glyphs = atlas_.size();
+  std::vector<rect_instance> instances;
+  std::shared_ptr<text_run> run(new text_run(), [mutex = mutex_](text_run *_run) {
+    std::lock_guard<std::recursive_mutex> lock(*mutex);
+    delete _run;
+  });
+  glm::vec2 pen{0, 0};
+  uint32_t previous = 0;
+
+  for (char32_t code_point : to_utf32(_string)) {
+    if (code_point == U'\n') {
+      pen = {0, pen.y + line_height};
+      previous = 0;
+      continue;
+    }
+
+    uint32_t index = _font.index(code_point);
+    pen.x += _font.kerning(previous, index, _size);
+    const auto &glyph = atlas_.get(_font, _size, index);
+    if (glyph.size.x != 0) {
+      rect_instance instance;
+      instance.pos = glm::round(pen) + glyph.offset;
+      instance.size = glyph.size;
+      instance.color = _color;
+      instance.texcoords = glyph.texcoords;
+      instance.texture = glyph.texture;
+      instances.emplace_back(instance);
+    }
+    pen.x += glyph.advance;
+    run->extent_.x = std::max(run->extent_.x, pen.x);
+    previous = index;
+  }
+  run->extent_.y = pen.y + line_height;
+
+  if (!instances.empty()) {
+    auto count = (uint32_t)instances.size();
+    for (auto &chunk : chunks_) {
+      run->instances_ = chunk->try_allocate<rect_instance>(count);
+      if (run->instances_) {
+        run->chunk_ = chunk;
+        break;
+      }
+    }
+    if (!run->instances_) {
+      run->chunk_ = std::make_shared<buffer>(
+          window_.display_, std::max<uint32_t>(chunk_size_, count * sizeof(rect_instance)),
+          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+      chunks_.emplace_back(run->chunk_);
+      run->instances_ = run->chunk_->try_allocate<rect_instance>(count);
+    }
+    run->instances_->set(instances);
+  }
+
+  // glyph masks are staged with the next frame, this one may miss them
+  if (atlas_.size() != glyphs) {
+    window &target = window_;
+    window_.display_.post([&target](auto) { target.invalidate(false); });
+  }
+  return runs_.insert(key, run);
+}
+
+void text::draw(recorder &_recorder, const glm::uvec2 &_size, const std::shared_ptr<const text_run> &_run,
+                glm::vec2 _pos) {
+  if (!_run->instances_)
+    return;
+  _recorder.descriptors().keep(_run);  // its instances may be evicted and reallocated while the recording is in use
+  drawable_.draw(_recorder, _size, _run->instances_, {glm::translate(glm::mat4(1), {glm::round(_pos), 0})});
+}
@@ -48,7 +48,8 @@ int main(int argc, char **argv) {
     auto found_size = input.tellg();
     auto written = 0;
 
-    output << "const std::array<uint8_t, " << dec << input.tellg() << "> " << symbol << " = {\n";
+    // inline, a single copy shared by the translation units including it
+    output << "inline const std::array<uint8_t, " << dec << input.tellg() << "> " << symbol << " = {\n";
     input.seekg(0);
     while (!input.eof()) {
       uint8_t line[line_size];
@@ -0,0 +1,84 @@
+/*  _ _ _   _       _
+ * | |_| |_| |_ _ _| |_
+ * | | | . |   | | |  _|
+ * |_|_|___|_|_|___|_|
+ * Hobby graphics and GUI library under the MIT License (MIT)
+ *
+ * Copyright (c) 2014 Jean-Baptiste Lepesme github.com/jiboo/libhut
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <thread>
+
+#include "hut/display.hpp"
+#include "hut/trace.hpp"
+#include "hut/window.hpp"
+
+using namespace hut;
+
+display::display(const char *_app_name, uint32_t _app_version, const char * /*_name*/, uint8_t _recording_threads)
+    : recorders_(recording_threads(_recording_threads) - 1),
+      compilers_(std::max(1u, std::thread::hardware_concurrency() / 2)) {
+  init_jobs_loop();
+
+  std::vector<const char *> extensions = {VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME};
+  init_vulkan_instance(_app_name, _app_version, extensions);
+
+  VkHeadlessSurfaceCreateInfoEXT info = {};
+  info.sType = VK_STRUCTURE_TYPE_HEADLESS_SURFACE_CREATE_INFO_EXT;
+
+  auto func = get_proc<PFN_vkCreateHeadlessSurfaceEXT>("vkCreateHeadlessSurfaceEXT");
+  VkSurfaceKHR dummy_surface;
+  VkResult vkr;
+  if ((vkr = func(instance_, &info, nullptr, &dummy_surface)) != VK_SUCCESS)
+    throw std::runtime_error(sstream("couldn't create dummy surface, code: ") << vkr);
+
+  init_vulkan_device(dummy_surface);
+
+  vkDestroySurfaceKHR(instance_, dummy_surface, nullptr);
+}
+
+display::~display() {
+  destroy_vulkan();
+  destroy_jobs_loop();
+}
+
+void display::flush() {
+}
+
+void display::invalidate_windows() {
+  for (auto *win : windows_)
+    win->invalidate(true);
+}
+
+int display::dispatch() {
+  if (windows_.empty())
+    throw std::runtime_error("dispatch called without any window");
+
+  dispatcher_ = std::this_thread::get_id();
+  trace::thread_name("dispatcher");
+
+  // Nothing comes from outside, windows are redrawn when invalidated and the loop ends with the last one.
+  while (!windows_.empty()) {
+    jobs_loop();
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,107 @@
+/*  _ _ _   _       _
+ * | |_| |_| |_ _ _| |_
+ * | | | . |   | | |  _|
+ * |_|_|___|_|_|___|_|
+ * Hobby graphics and GUI library under the MIT License (MIT)
+ *
+ * Copyright (c) 2014 Jean-Baptiste Lepesme github.com/jiboo/libhut
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+
+#include "hut/display.hpp"
+#include "hut/window.hpp"
+
+using namespace hut;
+
+bool window::is_keypad_key(char32_t) {
+  return false;
+}
+bool window::is_cursor_key(char32_t) {
+  return false;
+}
+bool window::is_function_key(char32_t) {
+  return false;
+}
+bool window::is_modifier_key(char32_t) {
+  return false;
+}
+
+window::window(display &_display) : display_(_display), size_(800, 600) {
+  VkHeadlessSurfaceCreateInfoEXT info = {};
+  info.sType = VK_STRUCTURE_TYPE_HEADLESS_SURFACE_CREATE_INFO_EXT;
+
+  auto func = display_.get_proc<PFN_vkCreateHeadlessSurfaceEXT>("vkCreateHeadlessSurfaceEXT");
+  VkResult result;
+  if ((result = func(_display.instance_, &info, nullptr, &surface_)) != VK_SUCCESS)
+    throw std::runtime_error(sstream("failed to create window surface, code: ") << result);
+
+  _display.windows_.emplace_back(this);
+
+  init_vulkan_surface();
+}
+
+void window::close() {
+  destroy_vulkan();
+  auto &windows = display_.windows_;
+  windows.erase(std::remove(windows.begin(), windows.end(), this), windows.end());
+  display_.wakeup();  // dispatch returns once the last window is closed
+}
+
+void window::visible(bool _visible) {
+  if (_visible == visible_)
+    return;
+  visible_ = _visible;
+
+  if (_visible) {
+    display_.post([this](auto) { on_resume.fire(); });
+    invalidate(true);
+  } else {
+    display_.post([this](auto) { on_pause.fire(); });
+  }
+}
+
+keysym window::map_key(char32_t c) {
+  return (keysym)c;
+}
+
+std::string window::name_key(char32_t c) {
+  return to_utf8(c);
+}
+
+void window::title(const std::string &) {
+}
+
+void window::invalidate(const glm::uvec4 &_coords, bool _redraw) {
+  if (_redraw) {
+    for (auto *node : nodes_)
+      std::fill(node->dirty_.begin(), node->dirty_.end(), true);
+  }
+  // There is no server to send an expose event through, schedule the redraw directly.
+  display_.post_overridable(
+      [this, _coords](auto tp) {
+        if (swapchain_ == VK_NULL_HANDLE)
+          return;
+        on_expose.fire(_coords);
+        redraw(tp);
+      },
+      (size_t)this);
+}
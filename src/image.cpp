@@ -25,6 +25,7 @@
  * SOFTWARE.
  */
 
+#include <cassert>
 #include <cstring>
 
 #include <algorithm>
@@ -34,6 +35,7 @@
 
 #include "hut/display.hpp"
 #include "hut/image.hpp"
+#include "hut/trace.hpp"
 
 using namespace hut;
 
@@ -50,6 +52,7 @@ void png_mem_read(png_structp _png_ptr, png_bytep _target, png_size_t _size) {
 }
 
 std::shared_ptr<image> image::load_png(display &_display, const uint8_t *_data, size_t _size) {
+  HUT_TRACE_ZONE("upload", "load_png");
   if (png_sig_cmp((png_bytep)_data, 0, 8))
     throw std::runtime_error("load_png: invalid data, can't validate PNG signature");
 
@@ -155,19 +158,53 @@ std::shared_ptr<image> image::load_png(display &_display, const uint8_t *_data,
   return std::make_shared<image>(_display, glm::uvec2{width, height}, format, stagingImage, stagingImageMemory);
 }
 
+std::shared_ptr<image> image::load_raw(display &_display, const uint8_t *_data, size_t _row_pitch, glm::uvec2 _size,
+                                      VkFormat _format, VkComponentMapping _swizzle) {
+  HUT_TRACE_ZONE("upload", "load_raw");
+  VkImage stagingImage;
+  VkDeviceMemory stagingImageMemory;
+  auto byte_size = create(_display, _size.x, _size.y, _format, VK_IMAGE_TILING_LINEAR, VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingImage,
+                          &stagingImageMemory);
+
+  VkImageSubresource subresource = {};
+  subresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+
+  VkSubresourceLayout stagingImageLayout;
+  vkGetImageSubresourceLayout(_display.device_, stagingImage, &subresource, &stagingImageLayout);
+
+  void *data;
+  vkMapMemory(_display.device_, stagingImageMemory, 0, byte_size, 0, &data);
+  auto dataBytes = reinterpret_cast<uint8_t *>(data);
+  size_t row_size = std::min<size_t>(_row_pitch, stagingImageLayout.rowPitch);
+  for (uint32_t y = 0; y < _size.y; y++)
+    memcpy(dataBytes + stagingImageLayout.offset + y * stagingImageLayout.rowPitch, _data + y * _row_pitch, row_size);
+  vkUnmapMemory(_display.device_, stagingImageMemory);
+
+  return std::make_shared<image>(_display, _size, _format, stagingImage, stagingImageMemory, _swizzle);
+}
+
 image::~image() {
-  vkDestroyImageView(display_.device_, view_, nullptr);
-  vkFreeMemory(display_.device_, memory_, nullptr);
-  vkDestroyImage(display_.device_, image_, nullptr);
+  VkDevice device = display_.device_;
+  VkImageView view = view_;
+  VkDeviceMemory memory = memory_;
+  VkImage image = image_;
+  display_.release_texture(slot_, [device, view, memory, image] {
+    vkDestroyImageView(device, view, nullptr);
+    vkFreeMemory(device, memory, nullptr);
+    vkDestroyImage(device, image, nullptr);
+  });
 }
 
-image::image(display &_display, glm::uvec2 _size, VkFormat _format, VkImage _image, VkDeviceMemory _memory)
+image::image(display &_display, glm::uvec2 _size, VkFormat _format, VkImage _image, VkDeviceMemory _memory,
+             VkComponentMapping _swizzle)
     : display_(_display), size_(_size), format_(_format), image_(_image), memory_(_memory) {
   create(_display, _size.x, _size.y, _format, VK_IMAGE_TILING_LINEAR,
          VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &image_,
          &memory_);
 
   _display.post([&_display, _image, _memory, this](auto) {
+    HUT_TRACE_ZONE("upload", "stage image");
     _display.stage_transition(_image, format_, VK_IMAGE_LAYOUT_PREINITIALIZED, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
     _display.stage_transition(image_, format_, VK_IMAGE_LAYOUT_PREINITIALIZED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
     _display.stage_copy(_image, image_, size_.x, size_.y);
@@ -188,6 +225,7 @@ image::image(display &_display, glm::uvec2 _size, VkFormat _format, VkImage _ima
   viewInfo.image = image_;
   viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
   viewInfo.format = _format;
+  viewInfo.components = _swizzle;
   viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
   viewInfo.subresourceRange.baseMipLevel = 0;
   viewInfo.subresourceRange.levelCount = 1;
@@ -197,6 +235,59 @@ image::image(display &_display, glm::uvec2 _size, VkFormat _format, VkImage _ima
   if (vkCreateImageView(_display.device_, &viewInfo, nullptr, &view_) != VK_SUCCESS) {
     throw std::runtime_error("failed to create texture image view!");
   }
+
+  slot_ = _display.register_texture(view_);
+}
+
+void image::update(glm::uvec2 _offset, glm::uvec2 _size, const uint8_t *_data, size_t _row_pitch) {
+  HUT_TRACE_ZONE("upload", "image update");
+  assert(_offset.x + _size.x <= size_.x && _offset.y + _size.y <= size_.y);
+  if (_size.x == 0 || _size.y == 0)
+    return;
+
+  uint32_t row_size = _size.x * texel_size(format_);
+  uint32_t byte_size = row_size * _size.y;
+  std::lock_guard<std::recursive_mutex> lock(display_.staging_mutex_);  // may be called while recording
+  buffer::range_t staging = display_.staging_->do_alloc(byte_size, 4);  // copies to images need 4 bytes alignment
+
+  void *target;
+  vkMapMemory(display_.device_, display_.staging_->memory_, staging.offset_, byte_size, 0, &target);
+  for (uint32_t y = 0; y < _size.y; y++)
+    memcpy((uint8_t *)target + y * row_size, _data + y * _row_pitch, row_size);
+  vkUnmapMemory(display_.device_, display_.staging_->memory_);
+
+  VkBufferImageCopy copy = {};
+  copy.bufferOffset = staging.offset_;
+  copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  copy.imageSubresource.layerCount = 1;
+  copy.imageOffset = {(int32_t)_offset.x, (int32_t)_offset.y, 0};
+  copy.imageExtent = {_size.x, _size.y, 1};
+
+  display_.post([this, copy, staging](auto) {
+    display_.stage_transition(image_, format_, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                              VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+    display_.stage_copy(image_, &copy, staging.offset_, staging.size_);
+    display_.stage_transition(image_, format_, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                              VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+  });
+}
+
+uint32_t image::texel_size(VkFormat _format) {
+  switch (_format) {
+    case VK_FORMAT_R8_UNORM:
+      return 1;
+    case VK_FORMAT_R8G8_UNORM:
+    case VK_FORMAT_R16_UNORM:
+      return 2;
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_B8G8R8A8_UNORM:
+    case VK_FORMAT_R16G16_UNORM:
+      return 4;
+    case VK_FORMAT_R16G16B16A16_UNORM:
+      return 8;
+    default:
+      throw std::runtime_error("unsupported image format for updates!");
+  }
 }
 
 VkDeviceSize image::create(display &_display, uint32_t _width, uint32_t _height, VkFormat _format,
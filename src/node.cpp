@@ -0,0 +1,127 @@
+/*  _ _ _   _       _
+ * | |_| |_| |_ _ _| |_
+ * | | | . |   | | |  _|
+ * |_|_|___|_|_|___|_|
+ * Hobby graphics and GUI library under the MIT License (MIT)
+ *
+ * Copyright (c) 2014 Jean-Baptiste Lepesme github.com/jiboo/libhut
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <limits>
+
+#include "hut/display.hpp"
+#include "hut/node.hpp"
+#include "hut/trace.hpp"
+#include "hut/window.hpp"
+
+using namespace hut;
+
+node::node(window &_window)
+    : window_(_window), pool_(_window.root_ ? _window.display_.pick_record_pool() : 0) {  // null while building root_
+  window_.display_.check_thread();
+  window_.nodes_.emplace_back(this);
+  if (!window_.primary_cbs_.empty())
+    init_cbs(window_.primary_cbs_.size());
+  std::fill(window_.dirty_.begin(), window_.dirty_.end(), true);
+}
+
+node::~node() {
+  window_.display_.check_thread();
+  window_.nodes_.erase(std::find(window_.nodes_.begin(), window_.nodes_.end(), this));
+  std::fill(window_.dirty_.begin(), window_.dirty_.end(), true);
+
+  if (!cbs_.empty()) {
+    // Primary command buffers still in flight may execute ours.
+    for (auto &frame : window_.frames_)
+      vkWaitForFences(window_.display_.device_, 1, &frame.fence_, VK_TRUE, std::numeric_limits<uint64_t>::max());
+    destroy_cbs();
+  }
+}
+
+void node::invalidate() {
+  std::fill(dirty_.begin(), dirty_.end(), true);
+  window_.invalidate(false);
+}
+
+void node::init_cbs(size_t _images_count) {
+  std::fill(dirty_.begin(), dirty_.end(), true);
+  dirty_.resize(_images_count, true);
+
+  if (cbs_.size() == _images_count)
+    return;
+
+  destroy_cbs();
+  cbs_.resize(_images_count);
+  descriptors_.clear();
+  for (size_t i = 0; i < _images_count; i++)
+    descriptors_.emplace_back(std::make_unique<descriptor_cache>(window_.display_));
+
+  VkCommandBufferAllocateInfo allocInfo = {};
+  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+  allocInfo.commandBufferCount = (uint32_t)_images_count;
+  allocInfo.commandPool = window_.display_.record_pools_[pool_];
+
+  if (vkAllocateCommandBuffers(window_.display_.device_, &allocInfo, cbs_.data()) != VK_SUCCESS)
+    throw std::runtime_error("failed to allocate secondary command buffers!");
+}
+
+void node::destroy_cbs() {
+  if (!cbs_.empty())
+    vkFreeCommandBuffers(window_.display_.device_, window_.display_.record_pools_[pool_], (uint32_t)cbs_.size(),
+                         cbs_.data());
+  cbs_.clear();
+}
+
+bool node::record(uint32_t _image_index) {
+  window_.display_.check_thread();
+
+  if (!dirty_[_image_index])
+    return false;
+  dirty_[_image_index] = false;
+
+  HUT_TRACE_ZONE("draw", "record node");
+  VkCommandBufferInheritanceInfo inheritanceInfo = {};
+  inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+  inheritanceInfo.renderPass = window_.renderpass_;
+  inheritanceInfo.subpass = 0;
+  inheritanceInfo.framebuffer = window_.swapchain_fbos_[_image_index];
+
+  VkCommandBufferBeginInfo beginInfo = {};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+  beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+  VkCommandBuffer cb = cbs_[_image_index];
+  vkBeginCommandBuffer(cb, &beginInfo);
+  descriptors_[_image_index]->reset();  // the previous recording of this image isn't pending anymore
+  recorder rec(window_.display_, cb, _image_index, *descriptors_[_image_index]);
+  // secondary command buffers don't inherit bindings, the window's set 0 and the texture table are bound once here
+  VkDescriptorSet sets[] = {window_.globals_, window_.display_.textures_};
+  rec.bind_descriptor_sets(window_.display_.globals_pipeline_layout_, 0, 2, sets);
+  on_draw.fire(rec, window_.size_);
+  recorded_ = rec.stats();
+  if (vkEndCommandBuffer(cb) != VK_SUCCESS)
+    throw std::runtime_error("failed to record secondary command buffer!");
+
+  return true;
+}
@@ -0,0 +1,189 @@
+/*  _ _ _   _       _
+ * | |_| |_| |_ _ _| |_
+ * | | | . |   | | |  _|
+ * |_|_|___|_|_|___|_|
+ * Hobby graphics and GUI library under the MIT License (MIT)
+ *
+ * Copyright (c) 2014 Jean-Baptiste Lepesme github.com/jiboo/libhut
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__)
+#  include <emmintrin.h>
+#endif
+
+#include "hut/packed.hpp"
+
+using namespace hut;
+
+namespace {
+
+// NaN clamps to _lo, as the SSE min/max do
+inline float clamp(float _value, float _lo, float _hi) {
+  return _value > _lo ? (_value < _hi ? _value : _hi) : _lo;
+}
+
+inline int32_t quantize(float _value, float _lo, float _hi, float _scale) {
+  return (int32_t)std::nearbyint(clamp(_value, _lo, _hi) * _scale);
+}
+
+template <typename T>
+inline T &at(T *_base, size_t _stride, size_t _index) {
+  return *(T *)((uint8_t *)_base + _stride * _index);
+}
+
+uint16_t to_half(float _value) {
+  // round to nearest even, overflows to infinity, keeps NaNs
+  constexpr uint32_t f32_infinity = 255u << 23;
+  constexpr uint32_t f16_max = (127u + 16) << 23;
+  constexpr uint32_t denorm_magic = ((127u - 15) + (23 - 10) + 1) << 23;
+
+  uint32_t bits;
+  memcpy(&bits, &_value, sizeof(bits));
+  uint32_t sign = bits & 0x80000000u;
+  bits ^= sign;
+
+  uint16_t result;
+  if (bits >= f16_max) {
+    result = bits > f32_infinity ? 0x7e00 : 0x7c00;
+  } else if (bits < (113u << 23)) {
+    float magic, value;
+    memcpy(&magic, &denorm_magic, sizeof(magic));
+    memcpy(&value, &bits, sizeof(value));
+    value += magic;
+    memcpy(&bits, &value, sizeof(bits));
+    result = uint16_t(bits - denorm_magic);
+  } else {
+    uint32_t odd = (bits >> 13) & 1;
+    bits += ((uint32_t)(15 - 127) << 23) + 0xfff + odd;
+    result = uint16_t(bits >> 13);
+  }
+  return uint16_t(result | (sign >> 16));
+}
+
+#if defined(__SSE2__)
+// the four 32 bits lanes of _packed are four packed elements
+inline void store(__m128i _packed, void *_dst, size_t _stride) {
+  if (_stride == sizeof(uint32_t)) {
+    _mm_storeu_si128((__m128i *)_dst, _packed);
+    return;
+  }
+  auto *dst = (uint8_t *)_dst;
+  for (int i = 0; i < 4; i++, dst += _stride, _packed = _mm_srli_si128(_packed, 4)) {
+    auto lane = (uint32_t)_mm_cvtsi128_si32(_packed);
+    memcpy(dst, &lane, sizeof(lane));
+  }
+}
+
+inline __m128i quantize(__m128 _values, __m128 _lo, __m128 _hi, __m128 _scale) {
+  return _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(_values, _lo), _hi), _scale));
+}
+#endif
+
+}  // namespace
+
+void hut::pack(const glm::vec2 *_src, size_t _count, sint16x2 *_dst, size_t _stride) {
+  size_t i = 0;
+#if defined(__SSE2__)
+  const __m128 lo = _mm_set1_ps(-32768.f), hi = _mm_set1_ps(32767.f), one = _mm_set1_ps(1.f);
+  for (; i + 4 <= _count; i += 4) {
+    __m128i a = quantize(_mm_loadu_ps(&_src[i].x), lo, hi, one);
+    __m128i b = quantize(_mm_loadu_ps(&_src[i + 2].x), lo, hi, one);
+    store(_mm_packs_epi32(a, b), &at(_dst, _stride, i), _stride);
+  }
+#endif
+  for (; i < _count; i++) {
+    auto &dst = at(_dst, _stride, i);
+    dst.x = (int16_t)quantize(_src[i].x, -32768.f, 32767.f, 1.f);
+    dst.y = (int16_t)quantize(_src[i].y, -32768.f, 32767.f, 1.f);
+  }
+}
+
+void hut::pack(const glm::vec2 *_src, size_t _count, half2 *_dst, size_t _stride) {
+  for (size_t i = 0; i < _count; i++) {
+    auto &dst = at(_dst, _stride, i);
+    dst.x = to_half(_src[i].x);
+    dst.y = to_half(_src[i].y);
+  }
+}
+
+void hut::pack(const glm::vec3 *_src, size_t _count, unorm8x4 *_dst, size_t _stride) {
+  size_t i = 0;
+#if defined(__SSE2__)
+  const __m128 lo = _mm_setzero_ps(), hi = _mm_set1_ps(1.f), scale = _mm_set1_ps(255.f);
+  for (; i + 4 <= _count; i += 4) {
+    __m128i c[4];
+    for (int j = 0; j < 4; j++) {
+      const auto &src = _src[i + j];
+      c[j] = quantize(_mm_set_ps(1.f, src.z, src.y, src.x), lo, hi, scale);
+    }
+    store(_mm_packus_epi16(_mm_packs_epi32(c[0], c[1]), _mm_packs_epi32(c[2], c[3])), &at(_dst, _stride, i), _stride);
+  }
+#endif
+  for (; i < _count; i++) {
+    auto &dst = at(_dst, _stride, i);
+    dst.r = (uint8_t)quantize(_src[i].x, 0.f, 1.f, 255.f);
+    dst.g = (uint8_t)quantize(_src[i].y, 0.f, 1.f, 255.f);
+    dst.b = (uint8_t)quantize(_src[i].z, 0.f, 1.f, 255.f);
+    dst.a = 255;
+  }
+}
+
+void hut::pack(const glm::vec4 *_src, size_t _count, unorm8x4 *_dst, size_t _stride) {
+  size_t i = 0;
+#if defined(__SSE2__)
+  const __m128 lo = _mm_setzero_ps(), hi = _mm_set1_ps(1.f), scale = _mm_set1_ps(255.f);
+  for (; i + 4 <= _count; i += 4) {
+    __m128i c[4];
+    for (int j = 0; j < 4; j++)
+      c[j] = quantize(_mm_loadu_ps(&_src[i + j].x), lo, hi, scale);
+    store(_mm_packus_epi16(_mm_packs_epi32(c[0], c[1]), _mm_packs_epi32(c[2], c[3])), &at(_dst, _stride, i), _stride);
+  }
+#endif
+  for (; i < _count; i++) {
+    auto &dst = at(_dst, _stride, i);
+    dst.r = (uint8_t)quantize(_src[i].x, 0.f, 1.f, 255.f);
+    dst.g = (uint8_t)quantize(_src[i].y, 0.f, 1.f, 255.f);
+    dst.b = (uint8_t)quantize(_src[i].z, 0.f, 1.f, 255.f);
+    dst.a = (uint8_t)quantize(_src[i].w, 0.f, 1.f, 255.f);
+  }
+}
+
+void hut::pack(const glm::vec2 *_src, size_t _count, unorm16x2 *_dst, size_t _stride) {
+  size_t i = 0;
+#if defined(__SSE2__)
+  // SSE2 only packs with signed saturation: bias to the signed range, then flip the sign bits back
+  const __m128 lo = _mm_setzero_ps(), hi = _mm_set1_ps(1.f), scale = _mm_set1_ps(65535.f);
+  const __m128i bias32 = _mm_set1_epi32(32768), bias16 = _mm_set1_epi16(-32768);
+  for (; i + 4 <= _count; i += 4) {
+    __m128i a = _mm_sub_epi32(quantize(_mm_loadu_ps(&_src[i].x), lo, hi, scale), bias32);
+    __m128i b = _mm_sub_epi32(quantize(_mm_loadu_ps(&_src[i + 2].x), lo, hi, scale), bias32);
+    store(_mm_xor_si128(_mm_packs_epi32(a, b), bias16), &at(_dst, _stride, i), _stride);
+  }
+#endif
+  for (; i < _count; i++) {
+    auto &dst = at(_dst, _stride, i);
+    dst.x = (uint16_t)quantize(_src[i].x, 0.f, 1.f, 65535.f);
+    dst.y = (uint16_t)quantize(_src[i].y, 0.f, 1.f, 65535.f);
+  }
+}
@@ -0,0 +1,168 @@
+/*  _ _ _   _       _
+ * | |_| |_| |_ _ _| |_
+ * | | | . |   | | |  _|
+ * |_|_|___|_|_|___|_|
+ * Hobby graphics and GUI library under the MIT License (MIT)
+ *
+ * Copyright (c) 2014 Jean-Baptiste Lepesme github.com/jiboo/libhut
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <cassert>
+#include <cstring>
+
+#include "hut/display.hpp"
+#include "hut/recorder.hpp"
+
+using namespace hut;
+
+void recorder::reset() {
+  pipeline_ = VK_NULL_HANDLE;
+  sets_.fill({VK_NULL_HANDLE, VK_NULL_HANDLE});
+  constants_size_ = 0;
+  vertices_.fill({VK_NULL_HANDLE, 0});
+  indices_ = VK_NULL_HANDLE;
+  has_viewport_ = has_scissor_ = false;
+  has_blend_ = false;
+}
+
+void recorder::bind_pipeline(VkPipeline _pipeline) {
+  if (elide(_pipeline == pipeline_))
+    return;
+  vkCmdBindPipeline(buffer_, VK_PIPELINE_BIND_POINT_GRAPHICS, _pipeline);
+  pipeline_ = _pipeline;
+}
+
+void recorder::bind_descriptor_sets(VkPipelineLayout _layout, uint32_t _first, uint32_t _count,
+                                    const VkDescriptorSet *_sets) {
+  bool redundant = _first + _count <= max_sets_;
+  for (uint32_t i = 0; redundant && i < _count; i++)
+    redundant = sets_[_first + i] == std::make_pair(_layout, _sets[i]);
+  if (elide(redundant))
+    return;
+
+  vkCmdBindDescriptorSets(buffer_, VK_PIPELINE_BIND_POINT_GRAPHICS, _layout, _first, _count, _sets, 0, nullptr);
+  for (uint32_t i = _first; i < max_sets_; i++) {
+    if (i < _first + _count)
+      sets_[i] = {_layout, _sets[i - _first]};
+    else if (sets_[i].first != _layout)
+      sets_[i] = {VK_NULL_HANDLE, VK_NULL_HANDLE};  // may have been disturbed by an incompatible layout
+  }
+}
+
+void recorder::push_constants(VkPipelineLayout _layout, VkShaderStageFlags _stages, uint32_t _offset, uint32_t _size,
+                              const void *_data) {
+  bool redundant = _size <= max_constants_ && _stages == constants_stages_ && _offset == constants_offset_
+                   && _size == constants_size_ && memcmp(constants_.data(), _data, _size) == 0;
+  if (elide(redundant))
+    return;
+
+  vkCmdPushConstants(buffer_, _layout, _stages, _offset, _size, _data);
+  constants_stages_ = _stages;
+  constants_offset_ = _offset;
+  constants_size_ = _size <= max_constants_ ? _size : 0;
+  memcpy(constants_.data(), _data, constants_size_);
+}
+
+void recorder::bind_vertex_buffer(uint32_t _binding, VkBuffer _buffer, VkDeviceSize _offset) {
+  auto bound = std::make_pair(_buffer, _offset);
+  if (elide(_binding < max_vertex_bindings_ && vertices_[_binding] == bound))
+    return;
+
+  vkCmdBindVertexBuffers(buffer_, _binding, 1, &_buffer, &_offset);
+  if (_binding < max_vertex_bindings_)
+    vertices_[_binding] = bound;
+}
+
+void recorder::bind_index_buffer(VkBuffer _buffer, VkDeviceSize _offset, VkIndexType _type) {
+  if (elide(_buffer == indices_ && _offset == indices_offset_ && _type == index_type_))
+    return;
+
+  vkCmdBindIndexBuffer(buffer_, _buffer, _offset, _type);
+  indices_ = _buffer;
+  indices_offset_ = _offset;
+  index_type_ = _type;
+}
+
+void recorder::viewport(const VkViewport &_viewport) {
+  if (elide(has_viewport_ && memcmp(&_viewport, &viewport_, sizeof(VkViewport)) == 0))
+    return;
+
+  vkCmdSetViewport(buffer_, 0, 1, &_viewport);
+  viewport_ = _viewport;
+  has_viewport_ = true;
+}
+
+void recorder::scissor(const VkRect2D &_scissor) {
+  if (elide(has_scissor_ && memcmp(&_scissor, &scissor_, sizeof(VkRect2D)) == 0))
+    return;
+
+  vkCmdSetScissor(buffer_, 0, 1, &_scissor);
+  scissor_ = _scissor;
+  has_scissor_ = true;
+}
+
+void recorder::full_viewport(const glm::uvec2 &_size) {
+  VkRect2D scissor = {};
+  scissor.offset = {0, 0};
+  scissor.extent = {_size.x, _size.y};
+  this->scissor(scissor);
+
+  VkViewport viewport = {};
+  viewport.x = 0.0f;
+  viewport.y = 0.0f;
+  viewport.width = (float)_size.x;
+  viewport.height = (float)_size.y;
+  viewport.minDepth = 0.0f;
+  viewport.maxDepth = 1.0f;
+  this->viewport(viewport);
+}
+
+void recorder::blend(blend_mode _mode) {
+  if (!display_.dynamic_blend() || elide(has_blend_ && _mode == blend_))
+    return;
+
+  auto state = blend_attachment(_mode);
+  VkColorBlendEquationEXT equation = {state.srcColorBlendFactor, state.dstColorBlendFactor, state.colorBlendOp,
+                                      state.srcAlphaBlendFactor, state.dstAlphaBlendFactor, state.alphaBlendOp};
+  display_.set_blend_enable_(buffer_, 0, 1, &state.blendEnable);
+  display_.set_blend_equation_(buffer_, 0, 1, &equation);
+  blend_ = _mode;
+  has_blend_ = true;
+}
+
+void recorder::draw_indexed(uint32_t _index_count, uint32_t _instance_count, uint32_t _first_index,
+                            int32_t _vertex_offset, uint32_t _first_instance) {
+  stats_.issued++;
+  vkCmdDrawIndexed(buffer_, _index_count, _instance_count, _first_index, _vertex_offset, _first_instance);
+}
+
+void recorder::draw_indexed_indirect(VkBuffer _buffer, VkDeviceSize _offset, uint32_t _count, uint32_t _stride) {
+  stats_.issued++;
+  vkCmdDrawIndexedIndirect(buffer_, _buffer, _offset, _count, _stride);
+}
+
+void recorder::draw_indexed_indirect_count(VkBuffer _buffer, VkDeviceSize _offset, VkBuffer _count_buffer,
+                                           VkDeviceSize _count_offset, uint32_t _max_count, uint32_t _stride) {
+  assert(display_.draw_indirect_count_ != nullptr);
+  stats_.issued++;
+  display_.draw_indirect_count_(buffer_, _buffer, _offset, _count_buffer, _count_offset, _max_count, _stride);
+}
@@ -0,0 +1,318 @@
+/*  _ _ _   _       _
+ * | |_| |_| |_ _ _| |_
+ * | | | . |   | | |  _|
+ * |_|_|___|_|_|___|_|
+ * Hobby graphics and GUI library under the MIT License (MIT)
+ *
+ * Copyright (c) 2014 Jean-Baptiste Lepesme github.com/jiboo/libhut
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <cstring>
+#include <exception>
+
+#include "hut/display.hpp"
+#include "hut/shared_pipeline.hpp"
+#include "hut/trace.hpp"
+
+using namespace hut;
+
+namespace {
+
+// FNV-1a, the descriptions are plain Vulkan structs zero-initialized by their users
+size_t hash_bytes(size_t _seed, const void *_data, size_t _size) {
+  auto bytes = (const uint8_t *)_data;
+  for (size_t i = 0; i < _size; i++) {
+    _seed ^= bytes[i];
+    _seed *= 1099511628211ull;
+  }
+  return _seed;
+}
+
+template <typename T>
+size_t hash_vector(size_t _seed, const std::vector<T> &_vector) {
+  size_t size = _vector.size();
+  _seed = hash_bytes(_seed, &size, sizeof(size));
+  return hash_bytes(_seed, _vector.data(), _vector.size() * sizeof(T));
+}
+
+template <typename T>
+bool equal_vectors(const std::vector<T> &_a, const std::vector<T> &_b) {
+  return _a.size() == _b.size() && memcmp(_a.data(), _b.data(), _a.size() * sizeof(T)) == 0;
+}
+
+}  // namespace
+
+VkPipelineColorBlendAttachmentState hut::blend_attachment(blend_mode _mode) {
+  // source and destination factors of each mode, in blend_mode order
+  constexpr VkBlendFactor zero = VK_BLEND_FACTOR_ZERO, one = VK_BLEND_FACTOR_ONE, sa = VK_BLEND_FACTOR_SRC_ALPHA,
+                          da = VK_BLEND_FACTOR_DST_ALPHA, isa = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+                          ida = VK_BLEND_FACTOR_ONE_MINUS_DST_ALPHA;
+  constexpr VkBlendFactor factors[][2] = {
+      {zero, zero},  // clear
+      {one, zero},   // src
+      {zero, one},   // dst
+      {ida, isa},    // xor
+      {da, isa},     // atop
+      {one, isa},    // over
+      {da, zero},    // in
+      {ida, zero},   // out
+      {ida, sa},     // dst atop
+      {ida, one},    // dst over
+      {zero, sa},    // dst in
+      {zero, isa},   // dst out
+  };
+
+  VkPipelineColorBlendAttachmentState result = {};
+  result.colorWriteMask =
+      VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+  result.colorBlendOp = VK_BLEND_OP_ADD;
+  result.alphaBlendOp = VK_BLEND_OP_ADD;
+  if (_mode < BLEND_CLEAR || _mode > BLEND_DST_OUT) {
+    result.blendEnable = VK_FALSE;
+    result.srcColorBlendFactor = result.srcAlphaBlendFactor = one;
+    result.dstColorBlendFactor = result.dstAlphaBlendFactor = zero;
+    return result;
+  }
+
+  const auto &mode = factors[_mode];
+  result.blendEnable = VK_TRUE;
+  result.srcColorBlendFactor = mode[0] == one ? sa : mode[0];
+  result.dstColorBlendFactor = mode[1];
+  result.srcAlphaBlendFactor = mode[0];
+  result.dstAlphaBlendFactor = mode[1];
+  if (_mode == BLEND_OVER)
+    result.dstAlphaBlendFactor = zero;  // writes the source alpha, as the former on/off blending did
+  return result;
+}
+
+void pipeline_desc::alpha_blend(bool _enable) {
+  blending(_enable ? BLEND_OVER : BLEND_NONE);
+}
+
+void pipeline_desc::blending(blend_mode _mode) {
+  blend = blend_attachment(_mode);
+}
+
+bool spirv_code::operator==(const spirv_code &_other) const {
+  return size_ == _other.size_ && (data_ == _other.data_ || memcmp(data_, _other.data_, size_) == 0);
+}
+
+size_t spirv_code::hasher::operator()(const spirv_code &_code) const {
+  return hash_bytes(14695981039346656037ull, _code.data_, _code.size_);
+}
+
+bool pipeline_desc::operator==(const pipeline_desc &_other) const {
+  return spirv_code{vert_code, vert_size} == spirv_code{_other.vert_code, _other.vert_size}
+         && spirv_code{frag_code, frag_size} == spirv_code{_other.frag_code, _other.frag_size} && equal_vectors(bindings, _other.bindings)
+         && equal_vectors(attributes, _other.attributes) && equal_vectors(descriptors, _other.descriptors)
+         && topology == _other.topology && memcmp(&blend, &_other.blend, sizeof(blend)) == 0
+         && dynamic_blend == _other.dynamic_blend && format == _other.format;
+}
+
+size_t pipeline_desc::hasher::operator()(const pipeline_desc &_desc) const {
+  size_t result = 14695981039346656037ull;
+  result = hash_bytes(result, _desc.vert_code, _desc.vert_size);
+  result = hash_bytes(result, _desc.frag_code, _desc.frag_size);
+  result = hash_vector(result, _desc.bindings);
+  result = hash_vector(result, _desc.attributes);
+  result = hash_vector(result, _desc.descriptors);
+  result = hash_bytes(result, &_desc.topology, sizeof(_desc.topology));
+  result = hash_bytes(result, &_desc.blend, sizeof(_desc.blend));
+  result = hash_bytes(result, &_desc.dynamic_blend, sizeof(_desc.dynamic_blend));
+  return hash_bytes(result, &_desc.format, sizeof(_desc.format));
+}
+
+shader_module::shader_module(VkDevice _device, const uint8_t *_code, size_t _size) : device_(_device) {
+  VkShaderModuleCreateInfo module_info = {};
+  module_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+  module_info.codeSize = _size;
+  module_info.pCode = (const uint32_t *)_code;
+
+  if (vkCreateShaderModule(device_, &module_info, nullptr, &module_) != VK_SUCCESS)
+    throw std::runtime_error("failed to create shader module!");
+}
+
+shader_module::~shader_module() {
+  if (module_ != VK_NULL_HANDLE)
+    vkDestroyShaderModule(device_, module_, nullptr);
+}
+
+shared_pipeline::shared_pipeline(display &_display, const pipeline_desc &_desc)
+    : display_(_display), desc_(_desc) {
+  VkDevice device = display_.device_;
+
+  vert_ = display_.get_shader(_desc.vert_code, _desc.vert_size);
+  frag_ = display_.get_shader(_desc.frag_code, _desc.frag_size);
+
+  VkDescriptorSetLayoutCreateInfo descriptors_info = {};
+  descriptors_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  descriptors_info.bindingCount = (uint32_t)_desc.descriptors.size();
+  descriptors_info.pBindings = _desc.descriptors.data();
+
+  if (vkCreateDescriptorSetLayout(device, &descriptors_info, nullptr, &descriptor_layout_) != VK_SUCCESS)
+    throw std::runtime_error("failed to create descriptor set layout!");
+
+  VkPipelineLayoutCreateInfo layout_info = {};
+  layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  VkDescriptorSetLayout set_layouts[] = {display_.globals_layout_, display_.textures_layout_, descriptor_layout_};
+  layout_info.setLayoutCount = 3;
+  layout_info.pSetLayouts = set_layouts;
+  layout_info.pushConstantRangeCount = 1;
+  layout_info.pPushConstantRanges = &draw_constants_range;
+
+  if (vkCreatePipelineLayout(device, &layout_info, nullptr, &layout_) != VK_SUCCESS)
+    throw std::runtime_error("failed to create pipeline layout!");
+
+  VkRenderPass renderpass = display_.compatible_renderpass(_desc.format);
+  compiled_ = display_.compilers_.post([this, renderpass] { compile(renderpass); }).share();
+}
+
+shared_pipeline::~shared_pipeline() {
+  if (compiled_.valid())
+    compiled_.wait();
+
+  VkDevice device = display_.device_;
+  if (pipeline_ != VK_NULL_HANDLE)
+    vkDestroyPipeline(device, pipeline_, nullptr);
+  if (layout_ != VK_NULL_HANDLE)
+    vkDestroyPipelineLayout(device, layout_, nullptr);
+  if (descriptor_layout_ != VK_NULL_HANDLE)
+    vkDestroyDescriptorSetLayout(device, descriptor_layout_, nullptr);
+}
+
+bool shared_pipeline::ready() {
+  if (ready_)
+    return true;
+  if (failed_)
+    compiled_.get();  // rethrows the error, the draws would be skipped forever otherwise
+  // compile() checks skipped_ after setting ready_, check again in case it did so before we flagged the skip
+  skipped_ = true;
+  return ready_;
+}
+
+void shared_pipeline::wait() {
+  compiled_.get();
+}
+
+void shared_pipeline::compile(VkRenderPass _renderpass) {
+  trace::thread_name("pipeline compiler");
+  HUT_TRACE_ZONE("pipeline", "compile pipeline");
+
+  // constant_id 0 sizes the texture table in the shaders
+  uint32_t texture_slots = display_.texture_slots_;
+  VkSpecializationMapEntry constant = {0, 0, sizeof(texture_slots)};
+  VkSpecializationInfo specialization = {};
+  specialization.mapEntryCount = 1;
+  specialization.pMapEntries = &constant;
+  specialization.dataSize = sizeof(texture_slots);
+  specialization.pData = &texture_slots;
+
+  VkPipelineShaderStageCreateInfo stages[2] = {};
+  stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+  stages[0].module = vert_->module_;
+  stages[0].pName = "main";
+  stages[0].pSpecializationInfo = &specialization;
+  stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+  stages[1].module = frag_->module_;
+  stages[1].pName = "main";
+  stages[1].pSpecializationInfo = &specialization;
+
+  VkPipelineVertexInputStateCreateInfo vertex_input = {};
+  vertex_input.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+  vertex_input.vertexBindingDescriptionCount = (uint32_t)desc_.bindings.size();
+  vertex_input.pVertexBindingDescriptions = desc_.bindings.data();
+  vertex_input.vertexAttributeDescriptionCount = (uint32_t)desc_.attributes.size();
+  vertex_input.pVertexAttributeDescriptions = desc_.attributes.data();
+
+  VkPipelineInputAssemblyStateCreateInfo input_assembly = {};
+  input_assembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+  input_assembly.topology = desc_.topology;
+  input_assembly.primitiveRestartEnable = VK_FALSE;
+
+  // viewport and scissor are dynamic, the pipeline doesn't depend on the window size
+  VkPipelineViewportStateCreateInfo viewport = {};
+  viewport.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+  viewport.viewportCount = 1;
+  viewport.scissorCount = 1;
+
+  VkPipelineRasterizationStateCreateInfo rasterizer = {};
+  rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+  rasterizer.depthClampEnable = VK_FALSE;
+  rasterizer.rasterizerDiscardEnable = VK_FALSE;
+  rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+  rasterizer.lineWidth = 1.0f;
+  rasterizer.cullMode = VK_CULL_MODE_FRONT_BIT;
+  rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+  rasterizer.depthBiasEnable = VK_FALSE;
+
+  VkPipelineMultisampleStateCreateInfo multisampling = {};
+  multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+  multisampling.sampleShadingEnable = VK_FALSE;
+  multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+  multisampling.minSampleShading = 1.0f;
+
+  VkPipelineColorBlendStateCreateInfo blending = {};
+  blending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+  blending.logicOpEnable = VK_FALSE;
+  blending.logicOp = VK_LOGIC_OP_COPY;
+  blending.attachmentCount = 1;
+  blending.pAttachments = &desc_.blend;
+
+  VkDynamicState dynamic_states[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR,
+                                     VK_DYNAMIC_STATE_COLOR_BLEND_ENABLE_EXT, VK_DYNAMIC_STATE_COLOR_BLEND_EQUATION_EXT};
+  VkPipelineDynamicStateCreateInfo dynamic = {};
+  dynamic.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+  dynamic.dynamicStateCount = desc_.dynamic_blend ? 4 : 2;
+  dynamic.pDynamicStates = dynamic_states;
+
+  VkGraphicsPipelineCreateInfo pipeline_info = {};
+  pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+  pipeline_info.stageCount = 2;
+  pipeline_info.pStages = stages;
+  pipeline_info.pVertexInputState = &vertex_input;
+  pipeline_info.pInputAssemblyState = &input_assembly;
+  pipeline_info.pViewportState = &viewport;
+  pipeline_info.pRasterizationState = &rasterizer;
+  pipeline_info.pMultisampleState = &multisampling;
+  pipeline_info.pColorBlendState = &blending;
+  pipeline_info.pDynamicState = &dynamic;
+  pipeline_info.layout = layout_;
+  pipeline_info.renderPass = _renderpass;
+  pipeline_info.subpass = 0;
+  pipeline_info.basePipelineIndex = -1;
+
+  if (vkCreateGraphicsPipelines(display_.device_, display_.pipeline_cache_, 1, &pipeline_info, nullptr, &pipeline_)
+      != VK_SUCCESS) {
+    // also thrown from dispatch(), in case no draw checks ready() again
+    auto error = std::make_exception_ptr(std::runtime_error("failed to create graphics pipeline!"));
+    failed_ = true;
+    display_.post([error](auto) { std::rethrow_exception(error); });
+    std::rethrow_exception(error);
+  }
+
+  ready_ = true;
+  if (skipped_) {
+    display &d = display_;
+    d.post([&d](auto) { d.invalidate_windows(); });
+  }
+}
@@ -0,0 +1,181 @@
+/*  _ _ _   _       _
+ * | |_| |_| |_ _ _| |_
+ * | | | . |   | | |  _|
+ * |_|_|___|_|_|___|_|
+ * Hobby graphics and GUI library under the MIT License (MIT)
+ *
+ * Copyright (c) 2014 Jean-Baptiste Lepesme github.com/jiboo/libhut
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "hut/trace.hpp"
+#include "hut/utils.hpp"
+
+using namespace hut;
+
+namespace {
+
+struct zone_record {
+  const char *category_, *name_;
+  trace::time_point begin_, end_;
+};
+
+struct thread_buffer {
+  constexpr static size_t capacity = 16 * 1024;
+
+  std::mutex mutex_;  // only contended while dumping
+  std::vector<zone_record> records_;
+  size_t next_ = 0;
+  uint32_t tid_;
+  std::string name_;
+
+  explicit thread_buffer(uint32_t _tid) : tid_(_tid) {
+    records_.reserve(capacity);
+  }
+
+  void push(const zone_record &_record) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (records_.size() < capacity) {
+      records_.emplace_back(_record);
+    } else {
+      records_[next_] = _record;
+      next_ = (next_ + 1) % capacity;
+    }
+  }
+};
+
+struct registry {
+  std::mutex mutex_;
+  // Buffers are kept after their thread ends, so that its zones can still be dumped.
+  std::vector<std::shared_ptr<thread_buffer>> buffers_;
+  std::shared_ptr<thread_buffer> gpu_;
+
+  registry() {
+    gpu_ = std::make_shared<thread_buffer>(0);
+    gpu_->name_ = "GPU";
+    buffers_.emplace_back(gpu_);
+  }
+
+  std::shared_ptr<thread_buffer> create() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    buffers_.emplace_back(std::make_shared<thread_buffer>((uint32_t)buffers_.size()));
+    return buffers_.back();
+  }
+};
+
+registry &get_registry() {
+  static registry instance;
+  return instance;
+}
+
+thread_buffer &local_buffer() {
+  thread_local std::shared_ptr<thread_buffer> buffer = get_registry().create();
+  return *buffer;
+}
+
+void write_escaped(std::ostream &_out, const std::string &_str) {
+  for (char c : _str) {
+    if (c == '"' || c == '\\')
+      _out << '\\';
+    _out << c;
+  }
+}
+
+}  // namespace
+
+std::atomic<bool> trace::enabled_{false};
+
+void trace::thread_name(const std::string &_name) {
+  auto &buffer = local_buffer();
+  std::lock_guard<std::mutex> lock(buffer.mutex_);
+  buffer.name_ = _name;
+}
+
+void trace::record(const char *_category, const char *_name, time_point _begin, time_point _end) {
+  if (!enabled())
+    return;
+  local_buffer().push(zone_record{_category, _name, _begin, _end});
+}
+
+void trace::record_gpu(const char *_name, time_point _begin, time_point _end) {
+  if (!enabled())
+    return;
+  get_registry().gpu_->push(zone_record{"gpu", _name, _begin, _end});
+}
+
+void trace::dump(const std::string &_path) {
+  std::ofstream out(_path);
+  if (!out.is_open())
+    throw std::runtime_error(sstream("failed to open trace file: ") << _path);
+
+  auto &reg = get_registry();
+  std::vector<std::shared_ptr<thread_buffer>> buffers;
+  {
+    std::lock_guard<std::mutex> lock(reg.mutex_);
+    buffers = reg.buffers_;
+  }
+
+  using us = std::chrono::duration<double, std::micro>;
+  bool first = true;
+  auto separator = [&first, &out]() -> std::ostream & {
+    out << (first ? "\n" : ",\n");
+    first = false;
+    return out;
+  };
+
+  out << R"({"displayTimeUnit": "ms", "traceEvents": [)";
+  for (auto &buffer : buffers) {
+    std::lock_guard<std::mutex> lock(buffer->mutex_);
+    if (!buffer->name_.empty()) {
+      separator() << R"({"name": "thread_name", "ph": "M", "pid": 1, "tid": )" << buffer->tid_
+                  << R"(, "args": {"name": ")";
+      write_escaped(out, buffer->name_);
+      out << R"("}})";
+    }
+    for (auto &record : buffer->records_) {
+      separator() << R"({"name": ")";
+      write_escaped(out, record.name_);
+      out << R"(", "cat": ")";
+      write_escaped(out, record.category_);
+      out << R"(", "ph": "X", "pid": 1, "tid": )" << buffer->tid_ << std::fixed
+          << R"(, "ts": )" << us(record.begin_.time_since_epoch()).count()
+          << R"(, "dur": )" << us(record.end_ - record.begin_).count() << "}";
+    }
+  }
+  out << "\n]}\n";
+
+  if (!out)
+    throw std::runtime_error(sstream("failed to write trace file: ") << _path);
+}
+
+void trace::clear() {
+  auto &reg = get_registry();
+  std::lock_guard<std::mutex> lock(reg.mutex_);
+  for (auto &buffer : reg.buffers_) {
+    std::lock_guard<std::mutex> buffer_lock(buffer->mutex_);
+    buffer->records_.clear();
+    buffer->next_ = 0;
+  }
+}
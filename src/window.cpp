@@ -25,11 +25,17 @@
  * SOFTWARE.
  */
 
+#include <algorithm>
+#include <cassert>
 #include <iomanip>
 #include <iostream>
 #include <thread>
 
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "hut/culler.hpp"
 #include "hut/display.hpp"
+#include "hut/trace.hpp"
 #include "hut/window.hpp"
 
 using namespace hut;
@@ -50,11 +56,21 @@ void window::destroy_vulkan() {
 
   vkDeviceWaitIdle(display_.device_);
 
-  if (sem_available_ != VK_NULL_HANDLE)
-    vkDestroySemaphore(display_.device_, sem_available_, nullptr);
+  destroy_frames();
+
+  if (timestamps_ != VK_NULL_HANDLE)
+    vkDestroyQueryPool(display_.device_, timestamps_, nullptr);
+  timestamps_ = VK_NULL_HANDLE;
 
-  if (sem_rendered_ != VK_NULL_HANDLE)
-    vkDestroySemaphore(display_.device_, sem_rendered_, nullptr);
+  for (auto *node : nodes_)
+    node->destroy_cbs();
+
+  if (globals_pool_ != VK_NULL_HANDLE)
+    vkDestroyDescriptorPool(display_.device_, globals_pool_, nullptr);
+  globals_pool_ = VK_NULL_HANDLE;
+  globals_ = VK_NULL_HANDLE;
+  globals_ubo_.reset();
+  globals_buffer_.reset();
 
   if (renderpass_ != VK_NULL_HANDLE)
     vkDestroyRenderPass(display_.device_, renderpass_, nullptr);
@@ -118,12 +134,12 @@ void window::init_vulkan_surface() {
   std::vector<VkPresentModeKHR> modes(modes_count);
   vkGetPhysicalDeviceSurfacePresentModesKHR(pdevice, surface_, &modes_count, modes.data());
   present_mode_ = VK_PRESENT_MODE_FIFO_KHR;
-  // NOTE JB: We don't really need 10k fps, force fifo for now
-  /*for (const auto &it : modes) {
-    if (it == VK_PRESENT_MODE_MAILBOX_KHR) {
-      present_mode_ = it;
+  for (auto candidate : present_fallbacks(requested_present_mode_)) {
+    if (std::find(modes.begin(), modes.end(), candidate) != modes.end()) {
+      present_mode_ = candidate;
+      break;
     }
-  }*/
+  }
 
   if (capabilities.currentExtent.width != std::numeric_limits<uint32_t>::max()) {
     swapchain_extents_ = capabilities.currentExtent;
@@ -137,6 +153,8 @@ void window::init_vulkan_surface() {
   }
 
   uint32_t images_count = capabilities.minImageCount + 1;
+  if (requested_images_count_ != 0)
+    images_count = std::max(capabilities.minImageCount, requested_images_count_);
   if (capabilities.maxImageCount > 0 && images_count > capabilities.maxImageCount) {
     images_count = capabilities.maxImageCount;
   }
@@ -150,6 +168,9 @@ void window::init_vulkan_surface() {
   swapchain_infos.imageExtent = swapchain_extents_;
   swapchain_infos.imageArrayLayers = 1;
   swapchain_infos.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+  capturable_ = (capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) != 0;
+  if (capturable_)
+    swapchain_infos.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
 
   uint32_t iqueues[] = {display_.iqueueg_, display_.iqueuep_};
   if (iqueues[0] != iqueues[1]) {
@@ -207,47 +228,9 @@ void window::init_vulkan_surface() {
       throw std::runtime_error("failed to create image views!");
   }
 
-  VkAttachmentDescription colorAttachment = {};
-  colorAttachment.format = surface_format_.format;
-  colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-  colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-  colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-  colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-  colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-  colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-  colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-
-  VkAttachmentReference colorAttachmentRef = {};
-  colorAttachmentRef.attachment = 0;
-  colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-  VkSubpassDescription subpass = {};
-  subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-
-  subpass.colorAttachmentCount = 1;
-  subpass.pColorAttachments = &colorAttachmentRef;
-
-  VkSubpassDependency dependency = {};
-  dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-  dependency.dstSubpass = 0;
-  dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-  dependency.srcAccessMask = 0;
-  dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-  dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-
-  VkRenderPassCreateInfo renderPassInfo = {};
-  renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-  renderPassInfo.attachmentCount = 1;
-  renderPassInfo.pAttachments = &colorAttachment;
-  renderPassInfo.subpassCount = 1;
-  renderPassInfo.pSubpasses = &subpass;
-  renderPassInfo.dependencyCount = 1;
-  renderPassInfo.pDependencies = &dependency;
-
   if (renderpass_ != VK_NULL_HANDLE)
     vkDestroyRenderPass(display_.device_, renderpass_, nullptr);
-  if (vkCreateRenderPass(display_.device_, &renderPassInfo, nullptr, &renderpass_) != VK_SUCCESS)
-    throw std::runtime_error("failed to create render pass!");
+  renderpass_ = display_.create_renderpass(surface_format_.format);
 
   for (auto &fbo : swapchain_fbos_) {
     if (fbo != VK_NULL_HANDLE)
@@ -283,21 +266,355 @@ void window::init_vulkan_surface() {
   if (vkAllocateCommandBuffers(display_.device_, &allocInfo, primary_cbs_.data()) != VK_SUCCESS)
     throw std::runtime_error("failed to allocate command buffers!");
 
-  if (sem_available_ != VK_NULL_HANDLE)
-    vkDestroySemaphore(display_.device_, sem_available_, nullptr);
-  if (sem_rendered_ != VK_NULL_HANDLE)
-    vkDestroySemaphore(display_.device_, sem_rendered_, nullptr);
+  init_frames(frames_.empty() ? default_frames_in_flight : frames_.size());
+  images_fences_.assign(images_count, VK_NULL_HANDLE);
+  init_timestamps(images_count);
+  update_globals();
+
+  for (size_t i = 0; i < dirty_.size(); i++)
+    dirty_[i] = true;
+  dirty_.resize(images_count, true);
+
+  if (!root_) {
+    root_ = std::make_unique<node>(*this);
+    root_->on_draw.connect(
+        [this](recorder &_recorder, const glm::uvec2 &_size) { return on_draw.fire(_recorder, _size); });
+  }
+  for (auto *node : nodes_)
+    node->init_cbs(images_count);
+}
+
+void window::init_globals() {
+  globals_buffer_ = std::make_shared<buffer>(
+      display_, 256, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+      (VkBufferUsageFlagBits)(VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT));
+  globals_ubo_ = globals_buffer_->allocate<view_ubo>();
+
+  VkDescriptorPoolSize pool_size = {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1};
+  VkDescriptorPoolCreateInfo pool_info = {};
+  pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  pool_info.poolSizeCount = 1;
+  pool_info.pPoolSizes = &pool_size;
+  pool_info.maxSets = 1;
+
+  if (vkCreateDescriptorPool(display_.device_, &pool_info, nullptr, &globals_pool_) != VK_SUCCESS)
+    throw std::runtime_error("failed to create globals descriptor pool!");
+
+  VkDescriptorSetAllocateInfo alloc_info = {};
+  alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  alloc_info.descriptorPool = globals_pool_;
+  alloc_info.descriptorSetCount = 1;
+  alloc_info.pSetLayouts = &display_.globals_layout_;
+
+  if (vkAllocateDescriptorSets(display_.device_, &alloc_info, &globals_) != VK_SUCCESS)
+    throw std::runtime_error("failed to allocate globals descriptor set!");
+
+  VkDescriptorBufferInfo buffer_info = {};
+  buffer_info.buffer = globals_buffer_->buffer_;
+  buffer_info.offset = globals_ubo_->offset_;
+  buffer_info.range = globals_ubo_->size_;
+
+  VkWriteDescriptorSet write = {};
+  write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  write.dstSet = globals_;
+  write.dstBinding = 0;
+  write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+  write.descriptorCount = 1;
+  write.pBufferInfo = &buffer_info;
+  vkUpdateDescriptorSets(display_.device_, 1, &write, 0, nullptr);
+}
+
+void window::update_globals() {
+  if (!globals_ubo_)
+    init_globals();
+  if (!custom_proj_)
+    globals_values_.proj = glm::ortho<float>(0, size_.x, 0, size_.y);
+  globals_ubo_->set({globals_values_});
+}
+
+void window::view(const glm::mat4 &_view) {
+  globals_values_.view = _view;
+  if (globals_ubo_) {
+    update_globals();
+    invalidate(false);
+  }
+}
+
+void window::projection(const glm::mat4 &_proj) {
+  globals_values_.proj = _proj;
+  custom_proj_ = true;
+  if (globals_ubo_) {
+    update_globals();
+    invalidate(false);
+  }
+}
+
+void window::present_policy(present_mode _mode, uint32_t _images_count) {
+  display_.check_thread();
+
+  requested_present_mode_ = _mode;
+  requested_images_count_ = _images_count;
+  if (swapchain_ != VK_NULL_HANDLE)
+    init_vulkan_surface();
+}
+
+present_mode window::active_present_mode() {
+  switch (present_mode_) {
+    case VK_PRESENT_MODE_IMMEDIATE_KHR:
+      return PRESENT_IMMEDIATE;
+    case VK_PRESENT_MODE_MAILBOX_KHR:
+      return PRESENT_MAILBOX;
+    case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+      return PRESENT_FIFO_RELAXED;
+    default:
+      return PRESENT_FIFO;
+  }
+}
+
+std::vector<VkPresentModeKHR> window::present_fallbacks(present_mode _mode) {
+  switch (_mode) {
+    case PRESENT_IMMEDIATE:
+      return {VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_KHR};
+    case PRESENT_MAILBOX:
+      return {VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_KHR};
+    case PRESENT_FIFO_RELAXED:
+      return {VK_PRESENT_MODE_FIFO_RELAXED_KHR, VK_PRESENT_MODE_FIFO_KHR};
+    default:
+      return {VK_PRESENT_MODE_FIFO_KHR};
+  }
+}
+
+void window::frame_rate(uint16_t _fps) {
+  display_.check_thread();
+
+  frame_rate_ = _fps;
+  if (_fps == 0)
+    frame_period_ = display::duration::zero();
+  else
+    frame_period_ = std::chrono::duration_cast<display::duration>(std::chrono::duration<double>(1. / _fps));
+  next_frame_ = display::clock::now();
+}
+
+void window::init_timestamps(size_t _images_count) {
+  if (timestamps_ != VK_NULL_HANDLE)
+    vkDestroyQueryPool(display_.device_, timestamps_, nullptr);
+  timestamps_ = VK_NULL_HANDLE;
+  timestamps_submitted_.assign(_images_count, display::time_point());
+
+  if (!display_.device_props_.limits.timestampComputeAndGraphics)
+    return;
+
+  uint32_t families_count;
+  vkGetPhysicalDeviceQueueFamilyProperties(display_.pdevice_, &families_count, nullptr);
+  std::vector<VkQueueFamilyProperties> families(families_count);
+  vkGetPhysicalDeviceQueueFamilyProperties(display_.pdevice_, &families_count, families.data());
+  uint32_t valid_bits = families[display_.iqueueg_].timestampValidBits;
+  if (valid_bits == 0)
+    return;
+  timestamps_mask_ = valid_bits >= 64 ? ~uint64_t(0) : (uint64_t(1) << valid_bits) - 1;
+
+  VkQueryPoolCreateInfo queryInfo = {};
+  queryInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+  queryInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+  queryInfo.queryCount = (uint32_t)(2 * _images_count);
+  if (vkCreateQueryPool(display_.device_, &queryInfo, nullptr, &timestamps_) != VK_SUCCESS)
+    throw std::runtime_error("failed to create timestamps query pool!");
+}
+
+void window::read_timestamps(uint32_t _image_index) {
+  if (timestamps_ == VK_NULL_HANDLE || timestamps_submitted_[_image_index] == display::time_point())
+    return;
+  display::time_point submitted = timestamps_submitted_[_image_index];
+  timestamps_submitted_[_image_index] = display::time_point();
+
+  uint64_t ticks[2];
+  if (vkGetQueryPoolResults(display_.device_, timestamps_, 2 * _image_index, 2, sizeof(ticks), ticks, sizeof(uint64_t),
+                            VK_QUERY_RESULT_64_BIT) != VK_SUCCESS)
+    return;
+
+  double period = display_.device_props_.limits.timestampPeriod;  // ns per tick
+  uint64_t elapsed = (ticks[1] - ticks[0]) & timestamps_mask_;     // the counter may have wrapped around
+  gpu_durations_.push(elapsed * period / 1e6);
+
+  if (trace::enabled()) {
+    using namespace std::chrono;
+    auto gpu_begin = duration_cast<display::duration>(duration<double, std::nano>(ticks[0] * period));
+    auto gpu_end = duration_cast<display::duration>(duration<double, std::nano>((ticks[0] + elapsed) * period));
+
+    // Without calibrated timestamps, the best mapping we have is that the GPU can't start before the submission:
+    // the offset between both clocks is at least (submit - gpu begin) for every frame, keep the tightest bound.
+    auto offset = submitted.time_since_epoch() - gpu_begin;
+    if (!gpu_clock_offset_known_ || offset > gpu_clock_offset_) {
+      gpu_clock_offset_ = offset;
+      gpu_clock_offset_known_ = true;
+    }
+    trace::record_gpu("render pass", display::time_point(gpu_begin + gpu_clock_offset_),
+                      display::time_point(gpu_end + gpu_clock_offset_));
+  }
+}
+
+frame_stats window::stats() {
+  auto summarize = [](const rolling_window<double> &_samples) {
+    frame_stats::percentiles result;
+    result.p50 = _samples.percentile(0.5);
+    result.p99 = _samples.percentile(0.99);
+    result.max = _samples.max();
+    return result;
+  };
+
+  frame_stats result;
+  result.acquire = summarize(acquire_durations_);
+  result.draw = summarize(draw_durations_);
+  result.submit = summarize(submit_durations_);
+  result.present = summarize(present_durations_);
+  result.total = summarize(total_durations_);
+  result.gpu = summarize(gpu_durations_);
+  result.jobs = summarize(display_.jobs_durations_);
+  result.frames = total_durations_.size();
+  for (auto *node : nodes_) {
+    result.commands_issued += node->recorded_.issued;
+    result.commands_elided += node->recorded_.elided;
+  }
+  return result;
+}
+
+void window::capture(const capture_callback &_callback) {
+  display_.check_thread();
+  if (swapchain_ != VK_NULL_HANDLE && !capturable_)
+    throw std::runtime_error("surface images can't be captured!");
+
+  captures_.emplace_back(_callback);
+  invalidate(false);
+}
+
+void window::record_capture(uint32_t _image_index, frame &_frame) {
+  HUT_TRACE_ZONE("frame", "record_capture");
+
+  glm::uvec2 size{swapchain_extents_.width, swapchain_extents_.height};
+  VkFormat format = surface_format_.format;
+  uint32_t bytes = size.x * size.y * 4;
+  auto target = std::make_shared<buffer>(display_, bytes,
+                                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                         VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+
+  VkCommandBufferAllocateInfo allocInfo = {};
+  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocInfo.commandPool = display_.commandg_pool_;
+  allocInfo.commandBufferCount = 1;
+
+  VkCommandBuffer cb;
+  if (vkAllocateCommandBuffers(display_.device_, &allocInfo, &cb) != VK_SUCCESS)
+    throw std::runtime_error("failed to allocate capture command buffer!");
+
+  VkCommandBufferBeginInfo beginInfo = {};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  vkBeginCommandBuffer(cb, &beginInfo);
+
+  VkImageMemoryBarrier barrier = {};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+  barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = swapchain_images_[_image_index];
+  barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  barrier.subresourceRange.levelCount = 1;
+  barrier.subresourceRange.layerCount = 1;
+  barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+  vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr,
+                       0, nullptr, 1, &barrier);
+
+  VkBufferImageCopy region = {};
+  region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  region.imageSubresource.layerCount = 1;
+  region.imageExtent = {size.x, size.y, 1};
+  vkCmdCopyImageToBuffer(cb, barrier.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, target->buffer_, 1, &region);
+
+  barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+  barrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+  barrier.dstAccessMask = 0;
+
+  VkBufferMemoryBarrier host_barrier = {};
+  host_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  host_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  host_barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+  host_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  host_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  host_barrier.buffer = target->buffer_;
+  host_barrier.size = VK_WHOLE_SIZE;
+  vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT | VK_PIPELINE_STAGE_HOST_BIT,
+                       0, 0, nullptr, 1, &host_barrier, 1, &barrier);
+
+  if (vkEndCommandBuffer(cb) != VK_SUCCESS)
+    throw std::runtime_error("failed to record capture command buffer!");
+  cbs_.emplace_back(cb);
+
+  auto callbacks = std::move(captures_);
+  captures_.clear();
+  _frame.on_recycle_.once([this, cb, target, size, format, bytes, callbacks]() {
+    void *pixels;
+    vkMapMemory(display_.device_, target->memory_, 0, bytes, 0, &pixels);
+    for (auto &callback : callbacks)
+      callback(size, format, (const uint8_t *)pixels);
+    vkUnmapMemory(display_.device_, target->memory_);
+    vkFreeCommandBuffers(display_.device_, display_.commandg_pool_, 1, &cb);
+    return false;
+  });
+}
+
+void window::init_frames(size_t _count) {
+  destroy_frames();
+
+  frames_.resize(_count);
+  current_frame_ = 0;
 
   VkSemaphoreCreateInfo semaphoreInfo = {};
   semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-  if (vkCreateSemaphore(display_.device_, &semaphoreInfo, nullptr, &sem_available_) != VK_SUCCESS ||
-      vkCreateSemaphore(display_.device_, &semaphoreInfo, nullptr, &sem_rendered_) != VK_SUCCESS) {
-    throw std::runtime_error("failed to create semaphores!");
+
+  VkFenceCreateInfo fenceInfo = {};
+  fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+  fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+  for (auto &frame : frames_) {
+    if (vkCreateSemaphore(display_.device_, &semaphoreInfo, nullptr, &frame.sem_available_) != VK_SUCCESS ||
+        vkCreateSemaphore(display_.device_, &semaphoreInfo, nullptr, &frame.sem_rendered_) != VK_SUCCESS ||
+        vkCreateSemaphore(display_.device_, &semaphoreInfo, nullptr, &frame.sem_culled_) != VK_SUCCESS) {
+      throw std::runtime_error("failed to create semaphores!");
+    }
+    if (vkCreateFence(display_.device_, &fenceInfo, nullptr, &frame.fence_) != VK_SUCCESS)
+      throw std::runtime_error("failed to create frame fence!");
   }
+}
 
-  for (size_t i = 0; i < dirty_.size(); i++)
-    dirty_[i] = true;
-  dirty_.resize(images_count, true);
+void window::destroy_frames() {
+  for (auto &frame : frames_) {
+    frame.on_recycle_.fire();
+    if (frame.sem_available_ != VK_NULL_HANDLE)
+      vkDestroySemaphore(display_.device_, frame.sem_available_, nullptr);
+    if (frame.sem_rendered_ != VK_NULL_HANDLE)
+      vkDestroySemaphore(display_.device_, frame.sem_rendered_, nullptr);
+    if (frame.sem_culled_ != VK_NULL_HANDLE)
+      vkDestroySemaphore(display_.device_, frame.sem_culled_, nullptr);
+    if (frame.fence_ != VK_NULL_HANDLE)
+      vkDestroyFence(display_.device_, frame.fence_, nullptr);
+  }
+  frames_.clear();
+  std::fill(images_fences_.begin(), images_fences_.end(), VK_NULL_HANDLE);
+}
+
+void window::frames_in_flight(uint8_t _count) {
+  display_.check_thread();
+  assert(_count > 0);
+
+  if (swapchain_ == VK_NULL_HANDLE || _count == frames_.size())
+    return;
+
+  vkDeviceWaitIdle(display_.device_);
+  init_frames(_count);
 }
 
 void window::redraw(display::time_point _tp) {
@@ -308,9 +625,33 @@ void window::redraw(display::time_point _tp) {
 
   auto start = display::clock::now();
 
+  if (frame_period_ != display::duration::zero()) {
+    if (start < next_frame_) {
+      if (!paced_redraw_) {
+        paced_redraw_ = true;
+        display_.post_at(
+            [this](display::time_point _tp) {
+              paced_redraw_ = false;
+              redraw(_tp);
+            },
+            next_frame_);
+      }
+      return;
+    }
+    // Keep the cadence unless we're more than a frame late, don't try to catch up missed frames.
+    next_frame_ = start - next_frame_ > frame_period_ ? start + frame_period_ : next_frame_ + frame_period_;
+  }
+
+  HUT_TRACE_ZONE("frame", "redraw");
+
+  // Throttle the CPU so that it never gets more than frames_.size() frames ahead of the GPU.
+  frame &current = frames_[current_frame_];
+  vkWaitForFences(display_.device_, 1, &current.fence_, VK_TRUE, std::numeric_limits<uint64_t>::max());
+  current.on_recycle_.fire();
+
   uint32_t imageIndex;
   VkResult result = vkAcquireNextImageKHR(display_.device_, swapchain_, std::numeric_limits<uint64_t>::max(),
-                                          sem_available_, VK_NULL_HANDLE, &imageIndex);
+                                          current.sem_available_, VK_NULL_HANDLE, &imageIndex);
 
   if (result == VK_ERROR_OUT_OF_DATE_KHR) {
     init_vulkan_surface();
@@ -319,40 +660,74 @@ void window::redraw(display::time_point _tp) {
     throw std::runtime_error("failed to acquire swap chain image!");
   }
 
+  // The image may still be used by a frame from another slot, its command buffer can't be touched before that's done.
+  VkFence &image_fence = images_fences_[imageIndex];
+  if (image_fence != VK_NULL_HANDLE && image_fence != current.fence_)
+    vkWaitForFences(display_.device_, 1, &image_fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+  image_fence = current.fence_;
+  read_timestamps(imageIndex);  // the previous submission of this image is done
+
   auto acquire = display::clock::now();
+  trace::record("frame", "acquire", start, acquire);
 
   on_frame.fire(size_, last_frame_ - _tp);
   display_.flush_staged();
+  for (auto *culler : cullers_)
+    culler->update(imageIndex);
 
-  if (dirty_[imageIndex]) {
-    vkDeviceWaitIdle(display_.device_);
+  // Re-recording a secondary command buffer invalidates the primary executing it.
+  bool rebuild = record_nodes(imageIndex) || dirty_[imageIndex];
+  if (rebuild) {
     dirty_[imageIndex] = false;
-    rebuild_cb(swapchain_fbos_[imageIndex], primary_cbs_[imageIndex]);
+    rebuild_cb(imageIndex);
   }
 
   auto draw = display::clock::now();
 
   cbs_.emplace_back(primary_cbs_[imageIndex]);
+  if (!captures_.empty())
+    record_capture(imageIndex, current);  // after the primary, in the same submission
+
+  // The culling passes run on the compute queue, overlapping the graphics work still in flight.
+  if (!cullers_.empty()) {
+    std::vector<VkCommandBuffer> culling;
+    for (auto *culler : cullers_)
+      culling.emplace_back(culler->images_[imageIndex].cb_);
+    VkSubmitInfo cullingInfo = {};
+    cullingInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    cullingInfo.commandBufferCount = (uint32_t)culling.size();
+    cullingInfo.pCommandBuffers = culling.data();
+    cullingInfo.signalSemaphoreCount = 1;
+    cullingInfo.pSignalSemaphores = &current.sem_culled_;
+    if (vkQueueSubmit(display_.queuec_, 1, &cullingInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+      throw std::runtime_error("failed to submit culling command buffers!");
+  }
 
   VkSubmitInfo submitInfo = {};
   submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-  VkSemaphore waitSemaphores[] = {sem_available_};
-  VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-  submitInfo.waitSemaphoreCount = 1;
+  VkSemaphore waitSemaphores[] = {current.sem_available_, current.sem_culled_};
+  VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                                       VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT};
+  submitInfo.waitSemaphoreCount = cullers_.empty() ? 1 : 2;
   submitInfo.pWaitSemaphores = waitSemaphores;
   submitInfo.pWaitDstStageMask = waitStages;
 
   submitInfo.commandBufferCount = (uint32_t)cbs_.size();
   submitInfo.pCommandBuffers = cbs_.data();
 
-  VkSemaphore signalSemaphores[] = {sem_rendered_};
+  VkSemaphore signalSemaphores[] = {current.sem_rendered_};
   submitInfo.signalSemaphoreCount = 1;
   submitInfo.pSignalSemaphores = signalSemaphores;
 
-  if (vkQueueSubmit(display_.queueg_, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+  vkResetFences(display_.device_, 1, &current.fence_);
+  if (timestamps_ != VK_NULL_HANDLE)
+    timestamps_submitted_[imageIndex] = display::clock::now();  // the GPU can't start the render pass before this
+  if (vkQueueSubmit(display_.queueg_, 1, &submitInfo, current.fence_) != VK_SUCCESS)
     throw std::runtime_error("failed to submit draw command buffer!");
 
+  current_frame_ = (current_frame_ + 1) % frames_.size();
+
   auto submit = display::clock::now();
 
   VkPresentInfoKHR presentInfo = {};
@@ -375,29 +750,24 @@ void window::redraw(display::time_point _tp) {
   }
 
   auto present = display::clock::now();
+  trace::record("frame", "submit", draw, submit);
+  trace::record("frame", "present", submit, present);
 
   cbs_.clear();
 
-  if (fps_limit_ != 0) {
-    auto diff = present - last_frame_;
-    auto limit = std::chrono::microseconds((uint)(1. / fps_limit_ * 1000 * 1000));
-    if (diff < limit)
-      std::this_thread::sleep_for(limit - diff);
-  }
+  last_frame_ = present;
+
+  using ms = std::chrono::duration<double, std::milli>;
+  acquire_durations_.push(ms(acquire - start).count());
+  draw_durations_.push(ms(draw - acquire).count());
+  submit_durations_.push(ms(submit - draw).count());
+  present_durations_.push(ms(present - submit).count());
+  total_durations_.push(ms(present - start).count());
 
-  auto done = display::clock::now();
-  last_frame_ = done;
-
-#if !defined(NDEBUG) && 0
-  std::cout << std::setprecision(2) << std::fixed << "Redraw took " << std::setw(8)
-            << std::chrono::duration<double, std::milli>(done - start).count() << "ms (acquire " << std::setw(8)
-            << std::chrono::duration<double, std::micro>(acquire - start).count() << "µs, draw " << std::setw(8)
-            << std::chrono::duration<double, std::micro>(draw - acquire).count() << "µs, submit " << std::setw(8)
-            << std::chrono::duration<double, std::micro>(submit - draw).count() << "µs, present " << std::setw(8)
-            << std::chrono::duration<double, std::micro>(present - submit).count() << "µs, limit " << std::setw(8)
-            << std::chrono::duration<double, std::micro>(done - present).count() << "µs) for framebuffer " << imageIndex
-            << std::endl;
-#endif
+  if (present - last_stats_ >= std::chrono::seconds(1)) {
+    last_stats_ = present;
+    on_stats.fire(stats());
+  }
 }
 
 void window::dispatch_resize(const glm::uvec2 &_size) {
@@ -406,20 +776,59 @@ void window::dispatch_resize(const glm::uvec2 &_size) {
   on_resize.fire(_size);
 }
 
-void window::rebuild_cb(VkFramebuffer _fbo, VkCommandBuffer _cb) {
+bool window::record_nodes(uint32_t _image_index) {
+  HUT_TRACE_ZONE("draw", "record_nodes");
+  record_work_.resize(display_.record_pools_.size());
+  for (auto &work : record_work_)
+    work.clear();
+
+  size_t busy_pools = 0, last_pool = 0;
+  for (auto *node : nodes_) {
+    if (!node->dirty_[_image_index])
+      continue;
+    auto &work = record_work_[node->pool_];
+    if (work.empty()) {
+      busy_pools++;
+      last_pool = node->pool_;
+    }
+    work.emplace_back(node);
+  }
+
+  auto record_pool = [this, _image_index](size_t _pool) {
+    for (auto *node : record_work_[_pool])
+      node->record(_image_index);
+  };
+
+  if (busy_pools == 0)
+    return false;
+  else if (busy_pools == 1)
+    record_pool(last_pool);  // not worth waking up the recorders
+  else
+    display_.record_parallel(record_pool);
+  return true;
+}
+
+void window::rebuild_cb(uint32_t _image_index) {
   display_.check_thread();
+  HUT_TRACE_ZONE("draw", "rebuild_cb");
+
+  VkCommandBuffer cb = primary_cbs_[_image_index];
 
   VkCommandBufferBeginInfo beginInfo = {};
   beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
   beginInfo.pInheritanceInfo = nullptr;  // Optional
 
-  vkBeginCommandBuffer(_cb, &beginInfo);
+  vkBeginCommandBuffer(cb, &beginInfo);
+
+  if (timestamps_ != VK_NULL_HANDLE) {
+    vkCmdResetQueryPool(cb, timestamps_, 2 * _image_index, 2);
+    vkCmdWriteTimestamp(cb, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestamps_, 2 * _image_index);
+  }
 
   VkRenderPassBeginInfo renderPassInfo = {};
   renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
   renderPassInfo.renderPass = renderpass_;
-  renderPassInfo.framebuffer = _fbo;
+  renderPassInfo.framebuffer = swapchain_fbos_[_image_index];
   renderPassInfo.renderArea.offset = {0, 0};
   renderPassInfo.renderArea.extent = swapchain_extents_;
 
@@ -427,13 +836,18 @@ void window::rebuild_cb(VkFramebuffer _fbo, VkCommandBuffer _cb) {
   renderPassInfo.clearValueCount = 1;
   renderPassInfo.pClearValues = &clearColor;
 
-  vkCmdBeginRenderPass(_cb, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);  // FIXME
-  // VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
-  // to enable secondary command buffers
+  vkCmdBeginRenderPass(cb, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
 
-  on_draw.fire(_cb, size_);
+  std::vector<VkCommandBuffer> secondaries;
+  secondaries.reserve(nodes_.size());
+  for (auto *node : nodes_)
+    secondaries.emplace_back(node->cbs_[_image_index]);
+  if (!secondaries.empty())
+    vkCmdExecuteCommands(cb, (uint32_t)secondaries.size(), secondaries.data());
 
-  vkCmdEndRenderPass(_cb);
-  if (vkEndCommandBuffer(_cb) != VK_SUCCESS)
+  vkCmdEndRenderPass(cb);
+  if (timestamps_ != VK_NULL_HANDLE)
+    vkCmdWriteTimestamp(cb, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestamps_, 2 * _image_index + 1);
+  if (vkEndCommandBuffer(cb) != VK_SUCCESS)
     throw std::runtime_error("failed to record command buffer!");
 }
\ No newline at end of file
@@ -40,11 +40,16 @@
 #include <glm/ext.hpp>
 
 #include "hut/display.hpp"
+#include "hut/trace.hpp"
 #include "hut/window.hpp"
 
 using namespace hut;
 
-display::display(const char *_app_name, uint32_t _app_version, const char *_name) {
+display::display(const char *_app_name, uint32_t _app_version, const char *_name, uint8_t _recording_threads)
+    : recorders_(recording_threads(_recording_threads) - 1),
+      compilers_(std::max(1u, std::thread::hardware_concurrency() / 2)) {
+  init_jobs_loop();
+
   std::vector<const char *> extensions = {VK_KHR_XCB_SURFACE_EXTENSION_NAME};
   init_vulkan_instance(_app_name, _app_version, extensions);
 
@@ -132,6 +137,12 @@ display::~display() {
   destroy_vulkan();
   xcb_key_symbols_free(keysyms_);
   xcb_disconnect(connection_);
+  destroy_jobs_loop();
+}
+
+void display::invalidate_windows() {
+  for (auto &win : windows_)
+    win.second->invalidate(true);
 }
 
 void display::flush() {
@@ -253,8 +264,10 @@ int display::dispatch() {
 
   bool loop = true;
   dispatcher_ = std::this_thread::get_id();
+  trace::thread_name("dispatcher");
 
   std::thread event_pump([&loop, this]() {
+    trace::thread_name("xcb events");
     while (loop) {
       xcb_generic_event_t *event = xcb_wait_for_event(connection_);
       if (event != nullptr) {
@@ -464,7 +477,7 @@ int display::dispatch() {
           case XCB_DESTROY_NOTIFY: {
             if (windows_.empty()) {
               loop = false;
-              cv_.notify_one();
+              wakeup();
             }
           } break;
 
@@ -28,6 +28,7 @@
 #define XK_MISCELLANY
 #define XK_LATIN1
 #include <X11/keysymdef.h>
+#include <algorithm>
 #include <cstring>
 
 #include "hut/display.hpp"
@@ -225,8 +226,8 @@ void window::title(const std::string &_title) {
 
 void window::invalidate(const glm::uvec4 &_coords, bool _redraw) {
   if (_redraw) {
-    for (size_t i = 0; i < dirty_.size(); i++)
-      dirty_[i] = true;
+    for (auto *node : nodes_)
+      std::fill(node->dirty_.begin(), node->dirty_.end(), true);
   }
   xcb_expose_event_t event = {};
   event.window = window_;
@@ -0,0 +1,104 @@
+/*  _ _ _   _       _
+ * | |_| |_| |_ _ _| |_
+ * | | | . |   | | |  _|
+ * |_|_|___|_|_|___|_|
+ * Hobby graphics and GUI library under the MIT License (MIT)
+ *
+ * Copyright (c) 2014 Jean-Baptiste Lepesme github.com/jiboo/libhut
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include "hut/display.hpp"
+#include "hut/drawables/rgb.hpp"
+#include "hut/node.hpp"
+#include "hut/window.hpp"
+
+using namespace std;
+using namespace std::chrono;
+using namespace hut;
+
+// Measures how recording of many dirty nodes scales with the number of recording threads.
+// usage: bench_record [nodes=64] [draws per node=512] [iterations=32]
+
+class bench_window : public window {
+ public:
+  explicit bench_window(display &_display) : window(_display) {
+  }
+
+  void record_all() {
+    record_nodes(0);
+  }
+};
+
+int main(int argc, char **argv) {
+  size_t nodes_count = argc > 1 ? stoul(argv[1]) : 64;
+  size_t draws_count = argc > 2 ? stoul(argv[2]) : 512;
+  size_t iterations = argc > 3 ? stoul(argv[3]) : 32;
+  unsigned max_threads = max(1u, thread::hardware_concurrency());
+
+  cout << fixed << setprecision(2);
+  cout << nodes_count << " nodes, " << draws_count << " draws per node, " << iterations << " iterations" << endl;
+
+  double reference = 0;
+  for (unsigned threads = 1; threads <= max_threads; threads *= 2) {
+    display d("bench_record", VK_MAKE_VERSION(1, 0, 0), nullptr, (uint8_t)threads);
+    bench_window w(d);
+
+    buffer b(d, 1024, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+             (VkBufferUsageFlagBits)(VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+                                     VK_BUFFER_USAGE_INDEX_BUFFER_BIT));
+    auto vertices = b.allocate<rgb::vertex>(4);
+    auto indices = b.allocate<uint16_t>(6);
+    d.flush_staged();
+
+    rgb pipeline(w);
+    pipeline.wait();
+
+    vector<unique_ptr<node>> nodes;
+    for (size_t i = 0; i < nodes_count; i++) {
+      nodes.emplace_back(make_unique<node>(w));
+      nodes.back()->on_draw.connect([&](recorder &_recorder, const glm::uvec2 &_size) {
+        for (size_t draw = 0; draw < draws_count; draw++)
+          pipeline.draw(_recorder, _size, vertices, indices);
+        return false;
+      });
+    }
+
+    display::duration total{0};
+    for (size_t i = 0; i < iterations; i++) {
+      for (auto &n : nodes)
+        n->invalidate();
+      auto start = display::clock::now();
+      w.record_all();
+      total += display::clock::now() - start;
+    }
+
+    double ms = duration<double, milli>(total).count() / iterations;
+    if (threads == 1)
+      reference = ms;
+    cout << setw(3) << threads << " threads: " << setw(8) << ms << "ms per frame, speedup x" << reference / ms << endl;
+  }
+
+  return 0;
+}
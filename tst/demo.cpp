@@ -31,12 +31,22 @@
 #include <glm/ext.hpp>
 
 #include "demo_png.h"
+#include "hut/batch.hpp"
+#include "hut/culler.hpp"
 #include "hut/display.hpp"
+#include "hut/draw_list.hpp"
 #include "hut/drawables/rgb.hpp"
 #include "hut/drawables/rgba.hpp"
 #include "hut/drawables/tex.hpp"
 #include "hut/drawables/rgb_tex.hpp"
 #include "hut/drawables/rgba_tex.hpp"
+#include "hut/drawables/rect.hpp"
+#include "hut/drawables/shape.hpp"
+#include "hut/node.hpp"
+#ifdef HUT_TEXT
+#include "hut/text.hpp"
+#endif
+#include "hut/trace.hpp"
 #include "hut/window.hpp"
 
 using namespace std;
@@ -52,6 +62,9 @@ int main(int argc, char **argv) {
   auto start = display::clock::now();
   cout << fixed << setprecision(1);
 
+  const char *trace_path = getenv("HUT_TRACE");  // chrome trace written there on exit
+  trace::enable(trace_path != nullptr);
+
   display d("testbed");
   dump_timer(start, "initialized display");
 
@@ -70,29 +83,32 @@ int main(int argc, char **argv) {
               | VK_BUFFER_USAGE_INDEX_BUFFER_BIT));
   dump_timer(start, "initialized buffer");
 
+  auto pipelines_start = display::clock::now();
   auto rgb_pipeline = make_unique<rgb>(w);
   auto rgba_pipeline = make_unique<rgba>(w);
   auto tex_pipeline = make_unique<tex>(w);
   auto rgbt_pipeline = make_unique<rgb_tex>(w);
-  auto rgbat_pipeline = make_unique<rgba_tex>(w);
+  auto rgbat_pipeline = make_unique<rgba_tex_compact>(w);
+  auto rect_pipeline = make_unique<rect>(w);
+  auto shape_pipeline = make_unique<shape>(w);
   dump_timer(start, "initialized pipelines");
-
-  auto rgb_ubo = b.allocate<rgb::ubo>();
-  auto rgba_ubo = b.allocate<rgba::ubo>();
-  auto tex_ubo = b.allocate<tex::ubo>();
-  auto rgbt_ubo = b.allocate<rgb_tex::ubo>();
-  auto rgbat_ubo = b.allocate<rgba_tex::ubo>();
+  cout << "pipelines requested in " << duration<double, milli>(display::clock::now() - pipelines_start).count()
+       << "ms, compiling in the background" << endl;
 
   auto rgb_vertices = b.allocate<rgb::vertex>(4);
   auto rgba_vertices = b.allocate<rgba::vertex>(4);
   auto tex_vertices = b.allocate<tex::vertex>(4);
   auto rgbt_vertices = b.allocate<rgb_tex::vertex>(4);
-  auto rgbat_vertices = b.allocate<rgba_tex::vertex>(4);
-
-  auto indices = b.allocate<uint16_t>(6);
+  auto rgbat_vertices = b.allocate<rgba_tex_compact::vertex>(4);
+  auto shape_instances = b.allocate<shape::instance>(4);
+
+  constexpr uint32_t rects_side = 64;  // drawn in a single instanced call
+  buffer rb(d, rects_side * rects_side * sizeof(rect::instance) + 256, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            (VkBufferUsageFlagBits)(VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT
+               | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT));
+  auto rect_instances = rb.allocate<rect::instance>(rects_side * rects_side);
   dump_timer(start, "allocated buffers");
 
-  indices->set(std::initializer_list<uint16_t>{0, 1, 2, 2, 3, 0});
   rgb_vertices->set(std::initializer_list<rgb::vertex>{{{0, 0}, {1, 0, 0}},
                                                        {{1, 0}, {0, 1, 0}},
                                                        {{1, 1}, {1, 1, 1}},
@@ -109,102 +125,159 @@ int main(int argc, char **argv) {
                                                             {{1, 0}, {0, 1, 0}, {1, 0}},
                                                             {{1, 1}, {0, 0, 1}, {1, 1}},
                                                             {{0, 1}, {1, 1, 1}, {0, 1}}});
-  rgbat_vertices->set(std::initializer_list<rgba_tex::vertex>{{{0, 0}, {1, 0, 0, 0.5f}, {0, 0}},
-                                                              {{1, 0}, {0, 1, 0, 0.5f}, {1, 0}},
-                                                              {{1, 1}, {0, 0, 1, 0.5f}, {1, 1}},
-                                                              {{0, 1}, {1, 1, 1, 0.5f}, {0, 1}}});
+  std::vector<glm::vec2> quad = {{0, 0}, {1, 0}, {1, 1}, {0, 1}};
+  std::vector<glm::vec4> rgbat_colors = {{1, 0, 0, 0.5f}, {0, 1, 0, 0.5f}, {0, 0, 1, 0.5f}, {1, 1, 1, 0.5f}};
+  std::vector<rgba_tex_compact::vertex> rgbat_packed(quad.size());
+  pack(quad.data(), quad.size(), &rgbat_packed[0].pos, sizeof(rgba_tex_compact::vertex));
+  pack(rgbat_colors.data(), rgbat_colors.size(), &rgbat_packed[0].color, sizeof(rgba_tex_compact::vertex));
+  pack(quad.data(), quad.size(), &rgbat_packed[0].texcoords, sizeof(rgba_tex_compact::vertex));
+  rgbat_vertices->set(rgbat_packed);
+  // a card with its drop shadow, a bordered pill and an ellipse, 4 vertices each
+  shape_instances->set(std::initializer_list<shape::instance>{
+      {{110, 310}, {200, 120}, {12, 12, 12, 12}, {0, 0, 0, 0.5f}, {}, 0, 8},
+      {{100, 300}, {200, 120}, {12, 12, 12, 12}, {1, 1, 1, 1}, {0.2f, 0.2f, 0.2f, 1}, 2},
+      {{120, 340}, {160, 40}, {20, 20, 20, 20}, {0.2f, 0.5f, 1, 1}, {0, 0, 0.4f, 1}, 1.5f},
+      {{320, 300}, {160, 100}, {}, {1, 0.8f, 0, 0.8f}, {}, 0, 0, SHAPE_ELLIPSE}});
+  std::vector<rect::instance> rects(rects_side * rects_side);
+  for (uint32_t y = 0; y < rects_side; y++) {
+    for (uint32_t x = 0; x < rects_side; x++) {
+      auto &r = rects[y * rects_side + x];
+      r.pos = {x * 6.f, y * 6.f};
+      r.size = {5, 5};
+      r.color = {x / float(rects_side), y / float(rects_side), 1, 1};
+    }
+  }
+  rect_instances->set(rects);
+  draw_list rect_rows(d, rects_side);  // one draw per row, hidden and shown without re-recording
+  if (d.draw_indirect_first_instance()) {
+    for (uint32_t y = 0; y < rects_side; y++)
+      rect_rows.add(rect::command(y * rects_side, rects_side));
+  } else {  // rows can't start at their first instance, a single draw then
+    rect_rows.add(rect::command(0, rects_side * rects_side));
+  }
+  // a copy scrolling across the window, the rects out of it are culled on the GPU
+  culler rect_culler(w, rects_side * rects_side, sizeof(rect::instance));
+  rect_culler.set(0, rects.data(), (uint32_t)rects.size());
+  rect_culler.count((uint32_t)rects.size());
+  glm::mat4 scrolling_model = glm::mat4(1);
   dump_timer(start, "copied data");
 
-  rgb_pipeline->bind(rgb_ubo);
-  rgba_pipeline->bind(rgba_ubo);
-
   shared_image texture;
   dump_timer(start, "initialized image");
 
-  sampler samp(d);
-  dump_timer(start, "initialized sampler");
+  node tex_node(w);  // re-recorded alone once the texture is loaded
 
   std::thread load_tex([&]() {
     texture = image::load_png(d, demo::tex1_png.data(), demo::tex1_png.size());
     dump_timer(start, "done loading texture");
-    tex_pipeline->bind(tex_ubo, texture, samp);
-    rgbt_pipeline->bind(rgbt_ubo, texture, samp);
-    rgbat_pipeline->bind(rgbat_ubo, texture, samp);
-    dump_timer(start, "bound tex pipelines");
-    w.invalidate(true);  // will force to call on_draw on the next frame
+    d.post([&](auto) {
+      // every other rect samples the texture, the others keep the white slot 0
+      for (uint32_t i = 0; i < rects.size(); i++)
+        rects[i].texture = (i + i / rects_side) % 2 ? texture->slot() : 0;
+      rect_instances->set(rects);
+      rect_culler.set(0, rects.data(), (uint32_t)rects.size());
+      tex_node.invalidate();  // will force to call tex_node.on_draw on the next frame
+    });
   });
   dump_timer(start, "started image load thread");
 
+  auto anim_start = display::clock::now();
+  auto anim_time = [&anim_start]() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(display::clock::now() - anim_start).count() / 1000.0f;
+  };
+
+#ifdef HUT_TEXT
+  // with a font file given in HUT_FONT, labels are drawn over the shapes
+  std::vector<char> font_file;
+  unique_ptr<font> label_font;
+  unique_ptr<text> labels;
+  if (const char *font_path = getenv("HUT_FONT")) {
+    font_file = read_file(font_path);
+    label_font = make_unique<font>((const uint8_t *)font_file.data(), font_file.size());
+    labels = make_unique<text>(w);
+  }
+#endif
+
   w.on_draw.connect(
-      [&](VkCommandBuffer _buffer, const glm::uvec2 &_size) {
+      [&](recorder &_recorder, const glm::uvec2 &_size) {
         dump_timer(start, "drawing...");
-        if (texture) { // don't use the pipeline while we didn't loaded&bound the texture
-          rgbt_pipeline->draw(_buffer, _size, rgbt_vertices, indices);
-          tex_pipeline->draw(_buffer, _size, tex_vertices, indices);
-          rgbat_pipeline->draw(_buffer, _size, rgbat_vertices, indices);
+        glm::mat4 rgb_model = glm::scale(glm::mat4(1), {100.f, 100.f, 1.f});
+        glm::mat4 rgba_model = glm::scale(glm::translate(glm::mat4(1), {0, 100.f, 0}), {100.f, 100.f, 1.f});
+        rgb_pipeline->draw_quads(_recorder, _size, rgb_vertices, {rgb_model});
+        rgba_pipeline->draw_quads(_recorder, _size, rgba_vertices, {rgba_model});
+        glm::mat4 rects_model = glm::translate(glm::mat4(1), {_size.x - rects_side * 6.f, 0, 0});
+        rect_pipeline->draw(_recorder, _size, rect_instances, rect_rows, {rects_model});
+        shape_pipeline->draw(_recorder, _size, shape_instances);
+#ifdef HUT_TEXT
+        if (labels) {
+          labels->draw(_recorder, _size, *label_font, 20, {0.1f, 0.1f, 0.1f, 1}, "Card", {120, 330});
+          labels->draw(_recorder, _size, *label_font, 14, {1, 1, 1, 1}, "Pill button", {140, 365});
         }
-        rgb_pipeline->draw(_buffer, _size, rgb_vertices, indices);
-        rgba_pipeline->draw(_buffer, _size, rgba_vertices, indices);
+#endif
         dump_timer(start, "drawn");
         return false;
       });
 
+  // models are push constants, the animated node is re-recorded every frame instead of updating uniforms
+  auto spinning = [](glm::vec2 _pos, float _angle) {
+    glm::mat4 model = glm::translate(glm::mat4(1), {_pos, 0});
+    model = glm::translate(model, {+389.f / 2, +325.f / 2, 0});
+    model = glm::rotate(model, _angle, glm::vec3(0.0f, 0.0f, 1.0f));
+    model = glm::translate(model, {-389.f / 2, -325.f / 2, 0});
+    return glm::scale(model, {389.f, 325.f, 1.f});
+  };
+
+  batch tex_batch;  // sorts and merges the draws of tex_node, layers keep the overlapping ones in order
+  tex_node.on_draw.connect(
+      [&](recorder &_recorder, const glm::uvec2 &_size) {
+        if (texture) { // don't draw it while it isn't loaded
+          float time = anim_time();
+          glm::mat4 tex_model = glm::scale(glm::mat4(1), {389.f, 325.f, 1.f});
+          uint32_t slot = texture->slot();
+          rgbt_pipeline->draw_quads(tex_batch, rgbt_vertices,
+                                    {spinning({100, 100}, time * glm::radians(90.0f)), slot});
+          tex_batch.layer(1);
+          tex_pipeline->draw_quads(tex_batch, tex_vertices, {tex_model, slot});
+          rgbat_pipeline->draw_quads(tex_batch, rgbat_vertices,
+                                     {spinning({200, 200}, time * glm::radians(10.0f)), slot});
+          tex_batch.flush(_recorder, _size);
+          rect_pipeline->draw(_recorder, _size, rect_culler, {scrolling_model});
+        }
+        return false;
+      });
+
   size_t fps = 0;
+  uint32_t hidden_row = 0;  // id of the row in rect_rows, in the order they were added
   display::time_point last_infos = display::clock::now();
 
   w.on_frame.connect([&](glm::uvec2 _size, display::duration _delta) {
-    w.invalidate(false);  // asks for a redraw, without recalling on_draw (shader animation, for example)
-
-    static auto startTime = display::clock::now();
+    static bool compiled = false;
+    if (!compiled && rgb_pipeline->ready() && rgba_pipeline->ready() && tex_pipeline->ready() && rgbt_pipeline->ready()
+        && rgbat_pipeline->ready() && rect_pipeline->ready() && shape_pipeline->ready()) {
+      compiled = true;
+      cout << "pipelines compiled in " << duration<double, milli>(display::clock::now() - pipelines_start).count()
+           << "ms (" << (d.pipeline_cache_warm() ? "warm" : "cold") << " cache)" << endl;
+    }
+    tex_node.invalidate();  // re-records only the animated node on the next frame
 
     auto currentTime = display::clock::now();
-    float time = std::chrono::duration_cast<std::chrono::milliseconds>(currentTime - startTime).count() / 1000.0f;
-    float ratio = _size.x / (float)_size.y;
-
-    rgb::ubo new_rgb_ubo;
-    new_rgb_ubo.model = glm::mat4(1);
-    new_rgb_ubo.model = glm::scale(new_rgb_ubo.model, {100.f, 100.f, 1.f});
-    new_rgb_ubo.view = glm::mat4(1);
-    new_rgb_ubo.proj = glm::ortho<float>(0, _size.x, 0, _size.y);
-    rgb_ubo->set({new_rgb_ubo});
-
-    rgba::ubo new_rgba_ubo;
-    new_rgba_ubo.model = glm::mat4(1);
-    new_rgba_ubo.model = glm::translate(new_rgba_ubo.model, {0, 100.f, 0});
-    new_rgba_ubo.model = glm::scale(new_rgba_ubo.model, {100.f, 100.f, 1.f});
-    new_rgba_ubo.view = glm::mat4(1);
-    new_rgba_ubo.proj = glm::ortho<float>(0, _size.x, 0, _size.y);
-    rgba_ubo->set({new_rgba_ubo});
-
-    tex::ubo new_tex_ubo;
-    new_tex_ubo.model = glm::mat4(1);
-    new_tex_ubo.model = glm::translate(new_tex_ubo.model, {0.f, 0.f, 0});
-    new_tex_ubo.model = glm::scale(new_tex_ubo.model, {389.f, 325.f, 1.f});
-    new_tex_ubo.view = glm::mat4(1);
-    new_tex_ubo.proj = glm::ortho<float>(0, _size.x, 0, _size.y);
-    tex_ubo->set({new_tex_ubo});
-
-    rgb_tex::ubo new_rgbt_ubo;
-    new_rgbt_ubo.model = glm::mat4(1);
-    new_rgbt_ubo.model = glm::translate(new_rgbt_ubo.model, {100.f, 100.f, 0});
-    new_rgbt_ubo.model = glm::translate(new_rgbt_ubo.model, {+389.f/2, +325.f/2, 0});
-    new_rgbt_ubo.model = glm::rotate(new_rgbt_ubo.model, time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-    new_rgbt_ubo.model = glm::translate(new_rgbt_ubo.model, {-389.f/2, -325.f/2, 0});
-    new_rgbt_ubo.model = glm::scale(new_rgbt_ubo.model, {389.f, 325.f, 1.f});
-    new_rgbt_ubo.view = glm::mat4(1);
-    new_rgbt_ubo.proj = glm::ortho<float>(0, _size.x, 0, _size.y);
-    rgbt_ubo->set({new_rgbt_ubo});
-
-    rgba_tex::ubo new_rgbat_ubo;
-    new_rgbat_ubo.model = glm::mat4(1);
-    new_rgbat_ubo.model = glm::translate(new_rgbat_ubo.model, {200.f, 200.f, 0});
-    new_rgbat_ubo.model = glm::translate(new_rgbat_ubo.model, {+389.f/2, +325.f/2, 0});
-    new_rgbat_ubo.model = glm::rotate(new_rgbat_ubo.model, time * glm::radians(10.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-    new_rgbat_ubo.model = glm::translate(new_rgbat_ubo.model, {-389.f/2, -325.f/2, 0});
-    new_rgbat_ubo.model = glm::scale(new_rgbat_ubo.model, {389.f, 325.f, 1.f});
-    new_rgbat_ubo.view = glm::mat4(1);
-    new_rgbat_ubo.proj = glm::ortho<float>(0, _size.x, 0, _size.y);
-    rgbat_ubo->set({new_rgbat_ubo});
+    float time = anim_time();
+
+    // only the rects of one row change every frame
+    uint32_t row = fps % rects_side;
+    for (uint32_t x = 0; x < rects_side; x++)
+      rects[row * rects_side + x].color.b = 0.5f + 0.5f * std::sin(time + x * 0.1f);
+    rect_instances->set(row * rects_side, rects.data() + row * rects_side, rects_side);
+    rect_culler.set(row * rects_side, rects.data() + row * rects_side, rects_side);
+    float scroll = std::fmod(time * 100.f, _size.x + rects_side * 6.f) - rects_side * 6.f;
+    scrolling_model = glm::translate(glm::mat4(1), {scroll, _size.y - rects_side * 6.f, 0});
+    rect_culler.model(scrolling_model);  // before the node is recorded, culling and drawing use the same one
+    // and one row is hidden, moving down every 30 frames
+    if (fps % 30 == 0 && rect_rows.size() > 1) {
+      rect_rows.visible(hidden_row, true);
+      hidden_row = (hidden_row + 1) % rects_side;
+      rect_rows.visible(hidden_row, false);
+    }
 
     fps++;
 
@@ -217,6 +290,17 @@ int main(int argc, char **argv) {
     return false;
   });
 
+  w.on_stats.connect([&tex_batch](const frame_stats &_stats) {
+    cout << "frame p50/p99/max: cpu " << _stats.total.p50 << "/" << _stats.total.p99 << "/" << _stats.total.max
+         << "ms, gpu " << _stats.gpu.p50 << "/" << _stats.gpu.p99 << "/" << _stats.gpu.max << "ms, jobs "
+         << _stats.jobs.p50 << "/" << _stats.jobs.p99 << "/" << _stats.jobs.max << "ms" << endl;
+    auto batched = tex_batch.stats();
+    cout << "batch: " << batched.draws << " draws, " << batched.binds << " binds, saved " << batched.saved_draws
+         << " draws and " << batched.saved_binds << " binds" << endl;
+    cout << "commands: " << _stats.commands_issued << " issued, " << _stats.commands_elided << " elided" << endl;
+    return false;
+  });
+
   w.on_resize.connect([](const glm::uvec2 &_size) {
     cout << "resize " << glm::to_string(_size) << endl;
     return false;
@@ -230,6 +314,14 @@ int main(int argc, char **argv) {
   w.on_keysym.connect([&w](char32_t c, bool _press) {
     cout << "key " << _press << '\t' << c << '\t' << window::is_cursor_key(c) << window::is_function_key(c)
          << window::is_keypad_key(c) << window::is_modifier_key(c) << '\t' << window::name_key(c) << endl;
+
+    // F1 to F4 switch between FIFO, FIFO_RELAXED, MAILBOX and IMMEDIATE
+    keysym mapped = window::map_key(c);
+    if (_press && mapped >= KF1 && mapped <= KF4) {
+      w.present_policy(present_mode(mapped - KF1));
+      cout << "present mode " << w.present_policy() << ", got " << w.active_present_mode() << " with "
+           << w.images_count() << " images" << endl;
+    }
     return true;
   });
 
@@ -263,6 +355,8 @@ int main(int argc, char **argv) {
   dump_timer(start, "finished callback setup");
   auto result = d.dispatch();
   load_tex.join();
+  if (trace_path != nullptr)
+    trace::dump(trace_path);
   dump_timer(start, "done.");
   return result;
 }
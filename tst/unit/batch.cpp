@@ -0,0 +1,74 @@
+#include <gtest/gtest.h>
+
+#include "hut/batch.hpp"
+
+namespace {
+
+struct test_batch : hut::batch {
+  using batch::draws_;
+  using batch::merge;
+};
+
+template <typename T>
+T handle(uintptr_t _value) {
+  return (T)_value;
+}
+
+hut::batch_item quads(uintptr_t _pipeline, uint32_t _texture, uint32_t _first, uint32_t _count, bool _blend = false) {
+  hut::batch_item item;
+  item.pipeline_ = handle<VkPipeline>(_pipeline);
+  item.layout_ = handle<VkPipelineLayout>(1);
+  item.blend_ = _blend;
+  item.vertices_ = handle<VkBuffer>(1);
+  item.indices_ = handle<VkBuffer>(2);
+  item.index_count_ = 6;
+  item.constants_.texture = _texture;
+  item.first_instance_ = _first;
+  item.instance_count_ = _count;
+  return item;
+}
+
+}  // namespace
+
+TEST(batch, sort_and_merge_opaque) {
+  test_batch b;
+  b.add(quads(1, 0, 0, 10));
+  b.add(quads(2, 0, 0, 5));
+  b.add(quads(1, 0, 20, 10));
+  b.add(quads(1, 0, 10, 10));
+  b.add(quads(1, 3, 30, 10));
+  b.merge();
+
+  ASSERT_EQ(b.draws_.size(), 3u);
+  EXPECT_EQ(b.draws_[0].pipeline_, handle<VkPipeline>(1));
+  EXPECT_EQ(b.draws_[0].first_instance_, 0u);
+  EXPECT_EQ(b.draws_[0].instance_count_, 30u);
+  EXPECT_EQ(b.draws_[1].constants_.texture, 3u);
+  EXPECT_EQ(b.draws_[2].pipeline_, handle<VkPipeline>(2));
+
+  EXPECT_EQ(b.stats().items, 5u);
+  EXPECT_EQ(b.stats().draws, 3u);
+  EXPECT_EQ(b.stats().saved_draws, 2u);
+  // all but the descriptor set for the first draw, the push constants, then the pipeline and push constants again,
+  // plus the viewport and scissor
+  EXPECT_EQ(b.stats().binds, 4u + 1 + 2 + 2);
+  EXPECT_EQ(b.stats().saved_binds, 5 * 6u - b.stats().binds);
+}
+
+TEST(batch, blended_keep_order) {
+  test_batch b;
+  b.add(quads(2, 0, 0, 1, true));
+  b.add(quads(1, 0, 0, 1, true));
+  b.add(quads(1, 0, 1, 1, true));
+  b.add(quads(3, 0, 0, 1));
+  b.layer(1);
+  b.add(quads(4, 0, 0, 1));
+  b.merge();
+
+  ASSERT_EQ(b.draws_.size(), 4u);
+  EXPECT_EQ(b.draws_[0].pipeline_, handle<VkPipeline>(3));  // opaque first in its layer
+  EXPECT_EQ(b.draws_[1].pipeline_, handle<VkPipeline>(2));
+  EXPECT_EQ(b.draws_[2].pipeline_, handle<VkPipeline>(1));
+  EXPECT_EQ(b.draws_[2].instance_count_, 2u);
+  EXPECT_EQ(b.draws_[3].pipeline_, handle<VkPipeline>(4));
+}
@@ -0,0 +1,165 @@
+#include <cstring>
+#include <utility>
+
+#include <gtest/gtest.h>
+
+#include "hut/display.hpp"
+
+namespace {
+
+float blend_factor(VkBlendFactor _factor, float _src_alpha, float _dst_alpha) {
+  switch (_factor) {
+    case VK_BLEND_FACTOR_ONE:
+      return 1;
+    case VK_BLEND_FACTOR_SRC_ALPHA:
+      return _src_alpha;
+    case VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA:
+      return 1 - _src_alpha;
+    case VK_BLEND_FACTOR_DST_ALPHA:
+      return _dst_alpha;
+    case VK_BLEND_FACTOR_ONE_MINUS_DST_ALPHA:
+      return 1 - _dst_alpha;
+    default:
+      return 0;
+  }
+}
+
+// one color channel and alpha, blended by the fixed function with _state
+std::pair<float, float> blend(const VkPipelineColorBlendAttachmentState &_state, std::pair<float, float> _src,
+                              std::pair<float, float> _dst) {
+  float sa = _src.second, da = _dst.second;
+  float color = _src.first * blend_factor(_state.srcColorBlendFactor, sa, da)
+                + _dst.first * blend_factor(_state.dstColorBlendFactor, sa, da);
+  float alpha =
+      sa * blend_factor(_state.srcAlphaBlendFactor, sa, da) + da * blend_factor(_state.dstAlphaBlendFactor, sa, da);
+  return {color, alpha};
+}
+
+VkPhysicalDeviceProperties fake_props() {
+  VkPhysicalDeviceProperties props = {};
+  props.vendorID = 0x10de;
+  props.deviceID = 0x1c82;
+  for (uint8_t i = 0; i < VK_UUID_SIZE; i++)
+    props.pipelineCacheUUID[i] = i;
+  return props;
+}
+
+std::vector<char> fake_cache(const VkPhysicalDeviceProperties &_props) {
+  uint32_t fields[4] = {4 * sizeof(uint32_t) + VK_UUID_SIZE, VK_PIPELINE_CACHE_HEADER_VERSION_ONE, _props.vendorID,
+                        _props.deviceID};
+  std::vector<char> data(sizeof(fields) + VK_UUID_SIZE + 64, 0);
+  memcpy(data.data(), fields, sizeof(fields));
+  memcpy(data.data() + sizeof(fields), _props.pipelineCacheUUID, VK_UUID_SIZE);
+  return data;
+}
+
+}  // namespace
+
+TEST(display, pipeline_cache_compatible) {
+  auto props = fake_props();
+  auto data = fake_cache(props);
+  EXPECT_TRUE(hut::display::pipeline_cache_compatible(data, props));
+
+  EXPECT_FALSE(hut::display::pipeline_cache_compatible({}, props));
+  EXPECT_FALSE(hut::display::pipeline_cache_compatible(std::vector<char>(data.begin(), data.begin() + 20), props));
+
+  auto other_driver = props;
+  other_driver.pipelineCacheUUID[3] ^= 0xFF;
+  EXPECT_FALSE(hut::display::pipeline_cache_compatible(data, other_driver));
+
+  auto other_device = props;
+  other_device.deviceID++;
+  EXPECT_FALSE(hut::display::pipeline_cache_compatible(data, other_device));
+
+  auto other_vendor = props;
+  other_vendor.vendorID++;
+  EXPECT_FALSE(hut::display::pipeline_cache_compatible(data, other_vendor));
+
+  auto bad_version = data;
+  bad_version[4] = 42;
+  EXPECT_FALSE(hut::display::pipeline_cache_compatible(bad_version, props));
+}
+
+TEST(display, pipeline_desc_key) {
+  static const std::array<uint8_t, 4> vert = {1, 2, 3, 4}, frag = {5, 6, 7, 8};
+
+  hut::pipeline_desc a;
+  a.shaders(vert, frag);
+  a.bindings.resize(1);
+  a.bindings[0].stride = 24;
+  a.alpha_blend(true);
+  a.format = VK_FORMAT_B8G8R8A8_UNORM;
+
+  hut::pipeline_desc b = a;
+  hut::pipeline_desc::hasher hasher;
+  EXPECT_TRUE(a == b);
+  EXPECT_EQ(hasher(a), hasher(b));
+
+  b.alpha_blend(false);
+  EXPECT_FALSE(a == b);
+  EXPECT_NE(hasher(a), hasher(b));
+
+  b = a;
+  b.shaders(frag, vert);
+  EXPECT_FALSE(a == b);
+
+  b = a;
+  b.bindings[0].stride = 32;
+  EXPECT_FALSE(a == b);
+
+  // another copy of the same code, like the one of each translation unit including a resource
+  static const std::array<uint8_t, 4> vert_copy = vert, frag_copy = frag;
+  b = a;
+  b.shaders(vert_copy, frag_copy);
+  EXPECT_TRUE(a == b);
+  EXPECT_EQ(hasher(a), hasher(b));
+}
+
+TEST(display, blend_modes) {
+  auto none = hut::blend_attachment(hut::BLEND_NONE);
+  EXPECT_EQ(none.blendEnable, VK_FALSE);
+
+  hut::pipeline_desc over;
+  over.alpha_blend(true);
+  auto state = hut::blend_attachment(hut::BLEND_OVER);
+  EXPECT_EQ(memcmp(&over.blend, &state, sizeof(state)), 0);
+  EXPECT_EQ(state.srcColorBlendFactor, VK_BLEND_FACTOR_SRC_ALPHA);
+  EXPECT_EQ(state.dstColorBlendFactor, VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA);
+
+  auto dst_in = hut::blend_attachment(hut::BLEND_DST_IN);
+  EXPECT_EQ(dst_in.blendEnable, VK_TRUE);
+  EXPECT_EQ(dst_in.srcColorBlendFactor, VK_BLEND_FACTOR_ZERO);
+  EXPECT_EQ(dst_in.dstColorBlendFactor, VK_BLEND_FACTOR_SRC_ALPHA);
+  EXPECT_EQ(dst_in.dstAlphaBlendFactor, VK_BLEND_FACTOR_SRC_ALPHA);
+
+  auto xor_ = hut::blend_attachment(hut::BLEND_XOR);
+  EXPECT_EQ(xor_.srcColorBlendFactor, VK_BLEND_FACTOR_ONE_MINUS_DST_ALPHA);
+  EXPECT_EQ(xor_.dstAlphaBlendFactor, VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA);
+
+  auto src = hut::blend_attachment(hut::BLEND_SRC);
+  EXPECT_EQ(src.srcColorBlendFactor, VK_BLEND_FACTOR_SRC_ALPHA);
+  EXPECT_EQ(src.srcAlphaBlendFactor, VK_BLEND_FACTOR_ONE);
+  EXPECT_EQ(src.dstAlphaBlendFactor, VK_BLEND_FACTOR_ZERO);
+
+  // non-premultiplied half transparent white over opaque black
+  auto over_result = blend(state, {1, 0.5f}, {0, 1});
+  EXPECT_FLOAT_EQ(over_result.first, 0.5f);
+  EXPECT_FLOAT_EQ(over_result.second, 0.5f);
+
+  // in keeps the source where the destination is: premultiplied 0.5 alpha white in a 0.5 alpha destination
+  auto in = hut::blend_attachment(hut::BLEND_IN);
+  auto in_result = blend(in, {0.5f, 0.5f}, {0.2f, 0.5f});
+  EXPECT_FLOAT_EQ(in_result.first, 0.25f);
+  EXPECT_FLOAT_EQ(in_result.second, 0.25f);
+  // the same source non-premultiplied is only weighted by the destination alpha, as if opaque
+  EXPECT_FLOAT_EQ(blend(in, {1, 0.5f}, {0.2f, 0.5f}).first, 0.5f);
+
+  hut::pipeline_desc a, b;
+  a.blending(hut::BLEND_ATOP);
+  b.blending(hut::BLEND_DST_ATOP);
+  EXPECT_FALSE(a == b);
+  b = a;
+  b.dynamic_blend = true;
+  EXPECT_FALSE(a == b);
+  EXPECT_NE(hut::pipeline_desc::hasher()(a), hut::pipeline_desc::hasher()(b));
+}
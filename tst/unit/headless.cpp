@@ -0,0 +1,36 @@
+#include <gtest/gtest.h>
+
+#include "hut/display.hpp"
+#include "hut/window.hpp"
+
+#if defined(VK_USE_PLATFORM_HEADLESS_KHR)
+
+TEST(headless, capture) {
+  hut::display d("testbed");
+  hut::window w(d);
+  w.clear_color({1, 0, 0, 1});
+
+  bool captured = false;
+  w.on_frame.connect([&w](glm::uvec2, hut::display::duration) {
+    w.invalidate(false);  // keep going until the captured frame is retired
+    return false;
+  });
+  w.capture([&](glm::uvec2 _size, VkFormat _format, const uint8_t *_pixels) {
+    captured = true;
+    EXPECT_EQ(_size, w.size());
+
+    const uint8_t *center = _pixels + 4 * (_size.y / 2 * _size.x + _size.x / 2);
+    bool bgra = _format == VK_FORMAT_B8G8R8A8_UNORM || _format == VK_FORMAT_B8G8R8A8_SRGB;
+    EXPECT_EQ(center[bgra ? 2 : 0], 255);
+    EXPECT_EQ(center[1], 0);
+    EXPECT_EQ(center[bgra ? 0 : 2], 0);
+    EXPECT_EQ(center[3], 255);
+
+    d.post([&w](auto) { w.close(); });
+  });
+
+  d.dispatch();
+  EXPECT_TRUE(captured);
+}
+
+#endif
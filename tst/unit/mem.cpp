@@ -50,3 +50,32 @@ TEST(mem, grow) {
 
   d.flush_staged();
 }
+
+TEST(mem, indices) {
+  hut::display d("testbed");
+
+  hut::buffer b(d, 64,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                (VkBufferUsageFlagBits)(VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT));
+
+  auto small = b.allocate_indices(65536, {0, 1, 65535});
+  ASSERT_TRUE(std::holds_alternative<hut::shared_ref<uint16_t>>(small));
+  ASSERT_EQ(std::get<hut::shared_ref<uint16_t>>(small)->count(), 3);
+
+  auto large = b.allocate_indices(65537, {0, 1, 65536});
+  ASSERT_TRUE(std::holds_alternative<hut::shared_ref<uint32_t>>(large));
+  ASSERT_EQ(std::get<hut::shared_ref<uint32_t>>(large)->count(), 3);
+  // after the 6 bytes of small, bound and indexed by batch in multiples of 4 bytes
+  ASSERT_EQ(std::get<hut::shared_ref<uint32_t>>(large)->offset_ % sizeof(uint32_t), 0u);
+
+  auto quads = d.quad_list_indices(10);
+  ASSERT_TRUE(std::holds_alternative<hut::shared_ref<uint16_t>>(quads));
+  ASSERT_GE(std::get<hut::shared_ref<uint16_t>>(quads)->count(), 60);
+  ASSERT_EQ(d.quad_list_indices(5), quads);  // shared while large enough
+
+  auto many = d.quad_list_indices(20000);
+  ASSERT_TRUE(std::holds_alternative<hut::shared_ref<uint32_t>>(many));
+  ASSERT_GE(std::get<hut::shared_ref<uint32_t>>(many)->count(), 120000);
+
+  d.flush_staged();
+}
@@ -0,0 +1,108 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "hut/packed.hpp"
+
+TEST(packed, positions) {
+  // 7 values run both the vectorized loop and the scalar tail
+  std::vector<glm::vec2> src = {{0, 0},      {1.4f, 1.6f}, {-2.5f, 2.5f}, {40000, -40000},
+                                {-1, 32767}, {100, 200},   {std::numeric_limits<float>::quiet_NaN(), 3}};
+  std::vector<hut::sint16x2> dst(src.size());
+  hut::pack(src.data(), src.size(), dst.data());
+
+  EXPECT_EQ(dst[1].x, 1);
+  EXPECT_EQ(dst[1].y, 2);
+  EXPECT_EQ(dst[2].x, -2);  // to nearest even
+  EXPECT_EQ(dst[2].y, 2);
+  EXPECT_EQ(dst[3].x, 32767);
+  EXPECT_EQ(dst[3].y, -32768);
+  EXPECT_EQ(dst[4].x, -1);
+  EXPECT_EQ(dst[4].y, 32767);
+  EXPECT_EQ(dst[5].x, 100);
+  EXPECT_EQ(dst[5].y, 200);
+  EXPECT_EQ(dst[6].x, -32768);
+  EXPECT_EQ(dst[6].y, 3);
+}
+
+TEST(packed, colors) {
+  std::vector<glm::vec4> src = {{0, 0.5f, 1, 1}, {-1, 2, 0.2f, 0}, {1, 1, 1, 1}, {0, 0, 0, 0}, {0.1f, 0.9f, 0.5f, 0.75f}};
+  std::vector<hut::unorm8x4> dst(src.size());
+  hut::pack(src.data(), src.size(), dst.data());
+
+  for (size_t i = 0; i < src.size(); i++) {
+    auto expected = [](float _value) { return (int)std::nearbyint(std::fmin(std::fmax(_value, 0.f), 1.f) * 255); };
+    EXPECT_EQ(dst[i].r, expected(src[i].x)) << i;
+    EXPECT_EQ(dst[i].g, expected(src[i].y)) << i;
+    EXPECT_EQ(dst[i].b, expected(src[i].z)) << i;
+    EXPECT_EQ(dst[i].a, expected(src[i].w)) << i;
+  }
+
+  std::vector<glm::vec3> opaque = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}, {0.5f, 0.5f, 0.5f}, {2, -2, 0}};
+  hut::pack(opaque.data(), opaque.size(), dst.data());
+  EXPECT_EQ(dst[0].r, 255);
+  EXPECT_EQ(dst[1].g, 255);
+  EXPECT_EQ(dst[2].b, 255);
+  EXPECT_EQ(dst[3].r, 128);
+  EXPECT_EQ(dst[4].r, 255);
+  EXPECT_EQ(dst[4].g, 0);
+  for (auto &color : dst)
+    EXPECT_EQ(color.a, 255);
+}
+
+TEST(packed, texcoords) {
+  std::vector<glm::vec2> src = {{0, 1}, {0.5f, 0.25f}, {-1, 2}, {1, 0}, {0.75f, 0.125f}};
+  std::vector<hut::unorm16x2> dst(src.size());
+  hut::pack(src.data(), src.size(), dst.data());
+
+  EXPECT_EQ(dst[0].x, 0);
+  EXPECT_EQ(dst[0].y, 65535);
+  EXPECT_EQ(dst[1].x, 32768);
+  EXPECT_EQ(dst[1].y, 16384);
+  EXPECT_EQ(dst[2].x, 0);
+  EXPECT_EQ(dst[2].y, 65535);
+  EXPECT_EQ(dst[3].x, 65535);
+  EXPECT_EQ(dst[4].x, 49151);
+  EXPECT_EQ(dst[4].y, 8192);
+}
+
+TEST(packed, halves) {
+  std::vector<glm::vec2> src = {{1, -2}, {0.5f, 65504}, {70000, 5.9604645e-8f}, {0, -0.f}};
+  std::vector<hut::half2> dst(src.size());
+  hut::pack(src.data(), src.size(), dst.data());
+
+  EXPECT_EQ(dst[0].x, 0x3c00);
+  EXPECT_EQ(dst[0].y, 0xc000);
+  EXPECT_EQ(dst[1].x, 0x3800);
+  EXPECT_EQ(dst[1].y, 0x7bff);
+  EXPECT_EQ(dst[2].x, 0x7c00);
+  EXPECT_EQ(dst[2].y, 0x0001);
+  EXPECT_EQ(dst[3].x, 0x0000);
+  EXPECT_EQ(dst[3].y, 0x8000);
+}
+
+TEST(packed, strided) {
+  struct vertex {
+    hut::sint16x2 pos;
+    hut::unorm8x4 color;
+  };
+  std::vector<glm::vec2> pos = {{1, 2}, {3, 4}, {5, 6}, {7, 8}, {9, 10}};
+  std::vector<glm::vec4> colors(pos.size(), glm::vec4{1, 0, 1, 0});
+  std::vector<vertex> dst(pos.size());
+  hut::pack(pos.data(), pos.size(), &dst[0].pos, sizeof(vertex));
+  hut::pack(colors.data(), colors.size(), &dst[0].color, sizeof(vertex));
+
+  for (size_t i = 0; i < dst.size(); i++) {
+    EXPECT_EQ(dst[i].pos.x, 2 * i + 1);
+    EXPECT_EQ(dst[i].pos.y, 2 * i + 2);
+    EXPECT_EQ(dst[i].color.r, 255);
+    EXPECT_EQ(dst[i].color.g, 0);
+    EXPECT_EQ(dst[i].color.b, 255);
+    EXPECT_EQ(dst[i].color.a, 0);
+  }
+
+  auto single = hut::pack<hut::unorm8x4>(glm::vec4{0, 1, 0, 1});
+  EXPECT_EQ(single.g, 255);
+}
@@ -0,0 +1,75 @@
+#include <gtest/gtest.h>
+
+#include "hut/drawables/rect.hpp"
+#include "hut/drawables/rgba_tex.hpp"
+#include "hut/drawables/shape.hpp"
+#include "hut/pipeline.hpp"
+
+namespace {
+
+struct test_vertex {
+  glm::vec2 pos;
+  glm::vec4 color;
+  float depth;
+
+  static constexpr auto layout() {
+    return hut::fields<HUT_FIELD(test_vertex, pos), HUT_FIELD(test_vertex, color), HUT_FIELD(test_vertex, depth)>();
+  }
+};
+
+}  // namespace
+
+TEST(pipeline, vertex_layout) {
+  constexpr auto attributes = decltype(test_vertex::layout())::attributes(1, 2);
+  static_assert(attributes.size() == 3, "one attribute per field");
+
+  EXPECT_EQ(attributes[0].location, 2u);
+  EXPECT_EQ(attributes[0].binding, 1u);
+  EXPECT_EQ(attributes[0].format, VK_FORMAT_R32G32_SFLOAT);
+  EXPECT_EQ(attributes[0].offset, offsetof(test_vertex, pos));
+
+  EXPECT_EQ(attributes[1].location, 3u);
+  EXPECT_EQ(attributes[1].format, VK_FORMAT_R32G32B32A32_SFLOAT);
+  EXPECT_EQ(attributes[1].offset, offsetof(test_vertex, color));
+
+  EXPECT_EQ(attributes[2].location, 4u);
+  EXPECT_EQ(attributes[2].format, VK_FORMAT_R32_SFLOAT);
+  EXPECT_EQ(attributes[2].offset, offsetof(test_vertex, depth));
+}
+
+TEST(pipeline, rect_instance_layout) {
+  constexpr auto attributes = decltype(hut::rect_instance::layout())::attributes();
+  static_assert(attributes.size() == 5, "one attribute per field");
+
+  EXPECT_EQ(attributes[3].location, 3u);
+  EXPECT_EQ(attributes[3].format, VK_FORMAT_R32G32B32A32_SFLOAT);
+  EXPECT_EQ(attributes[3].offset, offsetof(hut::rect_instance, texcoords));
+
+  EXPECT_EQ(attributes[4].location, 4u);
+  EXPECT_EQ(attributes[4].format, VK_FORMAT_R32_UINT);
+  EXPECT_EQ(attributes[4].offset, offsetof(hut::rect_instance, texture));
+}
+
+TEST(pipeline, shape_instance_layout) {
+  constexpr auto attributes = decltype(hut::shape_instance::layout())::attributes();
+  static_assert(attributes.size() == 8, "one attribute per field");
+
+  EXPECT_EQ(attributes[0].offset, 0u);  // culled like rects
+  EXPECT_EQ(attributes[1].offset, offsetof(hut::shape_instance, size));
+  EXPECT_EQ(attributes[5].format, VK_FORMAT_R32_SFLOAT);
+  EXPECT_EQ(attributes[5].offset, offsetof(hut::shape_instance, stroke));
+  EXPECT_EQ(attributes[7].location, 7u);
+  EXPECT_EQ(attributes[7].format, VK_FORMAT_R32_UINT);
+  EXPECT_EQ(attributes[7].offset, offsetof(hut::shape_instance, kind));
+}
+
+TEST(pipeline, compact_vertex_layout) {
+  static_assert(sizeof(hut::rgba_tex_compact_vertex) == 12, "compact vertices are packed");
+  constexpr auto attributes = decltype(hut::rgba_tex_compact_vertex::layout())::attributes();
+
+  EXPECT_EQ(attributes[0].format, VK_FORMAT_R16G16_SINT);
+  EXPECT_EQ(attributes[1].format, VK_FORMAT_R8G8B8A8_UNORM);
+  EXPECT_EQ(attributes[1].offset, offsetof(hut::rgba_tex_compact_vertex, color));
+  EXPECT_EQ(attributes[2].format, VK_FORMAT_R16G16_UNORM);
+  EXPECT_EQ(attributes[2].offset, offsetof(hut::rgba_tex_compact_vertex, texcoords));
+}
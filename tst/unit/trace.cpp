@@ -0,0 +1,49 @@
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "hut/trace.hpp"
+
+namespace {
+std::string dump_to_string() {
+  std::string path = testing::TempDir() + "hut_trace.json";
+  hut::trace::dump(path);
+  std::ifstream file(path);
+  std::stringstream content;
+  content << file.rdbuf();
+  std::remove(path.c_str());
+  return content.str();
+}
+}  // namespace
+
+TEST(trace, zones) {
+  hut::trace::clear();
+  hut::trace::enable(false);
+  { HUT_TRACE_ZONE("test", "disabled zone"); }
+
+  hut::trace::enable(true);
+  { HUT_TRACE_ZONE("test", "main zone"); }
+  std::thread worker([] {
+    hut::trace::thread_name("worker \"1\"");
+    HUT_TRACE_ZONE("test", "worker zone");
+  });
+  worker.join();
+  auto now = hut::trace::clock::now();
+  hut::trace::record_gpu("gpu zone", now, now + std::chrono::microseconds(10));
+  hut::trace::enable(false);
+
+  std::string json = dump_to_string();
+  EXPECT_EQ(json.find("disabled zone"), std::string::npos);
+  EXPECT_NE(json.find(R"("name": "main zone", "cat": "test", "ph": "X")"), std::string::npos);
+  EXPECT_NE(json.find("worker zone"), std::string::npos);
+  EXPECT_NE(json.find(R"("args": {"name": "worker \"1\""})"), std::string::npos);
+  EXPECT_NE(json.find(R"("args": {"name": "GPU"})"), std::string::npos);
+  EXPECT_NE(json.find(R"("name": "gpu zone", "cat": "gpu")"), std::string::npos);
+
+  hut::trace::clear();
+  json = dump_to_string();
+  EXPECT_EQ(json.find("main zone"), std::string::npos);
+}
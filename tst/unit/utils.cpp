@@ -1,3 +1,5 @@
+#include <atomic>
+
 #include <gtest/gtest.h>
 
 #include "hut/utils.hpp"
@@ -11,3 +13,92 @@ TEST(utils, event) {
   EXPECT_EQ(e1.fire(42), true);
   EXPECT_EQ(e1.fire(1337), true);
 }
+
+TEST(utils, rolling_window) {
+  hut::rolling_window<double> window(100);
+  EXPECT_EQ(window.size(), 0u);
+  EXPECT_EQ(window.percentile(0.5), 0);
+  EXPECT_EQ(window.max(), 0);
+
+  for (int i = 100; i > 0; i--)
+    window.push(i);
+  EXPECT_EQ(window.size(), 100u);
+  EXPECT_EQ(window.percentile(0.5), 50);
+  EXPECT_EQ(window.percentile(0.99), 99);
+  EXPECT_EQ(window.percentile(0), 1);
+  EXPECT_EQ(window.max(), 100);
+
+  // the oldest samples (100 to 51) are dropped first
+  for (int i = 0; i < 50; i++)
+    window.push(1000);
+  EXPECT_EQ(window.size(), 100u);
+  EXPECT_EQ(window.percentile(0.5), 50);
+  EXPECT_EQ(window.percentile(0.51), 1000);
+  EXPECT_EQ(window.max(), 1000);
+}
+
+TEST(utils, lru_cache) {
+  hut::lru_cache<std::string, int> cache(2);
+  EXPECT_EQ(cache.find("a"), nullptr);
+
+  cache.insert("a", 1);
+  cache.insert("b", 2);
+  ASSERT_NE(cache.find("a"), nullptr);  // now more recent than b
+  cache.insert("c", 3);
+  EXPECT_EQ(cache.size(), 2u);
+  EXPECT_EQ(cache.find("b"), nullptr);
+  EXPECT_EQ(*cache.find("a"), 1);
+  EXPECT_EQ(*cache.find("c"), 3);
+
+  cache.insert("a", 4);  // replaced, not added
+  EXPECT_EQ(cache.size(), 2u);
+  EXPECT_EQ(*cache.find("a"), 4);
+  cache.insert("d", 5);
+  EXPECT_EQ(cache.find("c"), nullptr);
+
+  cache.clear();
+  EXPECT_EQ(cache.size(), 0u);
+  EXPECT_EQ(cache.find("a"), nullptr);
+}
+
+TEST(utils, to_utf32) {
+  EXPECT_EQ(hut::to_utf32("h\xc3\xa9\xe2\x82\xac"), std::u32string({U'h', U'\u00e9', U'\u20ac'}));
+  EXPECT_THROW(hut::to_utf32("\xff"), std::range_error);
+}
+
+TEST(utils, thread_pool) {
+  hut::thread_pool pool(3);
+  EXPECT_EQ(pool.size(), 4u);
+
+  std::vector<std::atomic<int>> visits(100);
+  auto caller = std::this_thread::get_id();
+  std::thread::id first;
+  pool.parallel_for(visits.size(), [&](size_t i) {
+    if (i == 0)
+      first = std::this_thread::get_id();
+    visits[i]++;
+  });
+  EXPECT_EQ(first, caller);
+  for (auto &count : visits)
+    EXPECT_EQ(count, 1);
+
+  EXPECT_THROW(pool.parallel_for(8, [](size_t i) {
+    if (i == 5)
+      throw std::runtime_error("task failed");
+  }), std::runtime_error);
+}
+
+TEST(utils, task_queue) {
+  std::atomic<int> done(0);
+  std::vector<std::future<void>> futures;
+  {
+    hut::task_queue queue(2);
+    for (int i = 0; i < 16; i++)
+      futures.emplace_back(queue.post([&done] { done++; }));
+    futures.emplace_back(queue.post([] { throw std::runtime_error("task failed"); }));
+    futures[0].wait();
+    EXPECT_GE(done, 1);
+  }
+  EXPECT_EQ(done, 16);  // the queue is drained before the workers are joined
+  EXPECT_THROW(futures.back().get(), std::runtime_error);
+}